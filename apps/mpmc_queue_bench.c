@@ -0,0 +1,149 @@
+/*
+ * Lock-free MPMC queue benchmark
+ *
+ * A single consumer thread (standing in for the uthread scheduler) drains items
+ * produced by 1 to N producer pthreads. The same workload runs on the lock-free
+ * mpmc_queue_t and on a queue_t protected by a mutex, and the program reports
+ * items per second for both along with a checksum of every item received.
+ *
+ * Usage: mpmc_queue_bench [max_producers] [items]
+ *
+ * Build with -O2 -pthread.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "mpmc_queue.h"
+#include "queue.h"
+
+static mpmc_queue_t lockFree;
+static queue_t locked;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static long perProducer;
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *produceLockFree(void *arg)
+{
+	(void)arg;
+
+	for (intptr_t i = 1; i <= perProducer; i++) {
+		while (mpmc_queue_enqueue(lockFree, (void*)i) == -1) {
+			// Queue full, let the consumer catch up.
+			sched_yield();
+		}
+	}
+
+	return NULL;
+}
+
+static void *produceLocked(void *arg)
+{
+	(void)arg;
+
+	for (intptr_t i = 1; i <= perProducer; i++) {
+		pthread_mutex_lock(&lock);
+		queue_enqueue(locked, (void*)i);
+		pthread_mutex_unlock(&lock);
+	}
+
+	return NULL;
+}
+
+static long consumeLockFree(long total)
+{
+	long sum = 0;
+	void *item;
+
+	for (long got = 0; got < total; ) {
+		if (mpmc_queue_dequeue(lockFree, &item) == 0) {
+			sum += (intptr_t)item;
+			got++;
+		} else {
+			sched_yield();
+		}
+	}
+
+	return sum;
+}
+
+static long consumeLocked(long total)
+{
+	long sum = 0;
+	void *item;
+
+	for (long got = 0; got < total; ) {
+		pthread_mutex_lock(&lock);
+		int status = queue_dequeue(locked, &item);
+		pthread_mutex_unlock(&lock);
+
+		if (status == 0) {
+			sum += (intptr_t)item;
+			got++;
+		} else {
+			sched_yield();
+		}
+	}
+
+	return sum;
+}
+
+static double run(int producers, void *(*produce)(void *),
+		  long (*consume)(long), int *ok)
+{
+	pthread_t threads[producers];
+	long total = perProducer * producers;
+
+	double start = now();
+
+	for (int i = 0; i < producers; i++) {
+		pthread_create(&threads[i], NULL, produce, NULL);
+	}
+
+	long sum = consume(total);
+
+	for (int i = 0; i < producers; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	double elapsed = now() - start;
+
+	*ok = (sum == producers * (perProducer * (perProducer + 1) / 2));
+	return total / elapsed;
+}
+
+int main(int argc, char **argv)
+{
+	int maxProducers = argc > 1 ? atoi(argv[1]) : 4;
+	long items = argc > 2 ? atol(argv[2]) : 4000000;
+
+	lockFree = mpmc_queue_create(4096);
+	locked = queue_create();
+
+	printf("producers  lock-free/sec   mutex+queue_t/sec  speedup  check\n");
+	for (int p = 1; p <= maxProducers; p++) {
+		int okFree, okLocked;
+
+		perProducer = items / p;
+		double lockFreeRate = run(p, produceLockFree, consumeLockFree, &okFree);
+		double mutexRate = run(p, produceLocked, consumeLocked, &okLocked);
+
+		printf("%9d  %14.0f  %17.0f  %6.2fx  %s\n", p, lockFreeRate, mutexRate,
+		       lockFreeRate / mutexRate, okFree && okLocked ? "ok" : "BAD SUM");
+	}
+
+	mpmc_queue_destroy(lockFree);
+
+	return 0;
+}
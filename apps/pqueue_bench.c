@@ -0,0 +1,149 @@
+/*
+ * Priority queue benchmark
+ *
+ * Fills a queue with items of random keys, then takes them all out smallest
+ * first: with pqueue_pop(), and with queue_t the way timers were handled so
+ * far, a queue_iterate() scan for the smallest item followed by
+ * queue_delete(). Also measures pqueue_update() decreasing random keys.
+ *
+ * Usage: pqueue_bench [items...]
+ *
+ * Build with -O2.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "pqueue.h"
+#include "queue.h"
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int find_min(queue_t queue, void *data, void *arg)
+{
+	long long **min = arg;
+
+	(void)queue;
+
+	if (*min == NULL || *(long long *)data < **min) {
+		*min = data;
+	}
+	return 0;
+}
+
+static double bench_queue(long long *keys, int items)
+{
+	queue_t queue = queue_create();
+	long long last = -1;
+
+	double start = now();
+	for (int i = 0; i < items; i++) {
+		queue_enqueue(queue, &keys[i]);
+	}
+
+	for (int i = 0; i < items; i++) {
+		long long *min = NULL;
+
+		queue_iterate(queue, find_min, &min, NULL);
+		queue_delete(queue, min);
+
+		if (*min < last) {
+			fprintf(stderr, "queue_t: out of order\n");
+			exit(1);
+		}
+		last = *min;
+	}
+	double elapsed = now() - start;
+
+	queue_destroy(queue);
+	return elapsed * 1e9 / items;
+}
+
+static double bench_pqueue(long long *keys, int items)
+{
+	pqueue_t pq = pqueue_create(NULL);
+	long long last = -1;
+	long long *min;
+
+	double start = now();
+	for (int i = 0; i < items; i++) {
+		pqueue_push(pq, keys[i], &keys[i]);
+	}
+
+	for (int i = 0; i < items; i++) {
+		pqueue_pop(pq, (void **)&min);
+
+		if (*min < last) {
+			fprintf(stderr, "pqueue_t: out of order\n");
+			exit(1);
+		}
+		last = *min;
+	}
+	double elapsed = now() - start;
+
+	pqueue_destroy(pq);
+	return elapsed * 1e9 / items;
+}
+
+static double bench_update(long long *keys, int items)
+{
+	pqueue_t pq = pqueue_create(NULL);
+	int *handles = malloc(items * sizeof(int));
+	void *data;
+
+	for (int i = 0; i < items; i++) {
+		handles[i] = pqueue_push(pq, keys[i], &keys[i]);
+	}
+
+	double start = now();
+	for (int i = 0; i < items; i++) {
+		int victim = rand() % items;
+
+		keys[victim] -= rand() % 1000;
+		pqueue_update(pq, handles[victim], keys[victim]);
+	}
+	double elapsed = now() - start;
+
+	while (pqueue_pop(pq, &data) == 0) {
+		// Empty it.
+	}
+
+	pqueue_destroy(pq);
+	free(handles);
+	return elapsed * 1e9 / items;
+}
+
+int main(int argc, char **argv)
+{
+	int defaults[] = { 100, 1000, 10000 };
+	int count = argc > 1 ? argc - 1 : 3;
+
+	srand(1);
+
+	for (int i = 0; i < count; i++) {
+		int items = argc > 1 ? atoi(argv[i + 1]) : defaults[i];
+		long long *keys = malloc(items * sizeof(long long));
+
+		for (int j = 0; j < items; j++) {
+			keys[j] = rand();
+		}
+
+		double scan = bench_queue(keys, items);
+		double heap = bench_pqueue(keys, items);
+		double update = bench_update(keys, items);
+
+		printf("%6d items: queue_t scan %9.1f ns/item, pqueue_t %6.1f "
+		       "ns/item (x%.0f), decrease-key %5.1f ns\n", items,
+		       scan, heap, scan / heap, update);
+
+		free(keys);
+	}
+
+	return 0;
+}
@@ -0,0 +1,201 @@
+/*
+ * Priority queue tester
+ *
+ * Checks ordering by key and by comparator, key updates in both directions,
+ * removal through handles and handle reuse, then pops random items after
+ * random updates and removals and checks they come out sorted.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pqueue.h"
+
+#define TEST_ASSERT(assert)				\
+do {									\
+	printf("ASSERT: " #assert " ... ");	\
+	if (assert) {						\
+		printf("PASS\n");				\
+	} else	{							\
+		printf("FAIL\n");				\
+		exit(1);						\
+	}									\
+} while(0)
+
+#define STRESS_ITEMS 100000
+
+/* Create */
+void test_create(void)
+{
+	fprintf(stderr, "*** TEST create ***\n");
+
+	pqueue_t pq = pqueue_create(NULL);
+	TEST_ASSERT(pq != NULL);
+	TEST_ASSERT(pqueue_length(pq) == 0);
+	TEST_ASSERT(pqueue_destroy(pq) == 0);
+	TEST_ASSERT(pqueue_destroy(NULL) == -1);
+}
+
+/* Items come out by increasing key */
+void test_keys(void)
+{
+	int data[5] = { 0, 1, 2, 3, 4 };
+	long long keys[5] = { 30, 10, 40, 0, 20 };
+	void *ptr;
+	long long key;
+
+	fprintf(stderr, "*** TEST keys ***\n");
+
+	pqueue_t pq = pqueue_create(NULL);
+	for (int i = 0; i < 5; i++) {
+		pqueue_push(pq, keys[i], &data[i]);
+	}
+	TEST_ASSERT(pqueue_length(pq) == 5);
+
+	TEST_ASSERT(pqueue_peek(pq, &ptr, &key) == 0);
+	TEST_ASSERT(ptr == &data[3] && key == 0);
+
+	int expected[5] = { 3, 1, 4, 0, 2 };
+	for (int i = 0; i < 5; i++) {
+		pqueue_pop(pq, &ptr);
+		TEST_ASSERT(ptr == &data[expected[i]]);
+	}
+
+	TEST_ASSERT(pqueue_pop(pq, &ptr) == -1);
+	TEST_ASSERT(pqueue_peek(pq, &ptr, NULL) == -1);
+	TEST_ASSERT(pqueue_push(pq, 0, NULL) == -1);
+	pqueue_destroy(pq);
+}
+
+static int compare_ints(const void *a, const void *b)
+{
+	return *(const int *)a - *(const int *)b;
+}
+
+/* Items come out in the order of the comparator, keys being ignored */
+void test_comparator(void)
+{
+	int data[4] = { 7, 3, 9, 1 };
+	int handles[4];
+	int *ptr;
+
+	fprintf(stderr, "*** TEST comparator ***\n");
+
+	pqueue_t pq = pqueue_create(compare_ints);
+	for (int i = 0; i < 4; i++) {
+		handles[i] = pqueue_push(pq, -i, &data[i]);
+	}
+
+	pqueue_pop(pq, (void **)&ptr);
+	TEST_ASSERT(ptr == &data[3]);
+
+	// Changed in place, then moved.
+	data[2] = 0;
+	TEST_ASSERT(pqueue_update(pq, handles[2], 0) == 0);
+
+	pqueue_pop(pq, (void **)&ptr);
+	TEST_ASSERT(ptr == &data[2]);
+	pqueue_pop(pq, (void **)&ptr);
+	TEST_ASSERT(ptr == &data[1]);
+	pqueue_pop(pq, (void **)&ptr);
+	TEST_ASSERT(ptr == &data[0]);
+	TEST_ASSERT(pqueue_destroy(pq) == 0);
+}
+
+/* Keys change through handles, items get removed through handles */
+void test_handles(void)
+{
+	int data[4] = { 0, 1, 2, 3 };
+	int handles[4];
+	void *ptr;
+
+	fprintf(stderr, "*** TEST handles ***\n");
+
+	pqueue_t pq = pqueue_create(NULL);
+	for (int i = 0; i < 4; i++) {
+		handles[i] = pqueue_push(pq, 10 * (i + 1), &data[i]);
+		TEST_ASSERT(handles[i] >= 0);
+	}
+
+	// Decrease: 3 goes first.
+	TEST_ASSERT(pqueue_update(pq, handles[3], 5) == 0);
+	pqueue_peek(pq, &ptr, NULL);
+	TEST_ASSERT(ptr == &data[3]);
+
+	// Increase: 3 goes last.
+	TEST_ASSERT(pqueue_update(pq, handles[3], 100) == 0);
+	pqueue_peek(pq, &ptr, NULL);
+	TEST_ASSERT(ptr == &data[0]);
+
+	TEST_ASSERT(pqueue_remove(pq, handles[0]) == 0);
+	TEST_ASSERT(pqueue_remove(pq, handles[0]) == -1);
+	TEST_ASSERT(pqueue_update(pq, handles[0], 0) == -1);
+	TEST_ASSERT(pqueue_update(pq, 1000, 0) == -1);
+	TEST_ASSERT(pqueue_length(pq) == 3);
+
+	// The freed handle is handed out again.
+	TEST_ASSERT(pqueue_push(pq, 1, &data[0]) == handles[0]);
+
+	int expected[4] = { 0, 1, 2, 3 };
+	for (int i = 0; i < 4; i++) {
+		pqueue_pop(pq, &ptr);
+		TEST_ASSERT(ptr == &data[expected[i]]);
+	}
+
+	TEST_ASSERT(pqueue_destroy(pq) == 0);
+}
+
+/* Random pushes, updates and removals, then everything pops sorted */
+void test_stress(void)
+{
+	static long long keys[STRESS_ITEMS];
+	static int handles[STRESS_ITEMS];
+	static char removed[STRESS_ITEMS];
+	int popped = 0, sorted = 1, remaining = STRESS_ITEMS;
+	long long last = -1;
+	long long *ptr;
+
+	fprintf(stderr, "*** TEST stress ***\n");
+
+	srand(42);
+	pqueue_t pq = pqueue_create(NULL);
+
+	for (int i = 0; i < STRESS_ITEMS; i++) {
+		keys[i] = rand() % 1000000;
+		handles[i] = pqueue_push(pq, keys[i], &keys[i]);
+	}
+
+	for (int i = 0; i < STRESS_ITEMS; i += 3) {
+		keys[i] = rand() % 1000000;
+		pqueue_update(pq, handles[i], keys[i]);
+	}
+
+	for (int i = 1; i < STRESS_ITEMS; i += 7) {
+		pqueue_remove(pq, handles[i]);
+		removed[i] = 1;
+		remaining--;
+	}
+
+	TEST_ASSERT(pqueue_length(pq) == remaining);
+
+	while (pqueue_pop(pq, (void **)&ptr) == 0) {
+		sorted &= *ptr >= last && !removed[ptr - keys];
+		last = *ptr;
+		popped++;
+	}
+
+	TEST_ASSERT(sorted);
+	TEST_ASSERT(popped == remaining);
+	TEST_ASSERT(pqueue_destroy(pq) == 0);
+}
+
+int main(void)
+{
+	test_create();
+	test_keys();
+	test_comparator();
+	test_handles();
+	test_stress();
+
+	return 0;
+}
@@ -0,0 +1,185 @@
+/*
+ * Queue search benchmark
+ *
+ * Looks up random items of a queue of pointers, and deletes and enqueues them
+ * back, in three ways: walking a linked list of nodes as queue_t was laid out
+ * before (copied here, since queue_t no longer is), calling queue_iterate()
+ * with a callback comparing each item as findThread() does, and calling
+ * queue_find() and queue_delete(), which compare several slots at a time.
+ *
+ * The list walk is compiled with the flags of this program, queue_t with those
+ * of the library, which the Makefile builds without optimizations: with the
+ * default build, the small sizes compare -O2 code against -O0 code. Build the
+ * library with optimizations too to compare like with like.
+ *
+ * Usage: queue_find_bench [items...]
+ *
+ * Build with -O2.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "queue.h"
+
+#define LOOKUPS 200000
+
+/* Node of the linked list queue_t used to be */
+struct node {
+	struct node *next;
+	void *value;
+};
+
+struct list {
+	struct node *front;
+	struct node *back;
+};
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void list_append(struct list *list, void *value)
+{
+	struct node *node = malloc(sizeof(struct node));
+
+	node->next = NULL;
+	node->value = value;
+
+	if (list->back != NULL) {
+		list->back->next = node;
+	} else {
+		list->front = node;
+	}
+	list->back = node;
+}
+
+static int list_find(struct list *list, void *value)
+{
+	for (struct node *node = list->front; node != NULL; node = node->next) {
+		if (node->value == value) {
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+static int list_delete(struct list *list, void *value)
+{
+	struct node *prev = NULL;
+
+	for (struct node *node = list->front; node != NULL; node = node->next) {
+		if (node->value == value) {
+			if (prev != NULL) {
+				prev->next = node->next;
+			} else {
+				list->front = node->next;
+			}
+			if (list->back == node) {
+				list->back = prev;
+			}
+			free(node);
+			return 0;
+		}
+		prev = node;
+	}
+
+	return -1;
+}
+
+static int match(queue_t queue, void *data, void *arg)
+{
+	(void)queue;
+
+	return data == arg;
+}
+
+int main(int argc, char **argv)
+{
+	int defaults[] = { 16, 256, 4096, 32768 };
+	int count = argc > 1 ? argc - 1 : 4;
+
+	srand(1);
+
+	for (int c = 0; c < count; c++) {
+		int items = argc > 1 ? atoi(argv[c + 1]) : defaults[c];
+		int *data = malloc(items * sizeof(int));
+		int *picks = malloc(LOOKUPS * sizeof(int));
+		int lookups = items > 4096 ? LOOKUPS / 10 : LOOKUPS;
+		struct list list = { NULL, NULL };
+		queue_t queue = queue_create();
+		int found[3] = { 0, 0, 0 };
+
+		for (int i = 0; i < items; i++) {
+			list_append(&list, &data[i]);
+			queue_enqueue(queue, &data[i]);
+		}
+		for (int i = 0; i < lookups; i++) {
+			picks[i] = rand() % items;
+		}
+
+		double start = now();
+		for (int i = 0; i < lookups; i++) {
+			found[0] += list_find(&list, &data[picks[i]]) == 0;
+		}
+		double walk = (now() - start) * 1e9 / lookups;
+
+		start = now();
+		for (int i = 0; i < lookups; i++) {
+			void *item = NULL;
+
+			queue_iterate(queue, match, &data[picks[i]], &item);
+			found[1] += item != NULL;
+		}
+		double iterate = (now() - start) * 1e9 / lookups;
+
+		start = now();
+		for (int i = 0; i < lookups; i++) {
+			found[2] += queue_find(queue, &data[picks[i]]) == 0;
+		}
+		double find = (now() - start) * 1e9 / lookups;
+
+		if (found[0] != lookups || found[1] != lookups ||
+		    found[2] != lookups) {
+			fprintf(stderr, "lookup failed\n");
+			return 1;
+		}
+
+		// Delete and enqueue back: the same item ends up at the back.
+		start = now();
+		for (int i = 0; i < lookups; i++) {
+			list_delete(&list, &data[picks[i]]);
+			list_append(&list, &data[picks[i]]);
+		}
+		double listDelete = (now() - start) * 1e9 / lookups;
+
+		start = now();
+		for (int i = 0; i < lookups; i++) {
+			queue_delete(queue, &data[picks[i]]);
+			queue_enqueue(queue, &data[picks[i]]);
+		}
+		double queueDelete = (now() - start) * 1e9 / lookups;
+
+		printf("%6d items: find: list walk %8.1f ns, queue_iterate %8.1f "
+		       "ns, queue_find %7.1f ns (x%.1f) | delete+enqueue: list "
+		       "%8.1f ns, queue_t %7.1f ns\n", items, walk, iterate, find,
+		       walk / find, listDelete, queueDelete);
+
+		while (list.front != NULL) {
+			list_delete(&list, list.front->value);
+		}
+		for (void *item; queue_dequeue(queue, &item) == 0; ) {
+			// Empty it.
+		}
+		queue_destroy(queue);
+		free(picks);
+		free(data);
+	}
+
+	return 0;
+}
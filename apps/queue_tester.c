@@ -93,14 +93,12 @@ void queue_destroy_null(void)
 /* Enqueue Null */
 void queue_enqueue_null(void)
 {
-	int data = NULL, *ptr;
 	queue_t q;
 
 	fprintf(stderr, "*** TEST queue_enqueue_null ***\n");
 
 	q = queue_create();
-	queue_enqueue(q, &data);
-	TEST_ASSERT(ptr == -1);
+	TEST_ASSERT(queue_enqueue(q, NULL) == -1);
 }
 
 /* Dequeue Null */
@@ -112,8 +110,7 @@ void queue_dequeue_null(void)
 	fprintf(stderr, "*** TEST queue_dequeue_null ***\n");
 
 	q = queue_create();
-	queue_dequeue(q, (void**)&ptr);
-	TEST_ASSERT(ptr == -1);
+	TEST_ASSERT(queue_dequeue(q, (void**)&ptr) == -1);
 }
 
 /* Queue Delete */
@@ -130,7 +127,7 @@ void queue_delete_test(void)
 	queue_enqueue(q, &data1);
 	queue_enqueue(q, &data2);
 	queue_enqueue(q, &data3);
-	queue_delete(q, (void*)2);
+	queue_delete(q, &data2);
 	TEST_ASSERT(queue_length(q) == 2);
 }
 
@@ -215,6 +212,182 @@ void queue_length_check(void)
 	TEST_ASSERT(queue_length(q) == sizeof(data) / sizeof(data[0]));
 }
 
+/* Find: items anywhere in the queue, also once it wrapped around */
+void queue_find_test(void)
+{
+	int data[100];
+	int other = 0, *ptr;
+	queue_t q;
+
+	fprintf(stderr, "*** TEST queue_find ***\n");
+
+	q = queue_create();
+	TEST_ASSERT(queue_find(q, &data[0]) == -1);
+	TEST_ASSERT(queue_find(q, NULL) == -1);
+	TEST_ASSERT(queue_find(NULL, &data[0]) == -1);
+
+	// Move the head, so that the last items wrap around the ring.
+	for (int i = 0; i < 20; i++) {
+		queue_enqueue(q, &other);
+		queue_dequeue(q, (void**)&ptr);
+	}
+
+	for (int i = 0; i < 100; i++) {
+		queue_enqueue(q, &data[i]);
+	}
+
+	int found = 0;
+	for (int i = 0; i < 100; i++) {
+		found += queue_find(q, &data[i]) == 0;
+	}
+
+	TEST_ASSERT(found == 100);
+	TEST_ASSERT(queue_find(q, &other) == -1);
+}
+
+/* Delete: the other items keep their order, from either end */
+void queue_delete_order(void)
+{
+	int data[10];
+	int *ptr, ordered = 1;
+	queue_t q;
+
+	fprintf(stderr, "*** TEST queue_delete_order ***\n");
+
+	q = queue_create();
+	for (int i = 0; i < 10; i++) {
+		queue_enqueue(q, &data[i]);
+	}
+
+	TEST_ASSERT(queue_delete(q, &data[1]) == 0);
+	TEST_ASSERT(queue_delete(q, &data[8]) == 0);
+	TEST_ASSERT(queue_delete(q, &data[8]) == -1);
+	TEST_ASSERT(queue_length(q) == 8);
+
+	int expected[8] = { 0, 2, 3, 4, 5, 6, 7, 9 };
+	for (int i = 0; i < 8; i++) {
+		queue_dequeue(q, (void**)&ptr);
+		ordered &= ptr == &data[expected[i]];
+	}
+
+	TEST_ASSERT(ordered);
+	TEST_ASSERT(queue_destroy(q) == 0);
+}
+
+/* Deletion from a queue whose items wrap around the end of its storage */
+void queue_delete_wrap(void)
+{
+	int data[26];
+	int *ptr, ordered = 1;
+	queue_t q;
+
+	fprintf(stderr, "*** TEST queue_delete_wrap ***\n");
+
+	q = queue_create();
+	for (int i = 0; i < 16; i++) {
+		queue_enqueue(q, &data[i]);
+	}
+	for (int i = 0; i < 10; i++) {
+		queue_dequeue(q, (void**)&ptr);
+	}
+	for (int i = 16; i < 26; i++) {
+		queue_enqueue(q, &data[i]);
+	}
+
+	// Oldest, newest, then either side of the wrap.
+	TEST_ASSERT(queue_delete(q, &data[10]) == 0);
+	TEST_ASSERT(queue_delete(q, &data[25]) == 0);
+	TEST_ASSERT(queue_delete(q, &data[14]) == 0);
+	TEST_ASSERT(queue_delete(q, &data[17]) == 0);
+	TEST_ASSERT(queue_delete(q, &data[22]) == 0);
+	TEST_ASSERT(queue_length(q) == 11);
+
+	int expected[11] = { 11, 12, 13, 15, 16, 18, 19, 20, 21, 23, 24 };
+	for (int i = 0; i < 11; i++) {
+		queue_dequeue(q, (void**)&ptr);
+		ordered &= ptr == &data[expected[i]];
+	}
+
+	TEST_ASSERT(ordered);
+	TEST_ASSERT(queue_destroy(q) == 0);
+}
+
+static int delete_visited(queue_t q, void *data, void *arg)
+{
+	int *visits = arg;
+
+	visits[*(int*)data]++;
+
+	// Delete the item being visited, and the one after it.
+	queue_delete(q, data);
+	if (*(int*)data % 2 == 0) {
+		queue_delete(q, (int*)data + 1);
+	}
+
+	return 0;
+}
+
+/* Iteration: items deleted by the callback are not visited */
+void queue_iterate_delete(void)
+{
+	int data[10] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+	int visits[10] = { 0 };
+	int *ptr;
+	queue_t q;
+
+	fprintf(stderr, "*** TEST queue_iterate_delete ***\n");
+
+	q = queue_create();
+	for (int i = 0; i < 10; i++) {
+		queue_enqueue(q, &data[i]);
+	}
+
+	TEST_ASSERT(queue_iterate(q, delete_visited, visits, NULL) == 0);
+
+	int once = 1;
+	for (int i = 0; i < 10; i++) {
+		once &= visits[i] == (i % 2 == 0);
+	}
+
+	TEST_ASSERT(once);
+	TEST_ASSERT(queue_length(q) == 0);
+	TEST_ASSERT(queue_dequeue(q, (void**)&ptr) == -1);
+	TEST_ASSERT(queue_destroy(q) == 0);
+}
+
+/* Splice: items move to the back of the other queue, in order */
+void queue_splice_test(void)
+{
+	int data[40];
+	int *ptr, ordered = 1;
+	queue_t q1, q2;
+
+	fprintf(stderr, "*** TEST queue_splice ***\n");
+
+	q1 = queue_create();
+	q2 = queue_create();
+	for (int i = 0; i < 10; i++) {
+		queue_enqueue(q1, &data[i]);
+	}
+	for (int i = 10; i < 40; i++) {
+		queue_enqueue(q2, &data[i]);
+	}
+
+	TEST_ASSERT(queue_splice(q1, q1) == -1);
+	TEST_ASSERT(queue_splice(q1, q2) == 0);
+	TEST_ASSERT(queue_length(q1) == 40);
+	TEST_ASSERT(queue_length(q2) == 0);
+
+	for (int i = 0; i < 40; i++) {
+		queue_dequeue(q1, (void**)&ptr);
+		ordered &= ptr == &data[i];
+	}
+
+	TEST_ASSERT(ordered);
+	TEST_ASSERT(queue_destroy(q1) == 0);
+	TEST_ASSERT(queue_destroy(q2) == 0);
+}
+
 int main(void)
 {
 	test_create();
@@ -228,6 +401,11 @@ int main(void)
 	test_iteration();
 	erroneous_iteration();
 	queue_length_check();
+	queue_find_test();
+	queue_delete_order();
+	queue_delete_wrap();
+	queue_iterate_delete();
+	queue_splice_test();
 	
 	return 0;
 }
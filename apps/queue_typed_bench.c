@@ -0,0 +1,144 @@
+/*
+ * Typed queue benchmark
+ *
+ * Moves small records (two ints and a pointer) through a queue in batches:
+ * enqueue a batch, dequeue it, summing a field of each record. With queue_t,
+ * each record is allocated before being enqueued and freed once dequeued, as
+ * callers do with data that does not outlive the queue. With QUEUE_DEFINE()
+ * and QUEUE_DEFINE_FIXED(), records are copied in and out of the ring.
+ *
+ * Usage: queue_typed_bench [batch...]
+ *
+ * Build with -O2.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "queue.h"
+#include "queue_typed.h"
+
+#define ITEMS (1 << 22)
+#define FIXED_CAPACITY 4096
+
+struct record {
+	int id;
+	int weight;
+	void *owner;
+};
+
+QUEUE_DEFINE(record_queue, struct record)
+QUEUE_DEFINE_FIXED(record_ring, struct record, FIXED_CAPACITY)
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double bench_queue(int batch, long long *sum)
+{
+	queue_t queue = queue_create();
+	struct record *r;
+
+	double start = now();
+	for (int done = 0; done < ITEMS; done += batch) {
+		for (int i = 0; i < batch; i++) {
+			r = malloc(sizeof(struct record));
+			*r = (struct record){ i, 1, NULL };
+			queue_enqueue(queue, r);
+		}
+		for (int i = 0; i < batch; i++) {
+			if (queue_dequeue(queue, (void **)&r) == 0) {
+				*sum += r->weight;
+				free(r);
+			}
+		}
+	}
+	double elapsed = now() - start;
+
+	queue_destroy(queue);
+	return elapsed * 1e9 / ITEMS;
+}
+
+static double bench_typed(int batch, long long *sum)
+{
+	record_queue_t queue;
+	struct record r;
+
+	record_queue_init(&queue);
+
+	double start = now();
+	for (int done = 0; done < ITEMS; done += batch) {
+		for (int i = 0; i < batch; i++) {
+			record_queue_enqueue(&queue, (struct record){ i, 1, NULL });
+		}
+		for (int i = 0; i < batch; i++) {
+			if (record_queue_dequeue(&queue, &r) == 0) {
+				*sum += r.weight;
+			}
+		}
+	}
+	double elapsed = now() - start;
+
+	record_queue_destroy(&queue);
+	return elapsed * 1e9 / ITEMS;
+}
+
+static double bench_fixed(int batch, long long *sum)
+{
+	record_ring_t queue;
+	struct record r;
+
+	record_ring_init(&queue);
+
+	double start = now();
+	for (int done = 0; done < ITEMS; done += batch) {
+		for (int i = 0; i < batch; i++) {
+			record_ring_enqueue(&queue, (struct record){ i, 1, NULL });
+		}
+		for (int i = 0; i < batch; i++) {
+			if (record_ring_dequeue(&queue, &r) == 0) {
+				*sum += r.weight;
+			}
+		}
+	}
+	double elapsed = now() - start;
+
+	record_ring_destroy(&queue);
+	return elapsed * 1e9 / ITEMS;
+}
+
+int main(int argc, char **argv)
+{
+	int defaults[] = { 16, 256, 4096 };
+	int count = argc > 1 ? argc - 1 : 3;
+
+	for (int i = 0; i < count; i++) {
+		int batch = argc > 1 ? atoi(argv[i + 1]) : defaults[i];
+		long long sums[3] = { 0, 0, 0 };
+
+		if (batch <= 0 || batch > FIXED_CAPACITY) {
+			fprintf(stderr, "batch must be between 1 and %d\n",
+				FIXED_CAPACITY);
+			return 1;
+		}
+
+		double boxed = bench_queue(batch, &sums[0]);
+		double typed = bench_typed(batch, &sums[1]);
+		double fixed = bench_fixed(batch, &sums[2]);
+
+		if (sums[0] != sums[1] || sums[0] != sums[2]) {
+			fprintf(stderr, "checksum mismatch\n");
+			return 1;
+		}
+
+		printf("batch %5d: queue_t %6.1f ns/item, QUEUE_DEFINE %5.2f "
+		       "ns/item (x%.0f), QUEUE_DEFINE_FIXED %5.2f ns/item\n",
+		       batch, boxed, typed, boxed / typed, fixed);
+	}
+
+	return 0;
+}
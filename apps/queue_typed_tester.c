@@ -0,0 +1,134 @@
+/*
+ * Typed queue tester
+ *
+ * Checks FIFO order of items stored by value, growth of the ring while it
+ * wraps around, and the full and empty cases of a fixed-capacity queue.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "queue_typed.h"
+
+#define TEST_ASSERT(assert)				\
+do {									\
+	printf("ASSERT: " #assert " ... ");	\
+	if (assert) {						\
+		printf("PASS\n");				\
+	} else	{							\
+		printf("FAIL\n");				\
+		exit(1);						\
+	}									\
+} while(0)
+
+struct record {
+	int id;
+	int weight;
+	void *owner;
+};
+
+QUEUE_DEFINE(record_queue, struct record)
+QUEUE_DEFINE_FIXED(int_ring, int, 8)
+
+/* Records come out by value, in order */
+void test_simple(void)
+{
+	record_queue_t q;
+	struct record r;
+
+	fprintf(stderr, "*** TEST simple ***\n");
+
+	record_queue_init(&q);
+	TEST_ASSERT(record_queue_length(&q) == 0);
+	TEST_ASSERT(record_queue_dequeue(&q, &r) == -1);
+	TEST_ASSERT(record_queue_destroy(&q) == 0);
+
+	record_queue_enqueue(&q, (struct record){ 1, 10, &q });
+	record_queue_enqueue(&q, (struct record){ 2, 20, NULL });
+	TEST_ASSERT(record_queue_length(&q) == 2);
+
+	TEST_ASSERT(record_queue_peek(&q, &r) == 0);
+	TEST_ASSERT(r.id == 1 && record_queue_length(&q) == 2);
+
+	record_queue_dequeue(&q, &r);
+	TEST_ASSERT(r.id == 1 && r.weight == 10 && r.owner == &q);
+	TEST_ASSERT(record_queue_destroy(&q) == -1);
+	record_queue_dequeue(&q, &r);
+	TEST_ASSERT(r.id == 2 && r.weight == 20 && r.owner == NULL);
+	TEST_ASSERT(record_queue_destroy(&q) == 0);
+}
+
+/* The ring grows while its items wrap around, and keeps them in order */
+void test_grow(void)
+{
+	record_queue_t q;
+	struct record r;
+	int next = 0, expected = 0, ordered = 1;
+
+	fprintf(stderr, "*** TEST grow ***\n");
+
+	record_queue_init(&q);
+
+	// Take out fewer than put in, so the head keeps moving past the end.
+	for (int round = 0; round < 1000; round++) {
+		for (int i = 0; i < 3; i++) {
+			record_queue_enqueue(&q, (struct record){ next++, 0, NULL });
+		}
+		for (int i = 0; i < 2; i++) {
+			ordered &= record_queue_dequeue(&q, &r) == 0 &&
+				   r.id == expected++;
+		}
+	}
+
+	TEST_ASSERT(record_queue_length(&q) == 1000);
+
+	while (record_queue_dequeue(&q, &r) == 0) {
+		ordered &= r.id == expected++;
+	}
+
+	TEST_ASSERT(ordered);
+	TEST_ASSERT(expected == next);
+	TEST_ASSERT(record_queue_destroy(&q) == 0);
+}
+
+/* A fixed queue refuses items when full, and wraps around */
+void test_fixed(void)
+{
+	int_ring_t q;
+	int value, ordered = 1;
+
+	fprintf(stderr, "*** TEST fixed ***\n");
+
+	int_ring_init(&q);
+	for (int i = 0; i < 8; i++) {
+		int_ring_enqueue(&q, i);
+	}
+
+	TEST_ASSERT(int_ring_length(&q) == 8);
+	TEST_ASSERT(int_ring_enqueue(&q, 8) == -1);
+	TEST_ASSERT(int_ring_destroy(&q) == -1);
+
+	for (int i = 0; i < 100; i++) {
+		ordered &= int_ring_dequeue(&q, &value) == 0 && value == i;
+		ordered &= int_ring_enqueue(&q, i + 8) == 0;
+	}
+
+	TEST_ASSERT(ordered);
+	TEST_ASSERT(int_ring_length(&q) == 8);
+
+	while (int_ring_dequeue(&q, &value) == 0) {
+		// Empty it.
+	}
+
+	TEST_ASSERT(value == 107);
+	TEST_ASSERT(int_ring_destroy(&q) == 0);
+}
+
+int main(void)
+{
+	test_simple();
+	test_grow();
+	test_fixed();
+
+	return 0;
+}
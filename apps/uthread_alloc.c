@@ -0,0 +1,148 @@
+/*
+ * Thread arena test and benchmark
+ *
+ * Checks that memory from uthread_alloc() is aligned, distinct and writable,
+ * including large blocks, then runs many short-lived threads each making
+ * small allocations, with malloc()/free() and with uthread_alloc().
+ *
+ * Usage: uthread_alloc [threads]
+ *	At most 16000 threads, as each of the four runs takes that many TIDs
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <uthread.h>
+
+#define TEST_ASSERT(assert)				\
+do {									\
+	printf("ASSERT: " #assert " ... ");	\
+	if (assert) {						\
+		printf("PASS\n");				\
+	} else	{							\
+		printf("FAIL\n");				\
+		exit(1);						\
+	}									\
+} while(0)
+
+#define ALLOCS 64
+
+static int useArena;
+static volatile uintptr_t sink;
+
+/* Time spent allocating and freeing, in seconds, summed over threads */
+static double allocTime;
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int checker(void)
+{
+	char *blocks[1000];
+
+	for (int i = 0; i < 1000; i++) {
+		size_t size = 1 + i % 300;
+
+		blocks[i] = uthread_alloc(size);
+		if (blocks[i] == NULL || (uintptr_t)blocks[i] % 16 != 0) {
+			return 1;
+		}
+		memset(blocks[i], i & 0xff, size);
+	}
+
+	// Every block kept its own content.
+	for (int i = 0; i < 1000; i++) {
+		if (blocks[i][i % 300] != (char)(i & 0xff)) {
+			return 1;
+		}
+	}
+
+	char *large = uthread_alloc(1 << 20);
+	if (large == NULL) {
+		return 1;
+	}
+	memset(large, 1, 1 << 20);
+
+	return uthread_alloc(0) != NULL;
+}
+
+int worker(void)
+{
+	void *blocks[ALLOCS];
+	double start = now();
+
+	for (int i = 0; i < ALLOCS; i++) {
+		size_t size = 32 + (i * 37) % 224;
+
+		blocks[i] = useArena ? uthread_alloc(size) : malloc(size);
+		memset(blocks[i], i, size);
+		sink += (uintptr_t)blocks[i];
+	}
+
+	if (!useArena) {
+		for (int i = 0; i < ALLOCS; i++) {
+			free(blocks[i]);
+		}
+	}
+
+	// The arena is released when the thread is destroyed, right after.
+	allocTime += now() - start;
+	return 0;
+}
+
+static double bench(int threads, int arena)
+{
+	useArena = arena;
+	allocTime = 0;
+
+	for (int i = 0; i < threads; i++) {
+		uthread_t tid = uthread_create(worker);
+
+		// Keep a handful of threads alive at a time.
+		if (i % 16 == 15) {
+			uthread_yield();
+		}
+		uthread_detach(tid);
+	}
+	uthread_yield();
+
+	return allocTime * 1e9 / threads;
+}
+
+int main(int argc, char **argv)
+{
+	int threads = argc > 1 ? atoi(argv[1]) : 15000;
+	int retval;
+
+	TEST_ASSERT(uthread_alloc(16) == NULL);
+
+	uthread_start(0);
+
+	uthread_t tid = uthread_create(checker);
+	TEST_ASSERT(uthread_join(tid, &retval) == 0 && retval == 0);
+	TEST_ASSERT(uthread_alloc(16) != NULL);
+
+	// TIDs are not reused: four runs must fit in the TID space.
+	if (threads > 16000) {
+		threads = 16000;
+	}
+
+	for (int round = 0; round < 2; round++) {
+		double mallocNs = bench(threads, 0);
+		double arenaNs = bench(threads, 1);
+
+		printf("%d threads x %d allocations: malloc %.1f ns/thread, "
+		       "uthread_alloc %.1f ns/thread\n", threads, ALLOCS,
+		       mallocNs, arenaNs);
+	}
+
+	uthread_stop();
+	return 0;
+}
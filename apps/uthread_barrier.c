@@ -0,0 +1,244 @@
+/*
+ * Barrier and latch test and benchmark
+ *
+ * Checks that no thread leaves a barrier phase before all threads reached it,
+ * that exactly one thread per phase is told it arrived last, that a latch
+ * releases its waiters once counted down, and that waiting with nobody left
+ * to arrive fails.
+ *
+ * Then runs the same phased computation, where threads reach the end of each
+ * phase at different times, with a barrier emulated by a shared counter and a
+ * uthread_yield() spin, and with uthread_barrier_wait(). Reports the context
+ * switches and the time per phase.
+ *
+ * Usage: uthread_barrier [threads] [phases]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <uthread.h>
+
+#define TEST_ASSERT(assert)				\
+do {									\
+	printf("ASSERT: " #assert " ... ");	\
+	if (assert) {						\
+		printf("PASS\n");				\
+	} else	{							\
+		printf("FAIL\n");				\
+		exit(1);						\
+	}									\
+} while(0)
+
+#define TEST_THREADS 4
+#define TEST_PHASES 3
+
+static uthread_barrier_t barrier;
+static uthread_latch_t latch;
+static int phase[TEST_THREADS];
+static int lastArrivals[TEST_PHASES];
+static int inOrder = 1;
+static int started;
+static int released;
+
+static int numThreads;
+static int numPhases;
+static volatile long sink;
+
+/* Emulated barrier: arrivals in the current generation */
+static int spinArrived;
+static int spinGeneration;
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int phased(void)
+{
+	int self = started++;
+
+	for (int p = 0; p < TEST_PHASES; p++) {
+		phase[self] = p;
+
+		if (uthread_barrier_wait(barrier) == 1) {
+			lastArrivals[p]++;
+		}
+
+		// Everybody reached phase p before anybody left it.
+		for (int i = 0; i < TEST_THREADS; i++) {
+			inOrder &= phase[i] >= p;
+		}
+	}
+
+	return 0;
+}
+
+int latchWaiter(void)
+{
+	uthread_latch_wait(latch);
+	released++;
+	return 0;
+}
+
+void test_barrier(void)
+{
+	uthread_t tids[TEST_THREADS];
+
+	fprintf(stderr, "*** TEST barrier ***\n");
+
+	TEST_ASSERT(uthread_barrier_create(0) == NULL);
+
+	barrier = uthread_barrier_create(TEST_THREADS);
+	for (int i = 0; i < TEST_THREADS; i++) {
+		tids[i] = uthread_create(phased);
+	}
+	uthread_join_all(tids, TEST_THREADS, NULL);
+
+	int once = 1;
+	for (int p = 0; p < TEST_PHASES; p++) {
+		once &= lastArrivals[p] == 1;
+	}
+
+	TEST_ASSERT(inOrder);
+	TEST_ASSERT(once);
+	TEST_ASSERT(uthread_barrier_destroy(barrier) == 0);
+
+	// Nobody else can arrive: the wait fails instead of hanging.
+	barrier = uthread_barrier_create(2);
+	TEST_ASSERT(uthread_barrier_wait(barrier) == -1);
+	TEST_ASSERT(uthread_barrier_destroy(barrier) == 0);
+}
+
+void test_latch(void)
+{
+	uthread_t tids[TEST_THREADS];
+
+	fprintf(stderr, "*** TEST latch ***\n");
+
+	TEST_ASSERT(uthread_latch_create(-1) == NULL);
+
+	latch = uthread_latch_create(2);
+	for (int i = 0; i < TEST_THREADS; i++) {
+		tids[i] = uthread_create(latchWaiter);
+	}
+
+	// Let them block.
+	uthread_yield();
+	TEST_ASSERT(released == 0);
+	TEST_ASSERT(uthread_latch_destroy(latch) == -1);
+
+	uthread_latch_count_down(latch);
+	uthread_yield();
+	TEST_ASSERT(released == 0);
+
+	uthread_latch_count_down(latch);
+	uthread_join_all(tids, TEST_THREADS, NULL);
+	TEST_ASSERT(released == TEST_THREADS);
+
+	// Open for good.
+	TEST_ASSERT(uthread_latch_wait(latch) == 0);
+	TEST_ASSERT(uthread_latch_count_down(latch) == -1);
+	TEST_ASSERT(uthread_latch_destroy(latch) == 0);
+}
+
+/*
+ * work - Phase @p of thread @self
+ *
+ * Uneven on purpose: thread @self gives the CPU up @self % 8 times, as when
+ * waiting for I/O, so that threads reach the barrier at different times.
+ */
+static void work(int self, int p)
+{
+	for (int chunk = 0; chunk <= self % 8; chunk++) {
+		for (int i = 0; i < 100; i++) {
+			sink += self ^ p ^ i;
+		}
+
+		if (chunk < self % 8) {
+			uthread_yield();
+		}
+	}
+}
+
+int spinWorker(void)
+{
+	for (int p = 0; p < numPhases; p++) {
+		work(uthread_self(), p);
+
+		int generation = spinGeneration;
+
+		if (++spinArrived == numThreads) {
+			spinArrived = 0;
+			spinGeneration++;
+		} else {
+			while (spinGeneration == generation) {
+				uthread_yield();
+			}
+		}
+	}
+
+	return 0;
+}
+
+int barrierWorker(void)
+{
+	for (int p = 0; p < numPhases; p++) {
+		work(uthread_self(), p);
+		uthread_barrier_wait(barrier);
+	}
+
+	return 0;
+}
+
+static void bench(const char *name, uthread_func_t worker)
+{
+	uthread_t *tids = malloc(numThreads * sizeof(uthread_t));
+	struct uthread_stats before, after;
+
+	uthread_start(0);
+	barrier = uthread_barrier_create(numThreads);
+
+	uthread_stats_snapshot(&before);
+	double start = now();
+	for (int i = 0; i < numThreads; i++) {
+		tids[i] = uthread_create(worker);
+	}
+	uthread_join_all(tids, numThreads, NULL);
+	double elapsed = now() - start;
+	uthread_stats_snapshot(&after);
+
+	printf("%-22s %10.1f switches/phase (%.2f per thread), %8.1f us/phase\n",
+	       name, (double)(after.switches - before.switches) / numPhases,
+	       (double)(after.switches - before.switches) / numPhases /
+	       numThreads, elapsed * 1e6 / numPhases);
+
+	uthread_barrier_destroy(barrier);
+	uthread_stop();
+	free(tids);
+}
+
+int main(int argc, char **argv)
+{
+	numThreads = argc > 1 ? atoi(argv[1]) : 256;
+	numPhases = argc > 2 ? atoi(argv[2]) : 100;
+
+	uthread_start(0);
+	test_barrier();
+	test_latch();
+	uthread_stop();
+
+	if (numThreads < 1 || numPhases < 1) {
+		fprintf(stderr, "threads and phases must be positive\n");
+		return 1;
+	}
+
+	printf("%d threads, %d phases\n", numThreads, numPhases);
+	bench("counter + yield spin", spinWorker);
+	bench("uthread_barrier_wait", barrierWorker);
+
+	return 0;
+}
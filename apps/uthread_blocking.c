@@ -0,0 +1,68 @@
+/*
+ * Blocking call offloading test
+ *
+ * Thread 1 performs a slow blocking call (a 200ms sleep standing in for fsync()
+ * or getaddrinfo()) through uthread_blocking_call(). Meanwhile, thread 2 keeps
+ * running and yielding, and main joins thread 1 while it is still blocked.
+ * The program should output:
+ *
+ * thread1: blocking
+ * thread2: tick 0
+ * thread2: tick 1
+ * thread2: tick 2
+ * thread1: done, result 42
+ * thread1 returned 42
+ *
+ * Build with -pthread.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <uthread.h>
+
+static volatile int thread1Done = 0;
+
+long slow_call(void *arg)
+{
+	usleep(200000);
+	return (long)arg;
+}
+
+int thread2(void)
+{
+	// Keeps running while thread 1 waits on its helper.
+	for (int i = 0; !thread1Done; i++) {
+		if (i < 3) {
+			printf("thread2: tick %d\n", i);
+		}
+		usleep(1000);
+		uthread_yield();
+	}
+	return 0;
+}
+
+int thread1(void)
+{
+	printf("thread1: blocking\n");
+	long result = uthread_blocking_call(slow_call, (void*)42);
+	printf("thread1: done, result %ld\n", result);
+	thread1Done = 1;
+	return (int)result;
+}
+
+int main(void)
+{
+	int retval = 0;
+
+	uthread_start(0);
+	uthread_t tid1 = uthread_create(thread1);
+	uthread_t tid2 = uthread_create(thread2);
+	uthread_join(tid1, &retval);
+	printf("thread1 returned %d\n", retval);
+	uthread_join(tid2, NULL);
+	uthread_stop();
+
+	return 0;
+}
@@ -0,0 +1,134 @@
+/*
+ * EDF deadline benchmark
+ *
+ * Worker threads serve requests back to back, each request being a few chunks
+ * of work separated by yields, and set a deadline when starting each request.
+ * Half of the workers have tight deadlines, the other half loose ones. As the
+ * number of workers grows, the CPU gets overloaded and deadlines start being
+ * missed. Reports the miss rate under FIFO and under EDF for each load.
+ *
+ * Usage: uthread_edf_bench [milliseconds]
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <uthread.h>
+
+#define TEST_ASSERT(assert)				\
+do {									\
+	printf("ASSERT: " #assert " ... ");	\
+	if (assert) {						\
+		printf("PASS\n");				\
+	} else	{							\
+		printf("FAIL\n");				\
+		exit(1);						\
+	}									\
+} while(0)
+
+#define MAX_WORKERS 32
+#define STEPS 5
+#define TIGHT_NS 2000000LL
+#define LOOSE_NS 40000000LL
+
+static long long stopAt;
+static long requestCount;
+static volatile uint64_t sink;
+
+static long long now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void step(void)
+{
+	// About fifty microseconds of work.
+	for (int i = 0; i < 16000; i++) {
+		sink += i;
+	}
+}
+
+static int worker(long long slack)
+{
+	while (now_ns() < stopAt) {
+		uthread_set_deadline(uthread_self(), now_ns() + slack);
+		for (int i = 0; i < STEPS; i++) {
+			step();
+			uthread_yield();
+		}
+		requestCount++;
+	}
+
+	// Settle the deadline of the last request.
+	uthread_set_deadline(uthread_self(), 0);
+	return 0;
+}
+
+int tight(void)
+{
+	return worker(TIGHT_NS);
+}
+
+int loose(void)
+{
+	return worker(LOOSE_NS);
+}
+
+/*
+ * run - Serve requests with @workers threads for @ms milliseconds
+ *
+ * Return: Fraction of the requests that missed their deadline.
+ */
+static double run(int policy, int workers, int ms)
+{
+	uthread_t tids[MAX_WORKERS];
+
+	uthread_start_sched(0, policy);
+
+	requestCount = 0;
+	stopAt = now_ns() + ms * 1000000LL;
+
+	for (int i = 0; i < workers; i++) {
+		tids[i] = uthread_create(i % 2 ? loose : tight);
+	}
+	uthread_join_all(tids, workers, NULL);
+
+	double rate = (double)uthread_deadline_misses() / requestCount;
+	uthread_stop();
+
+	return rate;
+}
+
+int main(int argc, char **argv)
+{
+	int ms = argc > 1 ? atoi(argv[1]) : 200;
+	int loads[] = { 4, 8, 16, MAX_WORKERS };
+	double fifo = 0, edf = 0;
+
+	for (int i = 0; i < 4; i++) {
+		fprintf(stderr, "*** BENCH %d workers ***\n", loads[i]);
+
+		fifo = run(UTHREAD_SCHED_FIFO, loads[i], ms);
+		edf = run(UTHREAD_SCHED_EDF, loads[i], ms);
+
+		printf("%2d workers: fifo %5.1f%% missed, edf %5.1f%% missed\n",
+				loads[i], fifo * 100, edf * 100);
+	}
+
+	TEST_ASSERT(edf < fifo);
+
+	fprintf(stderr, "*** TEST deadline_misses ***\n");
+
+	uthread_start_sched(0, UTHREAD_SCHED_EDF);
+	TEST_ASSERT(uthread_set_deadline(1, 1) == -1);
+	TEST_ASSERT(uthread_set_deadline(0, 1) == 0);
+	TEST_ASSERT(uthread_set_deadline(0, 0) == 0);
+	TEST_ASSERT(uthread_deadline_misses() == 1);
+	uthread_stop();
+
+	return 0;
+}
@@ -0,0 +1,149 @@
+/*
+ * Local file throughput benchmark
+ *
+ * A number of threads write, flush, and then read back a scratch file in
+ * fixed-size chunks, each thread handling its own region of the file. The same
+ * workload runs first with plain pwrite()/fsync()/pread(), which stall every
+ * thread, then with uthread_pwrite()/uthread_fsync()/uthread_pread(). The data
+ * read back is checked against what was written.
+ *
+ * Run with UTHREAD_IO_URING=0 in the environment to measure the helper pool
+ * fallback instead of io_uring.
+ *
+ * Usage: uthread_io_bench [threads] [MiB] [scratch file]
+ *
+ * Build with -O2 -pthread.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <uthread.h>
+
+#define CHUNK_SIZE (64 * 1024)
+
+static int fd;
+static int numThreads;
+static long chunksPerThread;
+static int useUthreadIO;
+static int nextIndex;
+static int failures;
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int writer(void)
+{
+	int index = nextIndex++;
+	char *buf = malloc(CHUNK_SIZE);
+
+	for (long c = 0; c < chunksPerThread; c++) {
+		off_t offset = (index * chunksPerThread + c) * CHUNK_SIZE;
+		memset(buf, (int)(offset / CHUNK_SIZE) & 0xff, CHUNK_SIZE);
+
+		ssize_t written = useUthreadIO
+			? uthread_pwrite(fd, buf, CHUNK_SIZE, offset)
+			: pwrite(fd, buf, CHUNK_SIZE, offset);
+
+		if (written != CHUNK_SIZE) {
+			failures++;
+		}
+	}
+
+	if ((useUthreadIO ? uthread_fsync(fd) : fsync(fd)) == -1) {
+		failures++;
+	}
+
+	free(buf);
+	return 0;
+}
+
+static int reader(void)
+{
+	int index = nextIndex++;
+	char *buf = malloc(CHUNK_SIZE);
+
+	for (long c = 0; c < chunksPerThread; c++) {
+		off_t offset = (index * chunksPerThread + c) * CHUNK_SIZE;
+
+		ssize_t got = useUthreadIO
+			? uthread_pread(fd, buf, CHUNK_SIZE, offset)
+			: pread(fd, buf, CHUNK_SIZE, offset);
+
+		if (got != CHUNK_SIZE ||
+		    buf[0] != (char)((offset / CHUNK_SIZE) & 0xff) ||
+		    buf[CHUNK_SIZE - 1] != buf[0]) {
+			failures++;
+		}
+	}
+
+	free(buf);
+	return 0;
+}
+
+static double phase(uthread_func_t func)
+{
+	uthread_t tids[numThreads];
+
+	nextIndex = 0;
+	double start = now();
+
+	for (int i = 0; i < numThreads; i++) {
+		tids[i] = uthread_create(func);
+	}
+
+	for (int i = 0; i < numThreads; i++) {
+		uthread_join(tids[i], NULL);
+	}
+
+	return now() - start;
+}
+
+int main(int argc, char **argv)
+{
+	numThreads = argc > 1 ? atoi(argv[1]) : 16;
+	long mib = argc > 2 ? atol(argv[2]) : 256;
+	const char *path = argc > 3 ? argv[3] : "uthread_io_bench.tmp";
+
+	chunksPerThread = mib * 1024 * 1024 / CHUNK_SIZE / numThreads;
+	double total = (double)numThreads * chunksPerThread * CHUNK_SIZE /
+		       (1024 * 1024);
+
+	fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (fd == -1) {
+		perror("open");
+		return 1;
+	}
+
+	uthread_start(0);
+
+	printf("%d threads, %.0f MiB, %d KiB chunks\n", numThreads, total,
+	       CHUNK_SIZE / 1024);
+	printf("mode             write+fsync MiB/s  read MiB/s  check\n");
+
+	for (useUthreadIO = 0; useUthreadIO <= 1; useUthreadIO++) {
+		failures = 0;
+		double writeTime = phase(writer);
+		double readTime = phase(reader);
+
+		printf("%-16s %17.1f  %10.1f  %s\n",
+		       useUthreadIO ? "uthread_pread" : "pread",
+		       total / writeTime, total / readTime,
+		       failures ? "FAILED" : "ok");
+	}
+
+	uthread_stop();
+
+	close(fd);
+	unlink(path);
+
+	return 0;
+}
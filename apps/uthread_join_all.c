@@ -0,0 +1,121 @@
+/*
+ * Join-all and wait group test
+ *
+ * Fans out a thousand workers, some of which are already zombies by the time
+ * they are joined, and collects all of them with a single uthread_join_all()
+ * call. Then checks that a wait group releases its waiter once every worker is
+ * done.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <uthread.h>
+
+#define TEST_ASSERT(assert)				\
+do {									\
+	printf("ASSERT: " #assert " ... ");	\
+	if (assert) {						\
+		printf("PASS\n");				\
+	} else	{							\
+		printf("FAIL\n");				\
+		exit(1);						\
+	}									\
+} while(0)
+
+#define WORKERS 1000
+
+static uthread_wg_t wg;
+static int doneCount;
+
+int worker(void)
+{
+	// Odd workers exit at once, even ones after yielding a few times.
+	for (int i = 0; i < uthread_self() % 2 * 3; i++) {
+		uthread_yield();
+	}
+
+	return uthread_self() * 2;
+}
+
+int wg_worker(void)
+{
+	uthread_yield();
+	doneCount++;
+	uthread_wg_done(wg);
+	return 0;
+}
+
+void test_join_all(void)
+{
+	uthread_t tids[WORKERS];
+	int retvals[WORKERS];
+	int matching = 1;
+
+	fprintf(stderr, "*** TEST join_all ***\n");
+
+	for (int i = 0; i < WORKERS; i++) {
+		tids[i] = uthread_create(worker);
+	}
+
+	// Let part of the workers finish and become zombies.
+	uthread_yield();
+
+	TEST_ASSERT(uthread_join_all(tids, WORKERS, retvals) == 0);
+
+	for (int i = 0; i < WORKERS; i++) {
+		matching &= (retvals[i] == tids[i] * 2);
+	}
+	TEST_ASSERT(matching);
+
+	// Every worker was collected.
+	TEST_ASSERT(uthread_join(tids[0], NULL) == -1);
+}
+
+void test_join_all_duplicate(void)
+{
+	uthread_t tids[2];
+
+	fprintf(stderr, "*** TEST join_all_duplicate ***\n");
+
+	tids[0] = tids[1] = uthread_create(worker);
+	TEST_ASSERT(uthread_join_all(tids, 2, NULL) == -1);
+
+	// Nothing was claimed, the thread can still be joined.
+	TEST_ASSERT(uthread_join_all(tids, 1, NULL) == 0);
+}
+
+void test_wait_group(void)
+{
+	uthread_t tids[WORKERS];
+
+	fprintf(stderr, "*** TEST wait_group ***\n");
+
+	wg = uthread_wg_create();
+	TEST_ASSERT(uthread_wg_wait(wg) == 0);
+
+	uthread_wg_add(wg, WORKERS);
+	for (int i = 0; i < WORKERS; i++) {
+		tids[i] = uthread_create(wg_worker);
+	}
+
+	TEST_ASSERT(uthread_wg_wait(wg) == 0);
+	TEST_ASSERT(doneCount == WORKERS);
+	TEST_ASSERT(uthread_wg_done(wg) == -1);
+
+	uthread_join_all(tids, WORKERS, NULL);
+	TEST_ASSERT(uthread_wg_destroy(wg) == 0);
+}
+
+int main(void)
+{
+	uthread_start(0);
+
+	test_join_all();
+	test_join_all_duplicate();
+	test_wait_group();
+
+	uthread_stop();
+
+	return 0;
+}
@@ -0,0 +1,114 @@
+/*
+ * Latency histogram test
+ *
+ * Runs short interactive threads (class 1) alongside batch threads burning
+ * about 200us per slice (class 2), then prints the percentiles of the time
+ * each class spent ready and running. Batch threads must show long run
+ * lengths, and interactive threads the scheduling delay the batch threads
+ * cause them.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <uthread.h>
+
+#define TEST_ASSERT(assert)				\
+do {									\
+	printf("ASSERT: " #assert " ... ");	\
+	if (assert) {						\
+		printf("PASS\n");				\
+	} else	{							\
+		printf("FAIL\n");				\
+		exit(1);						\
+	}									\
+} while(0)
+
+#define INTERACTIVE 8
+#define BATCH 2
+#define ROUNDS 200
+
+#define CLASS_INTERACTIVE 1
+#define CLASS_BATCH 2
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int interactive(void)
+{
+	for (int i = 0; i < ROUNDS; i++) {
+		uthread_yield();
+	}
+	return 0;
+}
+
+int batch(void)
+{
+	for (int i = 0; i < ROUNDS; i++) {
+		double end = now() + 200e-6;
+
+		while (now() < end) {
+			// Burn the slice.
+		}
+		uthread_yield();
+	}
+	return 0;
+}
+
+static void report(const char *name, int cls, int hist,
+		   unsigned long long *ns)
+{
+	const double percentiles[] = { 50, 90, 99, 99.9 };
+	int count = uthread_stats_percentiles(cls, hist, percentiles, ns, 4);
+
+	printf("%-12s %-6s: %6d samples, p50 %8llu ns, p90 %8llu ns, "
+	       "p99 %8llu ns, p99.9 %8llu ns\n", name,
+	       hist == UTHREAD_HIST_DELAY ? "delay" : "run", count,
+	       ns[0], ns[1], ns[2], ns[3]);
+}
+
+int main(void)
+{
+	uthread_t tids[INTERACTIVE + BATCH];
+	unsigned long long ns[4];
+	double p50 = 50;
+
+	uthread_start(0);
+
+	TEST_ASSERT(uthread_set_class(0, UTHREAD_CLASSES) == -1);
+	TEST_ASSERT(uthread_set_class(1, 0) == -1);
+	TEST_ASSERT(uthread_stats_percentiles(-1, UTHREAD_HIST_RUN, &p50, ns,
+					      1) == -1);
+	TEST_ASSERT(uthread_stats_percentiles(0, 2, &p50, ns, 1) == -1);
+	TEST_ASSERT(uthread_stats_percentiles(CLASS_BATCH, UTHREAD_HIST_RUN,
+					      &p50, ns, 1) == 0);
+
+	for (int i = 0; i < INTERACTIVE + BATCH; i++) {
+		int isBatch = i % 5 == 4;
+
+		tids[i] = uthread_create(isBatch ? batch : interactive);
+		uthread_set_class(tids[i], isBatch ? CLASS_BATCH :
+				  CLASS_INTERACTIVE);
+	}
+
+	uthread_join_all(tids, INTERACTIVE + BATCH, NULL);
+
+	report("interactive", CLASS_INTERACTIVE, UTHREAD_HIST_DELAY, ns);
+	TEST_ASSERT(ns[0] >= 200000);
+	report("interactive", CLASS_INTERACTIVE, UTHREAD_HIST_RUN, ns);
+	TEST_ASSERT(ns[0] < 50000);
+	report("batch", CLASS_BATCH, UTHREAD_HIST_DELAY, ns);
+	report("batch", CLASS_BATCH, UTHREAD_HIST_RUN, ns);
+	TEST_ASSERT(ns[0] >= 190000 && ns[0] < 1000000);
+
+	TEST_ASSERT(uthread_stats_percentiles(CLASS_BATCH, UTHREAD_HIST_RUN,
+					      &p50, ns, 1) > BATCH * ROUNDS);
+
+	uthread_stop();
+	return 0;
+}
@@ -0,0 +1,197 @@
+/*
+ * Thread-local storage test
+ *
+ * Threads set values for keys held inline in the TCB and for keys spilled to
+ * the heap, yield to each other and check that their values were kept apart.
+ * Destructors must run once per value on exit, including values set again by
+ * a destructor. Then compares the cost of uthread_getspecific() with a side
+ * table keyed by uthread_self().
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <uthread.h>
+
+#define TEST_ASSERT(assert)				\
+do {									\
+	printf("ASSERT: " #assert " ... ");	\
+	if (assert) {						\
+		printf("PASS\n");				\
+	} else	{							\
+		printf("FAIL\n");				\
+		exit(1);						\
+	}									\
+} while(0)
+
+#define THREADS 10
+#define KEYS 12
+#define LOOKUPS 10000000
+
+static int keys[KEYS];
+static int destroyed;
+static int resetKey;
+static int resets;
+
+/* Side table, what the keys replace */
+#define TABLE_SIZE 1024
+static struct {
+	int tid;
+	void *value;
+} table[TABLE_SIZE];
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void destroy(void *value)
+{
+	(void)value;
+	destroyed++;
+}
+
+/* Sets its value again once, which must make it run once more */
+static void reset(void *value)
+{
+	if (resets++ == 0) {
+		uthread_setspecific(resetKey, value);
+	}
+}
+
+int worker(void)
+{
+	uintptr_t self = uthread_self();
+
+	for (int k = 0; k < KEYS; k++) {
+		if (uthread_getspecific(keys[k]) != NULL) {
+			return 1;
+		}
+		uthread_setspecific(keys[k], (void *)(self * 100 + k));
+	}
+
+	uthread_yield();
+
+	for (int k = 0; k < KEYS; k++) {
+		if (uthread_getspecific(keys[k]) != (void *)(self * 100 + k)) {
+			return 1;
+		}
+	}
+
+	// Cleared values get no destructor call.
+	uthread_setspecific(keys[0], NULL);
+	return 0;
+}
+
+int resetter(void)
+{
+	uthread_setspecific(resetKey, (void *)1);
+	uthread_exit(0);
+	return 1;
+}
+
+static void *tableGet(int tid)
+{
+	unsigned slot = (tid * 2654435761u) % TABLE_SIZE;
+
+	while (table[slot].tid != tid) {
+		slot = (slot + 1) % TABLE_SIZE;
+	}
+	return table[slot].value;
+}
+
+static void tableSet(int tid, void *value)
+{
+	unsigned slot = (tid * 2654435761u) % TABLE_SIZE;
+
+	while (table[slot].tid != 0 && table[slot].tid != tid) {
+		slot = (slot + 1) % TABLE_SIZE;
+	}
+	table[slot].tid = tid;
+	table[slot].value = value;
+}
+
+static double lookups(int key)
+{
+	volatile uintptr_t sink = 0;
+
+	uthread_setspecific(key, (void *)&sink);
+
+	double start = now();
+	for (int i = 0; i < LOOKUPS; i++) {
+		sink += (uintptr_t)uthread_getspecific(key);
+	}
+	double elapsed = now() - start;
+
+	uthread_setspecific(key, NULL);
+	return elapsed * 1e9 / LOOKUPS;
+}
+
+int bench(void)
+{
+	volatile uintptr_t sink = 0;
+
+	double inlineNs = lookups(keys[0]);
+	double spilledNs = lookups(keys[KEYS - 1]);
+
+	tableSet(uthread_self(), (void *)&sink);
+
+	double start = now();
+	for (int i = 0; i < LOOKUPS; i++) {
+		sink += (uintptr_t)tableGet(uthread_self());
+	}
+	double tableNs = (now() - start) * 1e9 / LOOKUPS;
+
+	printf("uthread_getspecific: %.2f ns inline, %.2f ns spilled, "
+	       "side table: %.2f ns\n", inlineNs, spilledNs, tableNs);
+	return 0;
+}
+
+int main(void)
+{
+	uthread_t tids[THREADS];
+	int retvals[THREADS];
+
+	TEST_ASSERT(uthread_setspecific(0, NULL) == -1);
+	uthread_start(0);
+
+	for (int k = 0; k < KEYS; k++) {
+		keys[k] = uthread_key_create(destroy);
+	}
+	TEST_ASSERT(keys[KEYS - 1] == KEYS - 1);
+	resetKey = uthread_key_create(reset);
+
+	TEST_ASSERT(uthread_setspecific(UTHREAD_KEYS_MAX - 1, (void *)1) == -1);
+	TEST_ASSERT(uthread_getspecific(-1) == NULL);
+
+	fprintf(stderr, "*** TEST isolation and destructors ***\n");
+
+	for (int i = 0; i < THREADS; i++) {
+		tids[i] = uthread_create(worker);
+	}
+	uthread_join_all(tids, THREADS, retvals);
+
+	for (int i = 0; i < THREADS; i++) {
+		TEST_ASSERT(retvals[i] == 0);
+	}
+	TEST_ASSERT(destroyed == THREADS * (KEYS - 1));
+
+	uthread_join(uthread_create(resetter), NULL);
+	TEST_ASSERT(resets == 2);
+
+	fprintf(stderr, "*** BENCH lookup ***\n");
+	uthread_join(uthread_create(bench), NULL);
+
+	int created = resetKey + 1;
+	while (uthread_key_create(NULL) != -1) {
+		created++;
+	}
+	TEST_ASSERT(created == UTHREAD_KEYS_MAX);
+
+	uthread_stop();
+	return 0;
+}
@@ -0,0 +1,155 @@
+/*
+ * MLFQ latency benchmark
+ *
+ * Latency threads repeatedly wait for a short blocking call, standing for a
+ * request arriving, and measure how long it takes from the completion of the
+ * call until they run again. Batch threads burn CPU in chunks between yields
+ * meanwhile. Reports the median and 99th percentile of that delay for an
+ * increasing number of batch threads, under FIFO and under MLFQ, with batch
+ * threads either left at the default priority or set to the lowest one.
+ *
+ * Usage: uthread_mlfq_bench [requests]
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <uthread.h>
+
+#define TEST_ASSERT(assert)				\
+do {									\
+	printf("ASSERT: " #assert " ... ");	\
+	if (assert) {						\
+		printf("PASS\n");				\
+	} else	{							\
+		printf("FAIL\n");				\
+		exit(1);						\
+	}									\
+} while(0)
+
+#define LATENCY_THREADS 4
+#define MAX_BATCH 16
+
+static int requests;
+static long *samples;
+static int sampleCount;
+static int batchDone;
+static volatile uint64_t sink;
+
+static long now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+/* Runs on a helper thread: wait for the request, return when it arrived */
+static long arrival(void *arg)
+{
+	(void)arg;
+	usleep(500);
+	return now_ns();
+}
+
+int latency(void)
+{
+	for (int i = 0; i < requests; i++) {
+		long arrived = uthread_blocking_call(arrival, NULL);
+		samples[sampleCount++] = now_ns() - arrived;
+	}
+	return 0;
+}
+
+int batch(void)
+{
+	while (!batchDone) {
+		// About a hundred microseconds of work per turn.
+		for (int i = 0; i < 100000; i++) {
+			sink += i;
+		}
+		uthread_yield();
+	}
+	return 0;
+}
+
+static int compare(const void *a, const void *b)
+{
+	long x = *(const long*)a, y = *(const long*)b;
+	return (x > y) - (x < y);
+}
+
+/*
+ * run - Measure wake-up delays with @batchThreads batch threads
+ *
+ * Return: 99th percentile of the delay, in nanoseconds.
+ */
+static long run(const char *name, int policy, int batchPrio, int batchThreads)
+{
+	uthread_t latencyTids[LATENCY_THREADS];
+	uthread_t batchTids[MAX_BATCH];
+
+	uthread_start_sched(0, policy);
+
+	sampleCount = 0;
+	batchDone = 0;
+
+	for (int i = 0; i < batchThreads; i++) {
+		batchTids[i] = uthread_create(batch);
+		uthread_set_priority(batchTids[i], batchPrio);
+	}
+	for (int i = 0; i < LATENCY_THREADS; i++) {
+		latencyTids[i] = uthread_create(latency);
+	}
+
+	uthread_join_all(latencyTids, LATENCY_THREADS, NULL);
+	batchDone = 1;
+	uthread_join_all(batchTids, batchThreads, NULL);
+
+	uthread_stop();
+
+	qsort(samples, sampleCount, sizeof(long), compare);
+	long p50 = samples[sampleCount / 2];
+	long p99 = samples[sampleCount * 99 / 100];
+
+	printf("%-12s %2d batch: p50 %8.1f us, p99 %8.1f us\n",
+			name, batchThreads, p50 / 1e3, p99 / 1e3);
+
+	return p99;
+}
+
+int main(int argc, char **argv)
+{
+	int loads[] = { 0, 4, MAX_BATCH };
+	long fifo = 0, lowest = 0;
+
+	requests = argc > 1 ? atoi(argv[1]) : 200;
+	samples = malloc(LATENCY_THREADS * requests * sizeof(long));
+
+	for (int i = 0; i < 3; i++) {
+		fprintf(stderr, "*** BENCH %d batch threads ***\n", loads[i]);
+
+		fifo = run("fifo", UTHREAD_SCHED_FIFO, UTHREAD_PRIO_HIGHEST,
+				loads[i]);
+		run("mlfq", UTHREAD_SCHED_MLFQ, UTHREAD_PRIO_HIGHEST, loads[i]);
+		lowest = run("mlfq/lowest", UTHREAD_SCHED_MLFQ,
+				UTHREAD_PRIO_LOWEST, loads[i]);
+	}
+
+	// Latency threads no longer wait behind the batch threads.
+	TEST_ASSERT(lowest < fifo / 4);
+
+	fprintf(stderr, "*** TEST set_priority ***\n");
+
+	uthread_start_sched(0, UTHREAD_SCHED_MLFQ);
+	TEST_ASSERT(uthread_set_priority(0, UTHREAD_PRIO_LOWEST + 1) == -1);
+	TEST_ASSERT(uthread_set_priority(1, UTHREAD_PRIO_LOWEST) == -1);
+	TEST_ASSERT(uthread_set_priority(0, UTHREAD_PRIO_LOWEST) == 0);
+	uthread_stop();
+
+	free(samples);
+
+	return 0;
+}
@@ -0,0 +1,108 @@
+/*
+ * Per-thread performance counters test
+ *
+ * Two threads run the same loop, one three times as many iterations as the
+ * other, interleaved by yields. The counts charged to each thread must follow
+ * that ratio, whether they come from hardware counters or only from the
+ * scheduler clock.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <uthread.h>
+
+#define TEST_ASSERT(assert)				\
+do {									\
+	printf("ASSERT: " #assert " ... ");	\
+	if (assert) {						\
+		printf("PASS\n");				\
+	} else	{							\
+		printf("FAIL\n");				\
+		exit(1);						\
+	}									\
+} while(0)
+
+#define ROUNDS 50
+#define ITERATIONS 200000
+
+static volatile unsigned long sink;
+static int finished;
+
+static void spin(int iterations)
+{
+	for (int i = 0; i < iterations; i++) {
+		sink += i;
+	}
+}
+
+int heavy(void)
+{
+	for (int i = 0; i < ROUNDS; i++) {
+		spin(3 * ITERATIONS);
+		uthread_yield();
+	}
+	finished++;
+	return 0;
+}
+
+int light(void)
+{
+	for (int i = 0; i < ROUNDS; i++) {
+		spin(ITERATIONS);
+		uthread_yield();
+	}
+	finished++;
+	return 0;
+}
+
+static void print(const char *name, struct uthread_perf_stats *stats)
+{
+	printf("%-6s: %12llu instructions, %12llu cycles, %9llu cache misses, "
+	       "%9llu branch misses\n", name, stats->instructions,
+	       stats->cycles, stats->cacheMisses, stats->branchMisses);
+}
+
+int main(void)
+{
+	struct uthread_perf_stats heavyStats, lightStats;
+
+	uthread_start(0);
+	TEST_ASSERT(uthread_perf_thread(0, &heavyStats) == -1);
+	uthread_stop();
+
+	uthread_perf_counters(1);
+	uthread_start(0);
+
+	uthread_t tids[2];
+	tids[0] = uthread_create(heavy);
+	tids[1] = uthread_create(light);
+
+	// Query the threads before they get collected.
+	while (finished < 2) {
+		uthread_yield();
+	}
+
+	TEST_ASSERT(uthread_perf_thread(tids[0], &heavyStats) == 0);
+	TEST_ASSERT(uthread_perf_thread(tids[1], &lightStats) == 0);
+	TEST_ASSERT(uthread_perf_thread(0, NULL) == -1);
+
+	printf("%s counters\n", heavyStats.hardware ? "hardware" :
+	       "no hardware, clock-only");
+	print("heavy", &heavyStats);
+	print("light", &lightStats);
+
+	TEST_ASSERT(heavyStats.cycles > 2 * lightStats.cycles);
+	TEST_ASSERT(heavyStats.cycles < 4 * lightStats.cycles);
+	if (heavyStats.hardware) {
+		TEST_ASSERT(heavyStats.instructions > 2 * lightStats.instructions);
+	} else {
+		TEST_ASSERT(heavyStats.instructions == 0);
+	}
+
+	uthread_join_all(tids, 2, NULL);
+	uthread_stop();
+	uthread_perf_counters(0);
+
+	return 0;
+}
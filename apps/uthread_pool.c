@@ -0,0 +1,169 @@
+/*
+ * Worker pool test
+ *
+ * Submits work items to a small pool with a bounded queue, collects their
+ * results through futures, and checks that submitters get blocked when the
+ * queue is full, and that a pool cannot be destroyed by its own items. Then times a burst of items run through the pool against the
+ * same burst run with one thread per item.
+ *
+ * Usage: uthread_pool [items]
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <uthread.h>
+
+#define TEST_ASSERT(assert)				\
+do {									\
+	printf("ASSERT: " #assert " ... ");	\
+	if (assert) {						\
+		printf("PASS\n");				\
+	} else	{							\
+		printf("FAIL\n");				\
+		exit(1);						\
+	}									\
+} while(0)
+
+static long counter;
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int square(void *arg)
+{
+	int x = (int)(intptr_t)arg;
+
+	// Give other workers and the submitter a chance to run.
+	uthread_yield();
+	return x * x;
+}
+
+int count_item(void *arg)
+{
+	counter += (intptr_t)arg;
+	return 0;
+}
+
+int destroy_own_pool(void *arg)
+{
+	return uthread_pool_destroy(arg);
+}
+
+int count_thread(void)
+{
+	counter += 1;
+	return 0;
+}
+
+void test_futures(void)
+{
+	uthread_future_t futures[100];
+	int ok = 1;
+
+	fprintf(stderr, "*** TEST futures ***\n");
+
+	uthread_pool_t pool = uthread_pool_create(4, 8);
+	TEST_ASSERT(pool != NULL);
+
+	// Far more items than the queue can hold: the submitter gets blocked.
+	for (int i = 0; i < 100; i++) {
+		uthread_pool_submit(pool, square, (void*)(intptr_t)i, &futures[i]);
+	}
+
+	for (int i = 0; i < 100; i++) {
+		int result = -1;
+		uthread_future_get(futures[i], &result);
+		ok &= (result == i * i);
+	}
+	TEST_ASSERT(ok);
+
+	TEST_ASSERT(uthread_pool_destroy(pool) == 0);
+}
+
+void test_drain_on_destroy(void)
+{
+	fprintf(stderr, "*** TEST drain_on_destroy ***\n");
+
+	counter = 0;
+	uthread_pool_t pool = uthread_pool_create(2, 64);
+	for (int i = 0; i < 50; i++) {
+		uthread_pool_submit(pool, count_item, (void*)1, NULL);
+	}
+
+	// Items still queued are executed before the workers exit.
+	uthread_pool_destroy(pool);
+	TEST_ASSERT(counter == 50);
+}
+
+void test_destroy_from_item(void)
+{
+	uthread_future_t future;
+	int result = 0;
+
+	fprintf(stderr, "*** TEST destroy_from_item ***\n");
+
+	uthread_pool_t pool = uthread_pool_create(2, 4);
+	uthread_pool_submit(pool, destroy_own_pool, pool, &future);
+	uthread_future_get(future, &result);
+	TEST_ASSERT(result == -1);
+
+	// The pool is still usable, and destroyed from outside.
+	counter = 0;
+	uthread_pool_submit(pool, count_item, (void*)1, NULL);
+	TEST_ASSERT(uthread_pool_destroy(pool) == 0);
+	TEST_ASSERT(counter == 1);
+}
+
+void bench(int items)
+{
+	uthread_t *tids = malloc(items * sizeof(uthread_t));
+
+	fprintf(stderr, "*** BENCH %d items ***\n", items);
+
+	counter = 0;
+	double start = now();
+	uthread_pool_t pool = uthread_pool_create(4, 1024);
+	for (int i = 0; i < items; i++) {
+		uthread_pool_submit(pool, count_item, (void*)1, NULL);
+	}
+	uthread_pool_destroy(pool);
+	double pooled = now() - start;
+	TEST_ASSERT(counter == items);
+
+	counter = 0;
+	start = now();
+	for (int i = 0; i < items; i++) {
+		tids[i] = uthread_create(count_thread);
+		uthread_join(tids[i], NULL);
+	}
+	double threads = now() - start;
+	TEST_ASSERT(counter == items);
+
+	printf("pool:              %8.1f ns/item\n", pooled * 1e9 / items);
+	printf("create+join:       %8.1f ns/item\n", threads * 1e9 / items);
+
+	free(tids);
+}
+
+int main(int argc, char **argv)
+{
+	int items = argc > 1 ? atoi(argv[1]) : 20000;
+
+	uthread_start(0);
+
+	test_futures();
+	test_drain_on_destroy();
+	test_destroy_from_item();
+	bench(items);
+
+	uthread_stop();
+
+	return 0;
+}
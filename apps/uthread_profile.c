@@ -0,0 +1,151 @@
+/*
+ * Sampling profiler test
+ *
+ * Two threads burn CPU in different functions, one three times longer than the
+ * other, while the profiler runs. The folded output must attribute samples to
+ * both threads in about that ratio, and name the hot functions. Stopping the
+ * profiler must put the SIGPROF disposition it replaced back.
+ *
+ * Build with -rdynamic so that the profiler can name the functions.
+ *
+ * Usage: uthread_profile [output]
+ *	The folded stacks are also written to output if given, e.g. for
+ *	flamegraph.pl output > profile.svg
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <uthread.h>
+
+#define TEST_ASSERT(assert)				\
+do {									\
+	printf("ASSERT: " #assert " ... ");	\
+	if (assert) {						\
+		printf("PASS\n");				\
+	} else	{							\
+		printf("FAIL\n");				\
+		exit(1);						\
+	}									\
+} while(0)
+
+#define ROUNDS 20
+
+static volatile unsigned long sink;
+
+static double cpu_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Spins for @seconds of CPU time */
+void __attribute__((noinline)) burn(double seconds)
+{
+	double end = cpu_now() + seconds;
+
+	while (cpu_now() < end) {
+		for (int i = 0; i < 1000; i++) {
+			sink += i;
+		}
+	}
+}
+
+/* Not tail calls, so that both functions show up in backtraces */
+void __attribute__((noinline)) hot_function(void)
+{
+	burn(0.030);
+	sink++;
+}
+
+void __attribute__((noinline)) cold_function(void)
+{
+	burn(0.010);
+	sink++;
+}
+
+int hot_thread(void)
+{
+	for (int i = 0; i < ROUNDS; i++) {
+		hot_function();
+		uthread_yield();
+	}
+	return 0;
+}
+
+int cold_thread(void)
+{
+	for (int i = 0; i < ROUNDS; i++) {
+		cold_function();
+		uthread_yield();
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	char line[4096];
+	long hot = 0, cold = 0;
+	int named = 0;
+	FILE *out = tmpfile();
+	FILE *copy = argc > 1 ? fopen(argv[1], "w") : NULL;
+
+	struct sigaction action;
+
+	TEST_ASSERT(uthread_profile_stop(out) == -1);
+	TEST_ASSERT(uthread_profile_start(0) == -1);
+
+	// An interval of a whole second, then the default disposition is back.
+	TEST_ASSERT(uthread_profile_start(1) == 0);
+	TEST_ASSERT(uthread_profile_stop(out) == 0);
+	sigaction(SIGPROF, NULL, &action);
+	TEST_ASSERT(action.sa_handler == SIG_DFL);
+
+	uthread_start(0);
+	TEST_ASSERT(uthread_profile_start(1000) == 0);
+	TEST_ASSERT(uthread_profile_start(1000) == -1);
+
+	uthread_t tids[2];
+	tids[0] = uthread_create(hot_thread);
+	tids[1] = uthread_create(cold_thread);
+	uthread_join_all(tids, 2, NULL);
+
+	TEST_ASSERT(uthread_profile_stop(out) == 0);
+	uthread_stop();
+
+	rewind(out);
+	while (fgets(line, sizeof(line), out) != NULL) {
+		char *count = strrchr(line, ' ');
+
+		if (count == NULL) {
+			continue;
+		}
+
+		if (strncmp(line, "uthread_1;", 10) == 0) {
+			hot += atol(count + 1);
+			named |= strstr(line, ";hot_function;") != NULL;
+		} else if (strncmp(line, "uthread_2;", 10) == 0) {
+			cold += atol(count + 1);
+		}
+
+		if (copy != NULL) {
+			fputs(line, copy);
+		}
+	}
+	fclose(out);
+
+	if (copy != NULL) {
+		fclose(copy);
+	}
+
+	printf("samples: %ld hot, %ld cold\n", hot, cold);
+	TEST_ASSERT(cold > 0);
+	TEST_ASSERT(hot > 2 * cold);
+	TEST_ASSERT(named);
+
+	return 0;
+}
@@ -0,0 +1,162 @@
+/*
+ * Remote wakeup and submission test
+ *
+ * A helper pthread hands work to the scheduler with uthread_submit_remote(),
+ * more tasks than there are TIDs, and wakes the main thread up with
+ * uthread_wake_remote(), both while the scheduler is busy and while it sleeps. Then a signal handler does the same.
+ * Finally, measures the round trip of a wakeup between a pthread and a parked
+ * thread.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <uthread.h>
+
+#define TEST_ASSERT(assert)				\
+do {									\
+	printf("ASSERT: " #assert " ... ");	\
+	if (assert) {						\
+		printf("PASS\n");				\
+	} else	{							\
+		printf("FAIL\n");				\
+		exit(1);						\
+	}									\
+} while(0)
+
+/* More than USHRT_MAX, which all run since finished tasks give their TID back */
+#define TASKS 100000
+#define ROUND_TRIPS 20000
+
+static volatile int tasksRun;
+static volatile int handlerDone;
+
+/* Round trip between the main thread and the pinger pthread */
+static volatile int pingTurn;
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int count_task(void *arg)
+{
+	(void)arg;
+
+	// Last task: the main thread may be parked waiting for it.
+	if (++tasksRun == TASKS) {
+		uthread_unpark(0);
+	}
+	return 0;
+}
+
+int wake_main(void *arg)
+{
+	(void)arg;
+
+	uthread_unpark(0);
+	return 0;
+}
+
+/* Posts TASKS tasks, retrying while the inbox is full */
+static void *submitter(void *arg)
+{
+	(void)arg;
+
+	for (int i = 0; i < TASKS; i++) {
+		while (uthread_submit_remote(count_task, NULL) == -1) {
+			sched_yield();
+		}
+	}
+	return NULL;
+}
+
+/* Lets the main thread park, then wakes it up */
+static void *waker(void *arg)
+{
+	(void)arg;
+
+	usleep(20000);
+	uthread_wake_remote(0);
+	return NULL;
+}
+
+static void handler(int sig)
+{
+	(void)sig;
+
+	handlerDone = uthread_submit_remote(wake_main, NULL) == 0;
+}
+
+static void *pinger(void *arg)
+{
+	(void)arg;
+
+	for (int i = 0; i < ROUND_TRIPS; i++) {
+		while (pingTurn == i) {
+			// Wait for the main thread to answer.
+			sched_yield();
+		}
+		uthread_wake_remote(0);
+	}
+	return NULL;
+}
+
+int main(void)
+{
+	pthread_t thread;
+
+	TEST_ASSERT(uthread_wake_remote(0) == -1);
+	TEST_ASSERT(uthread_start(0) == 0);
+	TEST_ASSERT(uthread_submit_remote(NULL, NULL) == -1);
+
+	fprintf(stderr, "*** TEST submit from a pthread ***\n");
+
+	pthread_create(&thread, NULL, submitter, NULL);
+	while (tasksRun < TASKS) {
+		uthread_park();
+	}
+	pthread_join(thread, NULL);
+	TEST_ASSERT(tasksRun == TASKS);
+
+	fprintf(stderr, "*** TEST wake a sleeping scheduler ***\n");
+
+	pthread_create(&thread, NULL, waker, NULL);
+	double start = now();
+	TEST_ASSERT(uthread_park() == 0);
+	TEST_ASSERT(now() - start >= 0.015);
+	pthread_join(thread, NULL);
+
+	fprintf(stderr, "*** TEST submit from a signal handler ***\n");
+
+	signal(SIGALRM, handler);
+	alarm(1);
+	TEST_ASSERT(uthread_park() == 0);
+	TEST_ASSERT(handlerDone);
+
+	fprintf(stderr, "*** BENCH pthread round trip ***\n");
+
+	pingTurn = 0;
+	pthread_create(&thread, NULL, pinger, NULL);
+	start = now();
+	for (int i = 0; i < ROUND_TRIPS; i++) {
+		pingTurn = i + 1;
+		uthread_park();
+	}
+	double elapsed = now() - start;
+	pthread_join(thread, NULL);
+
+	printf("%.1f ns/round trip\n", elapsed * 1e9 / ROUND_TRIPS);
+
+	TEST_ASSERT(uthread_stop() == 0);
+	TEST_ASSERT(uthread_wake_remote(0) == -1);
+
+	return 0;
+}
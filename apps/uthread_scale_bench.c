@@ -0,0 +1,436 @@
+/*
+ * Scalability benchmark
+ *
+ * Runs the same workload with N uthreads, N pthreads and N raw swapcontext()
+ * contexts, for N = 1K, 10K and 60K by default:
+ * - create N threads, timed (creation rate),
+ * - let each run once, then read the RSS growth since before creation
+ *   (memory per thread),
+ * - pass control around the ring of threads for a few rounds (switch rate):
+ *   uthread_yield() for uthreads, a swapcontext() to the next context for raw
+ *   contexts, and a semaphore handed from each pthread to the next,
+ * - join all threads and release them, timed (teardown).
+ *
+ * Raw contexts get stacks of the same size as uthreads (32 KiB), pthreads get
+ * 64 KiB stacks rather than the default 8 MiB so that large runs fit in the
+ * address space. pthreads may also hit a process or system limit (ulimit -u,
+ * kernel.threads-max, kernel.pid_max), in which case the run is reported as
+ * failed along with the number of threads created.
+ *
+ * Finally checks the TID ceiling: uthread_create() succeeds USHRT_MAX times
+ * and then fails, until these threads exited and gave their TIDs back.
+ *
+ * Usage: uthread_scale_bench [threads...]
+ *	At most 65535 threads, the number of TIDs of a scheduler
+ *
+ * Build with -O2 -pthread.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include <uthread.h>
+
+#define TEST_ASSERT(assert)				\
+do {									\
+	printf("ASSERT: " #assert " ... ");	\
+	if (assert) {						\
+		printf("PASS\n");				\
+	} else	{							\
+		printf("FAIL\n");				\
+		exit(1);						\
+	}									\
+} while(0)
+
+/* Same as UTHREAD_STACK_SIZE, private to the library */
+#define RAW_STACK_SIZE 32768
+#define PTHREAD_STACK_SIZE 65536
+
+/* Switches aimed at per run, spread over the ring */
+#define SWITCHES 200000
+
+struct result {
+	const char *name;
+	int created;
+	int error;
+	double create;
+	double rssPerThread;
+	double switchRate;
+	double teardown;
+};
+
+/* Parameters and measurements of the current run */
+static int numThreads;
+static int rounds;
+static int started;
+static int finished;
+static long rssBefore;
+static long rssAfter;
+static double ringStart;
+static double ringEnd;
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * rss - Resident set size of the process, in bytes
+ */
+static long rss(void)
+{
+	long pages = 0;
+	FILE *statm = fopen("/proc/self/statm", "r");
+
+	if (statm != NULL) {
+		if (fscanf(statm, "%*d %ld", &pages) != 1) {
+			pages = 0;
+		}
+		fclose(statm);
+	}
+
+	return pages * sysconf(_SC_PAGESIZE);
+}
+
+/*
+ * lap - Called by thread @index at the start of each round
+ *
+ * The last thread starting its first round means that every thread has run
+ * once: memory is measured there, and the ring is timed from there.
+ */
+static void lap(int index, int round)
+{
+	if (index == numThreads - 1 && round == 0) {
+		rssAfter = rss();
+		ringStart = now();
+	}
+}
+
+static void reset(int threads)
+{
+	numThreads = threads;
+	rounds = SWITCHES / threads > 2 ? SWITCHES / threads : 2;
+	started = 0;
+	finished = 0;
+
+	// Return memory freed by the previous run, so that it is not reused.
+	malloc_trim(0);
+	rssBefore = rss();
+}
+
+static void finish(struct result *result, double create, double teardown)
+{
+	// The first round is not timed, it includes each thread's first run.
+	double switches = (double)numThreads * (rounds - 1);
+
+	result->create = numThreads / create;
+	result->rssPerThread = (double)(rssAfter - rssBefore) / numThreads;
+	result->switchRate = switches / (ringEnd - ringStart);
+	result->teardown = teardown;
+}
+
+/**
+ * uthreads
+ */
+
+static int uthreadRing(void)
+{
+	int index = started++;
+
+	for (int round = 0; round < rounds; round++) {
+		lap(index, round);
+		uthread_yield();
+	}
+
+	finished++;
+	return 0;
+}
+
+static void runUthreads(int threads, struct result *result)
+{
+	uthread_t *tids = malloc(threads * sizeof(uthread_t));
+
+	reset(threads);
+	uthread_start(0);
+
+	double start = now();
+	for (int i = 0; i < threads; i++) {
+		int tid = uthread_create(uthreadRing);
+
+		if (tid == -1) {
+			fprintf(stderr, "uthread_create failed\n");
+			exit(1);
+		}
+		tids[i] = tid;
+	}
+	double create = now() - start;
+
+	// The main thread takes part in the ring until the others are done.
+	while (finished < threads) {
+		uthread_yield();
+	}
+	ringEnd = now();
+
+	start = now();
+	for (int i = 0; i < threads; i++) {
+		uthread_join(tids[i], NULL);
+	}
+	uthread_stop();
+	double teardown = now() - start;
+
+	finish(result, create, teardown);
+	result->created = threads;
+	free(tids);
+}
+
+/**
+ * Raw contexts
+ */
+
+static ucontext_t mainContext;
+static ucontext_t *contexts;
+
+static void rawRing(int index)
+{
+	started++;
+
+	for (int round = 0; round < rounds; round++) {
+		lap(index, round);
+		swapcontext(&contexts[index],
+			    &contexts[(index + 1) % numThreads]);
+	}
+
+	// Let the next context leave its loop too, the last goes back to main.
+	finished++;
+	setcontext(index == numThreads - 1 ? &mainContext :
+		   &contexts[index + 1]);
+}
+
+static void runRaw(int threads, struct result *result)
+{
+	reset(threads);
+	contexts = malloc(threads * sizeof(ucontext_t));
+
+	double start = now();
+	for (int i = 0; i < threads; i++) {
+		void *stack = malloc(RAW_STACK_SIZE);
+
+		if (stack == NULL || getcontext(&contexts[i]) == -1) {
+			fprintf(stderr, "raw context creation failed\n");
+			exit(1);
+		}
+
+		contexts[i].uc_stack.ss_sp = stack;
+		contexts[i].uc_stack.ss_size = RAW_STACK_SIZE;
+		contexts[i].uc_link = NULL;
+		makecontext(&contexts[i], (void (*)(void))rawRing, 1, i);
+	}
+	double create = now() - start;
+
+	swapcontext(&mainContext, &contexts[0]);
+	ringEnd = now();
+
+	start = now();
+	for (int i = 0; i < threads; i++) {
+		free(contexts[i].uc_stack.ss_sp);
+	}
+	free(contexts);
+	double teardown = now() - start;
+
+	finish(result, create, teardown);
+	result->created = threads;
+}
+
+/**
+ * pthreads
+ */
+
+/* One semaphore per thread, on its own cache line */
+struct turn {
+	sem_t sem;
+	char pad[64 - sizeof(sem_t) % 64];
+};
+
+static struct turn *turns;
+static sem_t done;
+static volatile int aborted;
+
+static void *pthreadRing(void *arg)
+{
+	int index = (int)(long)arg;
+
+	for (int round = 0; round < rounds; round++) {
+		sem_wait(&turns[index].sem);
+
+		if (aborted) {
+			return NULL;
+		}
+
+		lap(index, round);
+		sem_post(&turns[(index + 1) % numThreads].sem);
+	}
+
+	if (index == numThreads - 1) {
+		sem_post(&done);
+	}
+
+	return NULL;
+}
+
+static void runPthreads(int threads, struct result *result)
+{
+	pthread_t *pthreads = malloc(threads * sizeof(pthread_t));
+	pthread_attr_t attr;
+	int created = 0, error = 0;
+
+	reset(threads);
+	turns = malloc(threads * sizeof(struct turn));
+	for (int i = 0; i < threads; i++) {
+		sem_init(&turns[i].sem, 0, 0);
+	}
+	sem_init(&done, 0, 0);
+	aborted = 0;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr, PTHREAD_STACK_SIZE);
+
+	double start = now();
+	for (; created < threads; created++) {
+		error = pthread_create(&pthreads[created], &attr, pthreadRing,
+				       (void *)(long)created);
+		if (error != 0) {
+			break;
+		}
+	}
+	double create = now() - start;
+
+	if (created < threads) {
+		// Let the threads out, there is no ring to run.
+		aborted = 1;
+		for (int i = 0; i < created; i++) {
+			sem_post(&turns[i].sem);
+		}
+	} else {
+		sem_post(&turns[0].sem);
+		sem_wait(&done);
+		ringEnd = now();
+	}
+
+	start = now();
+	for (int i = 0; i < created; i++) {
+		pthread_join(pthreads[i], NULL);
+	}
+	double teardown = now() - start;
+
+	pthread_attr_destroy(&attr);
+	for (int i = 0; i < threads; i++) {
+		sem_destroy(&turns[i].sem);
+	}
+	sem_destroy(&done);
+	free(turns);
+	free(pthreads);
+
+	result->created = created;
+	result->error = error;
+	if (created == threads) {
+		finish(result, create, teardown);
+	}
+}
+
+static void printResult(int threads, const struct result *result)
+{
+	if (result->created < threads) {
+		printf("%7d  %-12s failed after %d threads: %s\n", threads,
+		       result->name, result->created, strerror(result->error));
+		return;
+	}
+
+	printf("%7d  %-12s %12.0f %10.0f B %12.0f %11.2f ms\n", threads,
+	       result->name, result->create, result->rssPerThread,
+	       result->switchRate, result->teardown * 1e3);
+}
+
+/**
+ * TID ceiling
+ */
+
+static int noop(void)
+{
+	return 0;
+}
+
+static void testCeiling(void)
+{
+	int created = 0;
+
+	fprintf(stderr, "*** TEST TID ceiling ***\n");
+
+	uthread_start(0);
+
+	// Detached, so that they are freed as soon as they ran.
+	for (;;) {
+		int tid = uthread_create(noop);
+
+		if (tid == -1) {
+			break;
+		}
+		uthread_detach(tid);
+		created++;
+	}
+
+	TEST_ASSERT(created == USHRT_MAX);
+	TEST_ASSERT(uthread_create(noop) == -1);
+
+	// All of them were queued before the main thread, and run to the end.
+	uthread_yield();
+	int tid = uthread_create(noop);
+	TEST_ASSERT(tid > 0 && uthread_join(tid, NULL) == 0);
+	TEST_ASSERT(uthread_stop() == 0);
+}
+
+int main(int argc, char **argv)
+{
+	int defaults[] = { 1000, 10000, 60000 };
+	int count = argc > 1 ? argc - 1 : 3;
+
+	printf("%7s  %-12s %12s %12s %12s %14s\n", "threads", "impl",
+	       "creates/s", "RSS/thread", "switches/s", "teardown");
+
+	for (int i = 0; i < count; i++) {
+		int threads = argc > 1 ? atoi(argv[i + 1]) : defaults[i];
+		struct result results[3] = {
+			{ .name = "uthread" },
+			{ .name = "swapcontext" },
+			{ .name = "pthread" },
+		};
+
+		if (threads < 1 || threads > USHRT_MAX) {
+			fprintf(stderr, "threads must be between 1 and %d\n",
+				USHRT_MAX);
+			return 1;
+		}
+
+		runUthreads(threads, &results[0]);
+		runRaw(threads, &results[1]);
+		runPthreads(threads, &results[2]);
+
+		for (int j = 0; j < 3; j++) {
+			printResult(threads, &results[j]);
+		}
+	}
+
+	testCeiling();
+
+	return 0;
+}
@@ -0,0 +1,154 @@
+/*
+ * Scheduling policy benchmark
+ *
+ * Runs greedy threads, which do ten units of work between yields, against
+ * polite threads, which do a single unit between yields, for a fixed amount of
+ * time. Under FIFO every thread gets one turn per round, so greedy threads get
+ * most of the CPU; under the fair policy each group should get about half of
+ * it. Then measures the cost of a switch in a ring of yielding threads under
+ * both policies, and checks that weights shift the shares accordingly.
+ *
+ * Usage: uthread_sched_bench [milliseconds]
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <uthread.h>
+
+#define TEST_ASSERT(assert)				\
+do {									\
+	printf("ASSERT: " #assert " ... ");	\
+	if (assert) {						\
+		printf("PASS\n");				\
+	} else	{							\
+		printf("FAIL\n");				\
+		exit(1);						\
+	}									\
+} while(0)
+
+#define GROUP 4
+#define RING 64
+#define RING_YIELDS 20000
+
+static double deadline;
+static volatile uint64_t sink;
+static uint64_t greedyUnits, politeUnits;
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void work_unit(void)
+{
+	for (int i = 0; i < 2000; i++) {
+		sink += i;
+	}
+}
+
+int greedy(void)
+{
+	while (now() < deadline) {
+		for (int i = 0; i < 10; i++) {
+			work_unit();
+		}
+		greedyUnits += 10;
+		uthread_yield();
+	}
+	return 0;
+}
+
+int polite(void)
+{
+	while (now() < deadline) {
+		work_unit();
+		politeUnits += 1;
+		uthread_yield();
+	}
+	return 0;
+}
+
+int ringer(void)
+{
+	for (int i = 0; i < RING_YIELDS; i++) {
+		uthread_yield();
+	}
+	return 0;
+}
+
+/*
+ * share - Run both groups for @ms milliseconds
+ *
+ * Return: Fraction of the work done by the greedy group.
+ */
+static double share(int ms, int greedyWeight)
+{
+	uthread_t tids[2 * GROUP];
+
+	greedyUnits = politeUnits = 0;
+	deadline = now() + ms / 1e3;
+
+	for (int i = 0; i < GROUP; i++) {
+		tids[2 * i] = uthread_create(greedy);
+		uthread_set_weight(tids[2 * i], greedyWeight);
+		tids[2 * i + 1] = uthread_create(polite);
+	}
+	uthread_join_all(tids, 2 * GROUP, NULL);
+
+	return (double)greedyUnits / (greedyUnits + politeUnits);
+}
+
+static double ring(void)
+{
+	uthread_t tids[RING];
+
+	double start = now();
+	for (int i = 0; i < RING; i++) {
+		tids[i] = uthread_create(ringer);
+	}
+	uthread_join_all(tids, RING, NULL);
+
+	return (now() - start) * 1e9 / ((double)RING * RING_YIELDS);
+}
+
+int main(int argc, char **argv)
+{
+	int ms = argc > 1 ? atoi(argv[1]) : 300;
+	const char *names[] = { "fifo", "fair" };
+	int policies[] = { UTHREAD_SCHED_FIFO, UTHREAD_SCHED_FAIR };
+	double greedyShare[2];
+
+	TEST_ASSERT(uthread_start_sched(0, 42) == -1);
+
+	for (int p = 0; p < 2; p++) {
+		fprintf(stderr, "*** BENCH %s ***\n", names[p]);
+
+		uthread_start_sched(0, policies[p]);
+		greedyShare[p] = share(ms, 1024);
+		double switchNs = ring();
+		uthread_stop();
+
+		printf("%s: greedy share %5.1f%%, %6.1f ns/switch\n",
+				names[p], greedyShare[p] * 100, switchNs);
+	}
+
+	TEST_ASSERT(greedyShare[0] > 0.75);
+	TEST_ASSERT(greedyShare[1] > 0.35 && greedyShare[1] < 0.65);
+
+	fprintf(stderr, "*** TEST weights ***\n");
+
+	// Greedy threads weighted 3:1 get about three quarters of the CPU.
+	uthread_start_sched(0, UTHREAD_SCHED_FAIR);
+	double weighted = share(ms, 3 * 1024);
+	uthread_stop();
+
+	printf("fair, 3:1 weights: greedy share %5.1f%%\n", weighted * 100);
+	TEST_ASSERT(weighted > 0.6 && weighted < 0.9);
+
+	return 0;
+}
@@ -0,0 +1,213 @@
+/*
+ * Thread-per-core benchmark
+ *
+ * Starts an increasing number of shards and gives each of them the same batch
+ * of yielding threads through uthread_shard_submit(), then measures the total
+ * number of context switches per second: with one CPU per shard and nothing
+ * shared, it should grow linearly with the number of shards. Then measures the
+ * round trip of a wakeup bouncing between two threads on two shards. Finally
+ * checks that more tasks than there are TIDs, submitted to another shard, all
+ * run.
+ *
+ * Usage: uthread_shard_bench [max_shards]
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <uthread.h>
+
+#define TEST_ASSERT(assert)				\
+do {									\
+	printf("ASSERT: " #assert " ... ");	\
+	if (assert) {						\
+		printf("PASS\n");				\
+	} else	{							\
+		printf("FAIL\n");				\
+		exit(1);						\
+	}									\
+} while(0)
+
+#define WORKERS 64
+#define YIELDS 5000
+#define ROUND_TRIPS 20000
+#define SUBMITS 100000
+
+/* Per-shard counters, padded so that shards do not share cache lines */
+static struct {
+	long yields;
+	char pad[56];
+} counts[64];
+
+/* Only touched from shard 0 */
+static int shardsDone;
+static int shardsExpected;
+
+/* Only touched from shard 1 */
+static long submitsRun;
+
+static volatile uthread_t pongTid;
+static volatile int pongReady;
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int worker(void)
+{
+	int shard = uthread_shard_self();
+
+	for (int i = 0; i < YIELDS; i++) {
+		counts[shard].yields++;
+		uthread_yield();
+	}
+	return 0;
+}
+
+/* Runs on shard 0 for every shard that is done */
+int report_done(void *arg)
+{
+	(void)arg;
+
+	if (++shardsDone == shardsExpected) {
+		uthread_unpark(0);
+	}
+	return 0;
+}
+
+/* Runs on each shard: fan out the local workers and wait for them */
+int generator(void *arg)
+{
+	uthread_t tids[WORKERS];
+
+	(void)arg;
+
+	for (int i = 0; i < WORKERS; i++) {
+		tids[i] = uthread_create(worker);
+	}
+	uthread_join_all(tids, WORKERS, NULL);
+
+	uthread_shard_submit(0, report_done, NULL);
+	return 0;
+}
+
+/* Runs on shard 1: answer every wakeup from the main thread of shard 0 */
+int pong(void *arg)
+{
+	(void)arg;
+
+	pongTid = uthread_self();
+	pongReady = 1;
+	uthread_shard_wake(0, 0);
+
+	for (int i = 0; i < ROUND_TRIPS; i++) {
+		uthread_park();
+		uthread_shard_wake(0, 0);
+	}
+	return 0;
+}
+
+int count_submit(void *arg)
+{
+	(void)arg;
+
+	submitsRun++;
+	return 0;
+}
+
+static double scaling(int shards)
+{
+	shardsDone = 0;
+	shardsExpected = shards;
+
+	double start = now();
+	for (int i = 0; i < shards; i++) {
+		uthread_shard_submit(i, generator, NULL);
+	}
+	while (shardsDone < shardsExpected) {
+		uthread_park();
+	}
+	double elapsed = now() - start;
+
+	long total = 0;
+	for (int i = 0; i < shards; i++) {
+		total += counts[i].yields;
+		counts[i].yields = 0;
+	}
+	TEST_ASSERT(total == (long)shards * WORKERS * YIELDS);
+
+	return total / elapsed;
+}
+
+static double round_trip(void)
+{
+	pongReady = 0;
+	uthread_shard_submit(1, pong, NULL);
+	while (!pongReady) {
+		uthread_park();
+	}
+
+	double start = now();
+	for (int i = 0; i < ROUND_TRIPS; i++) {
+		uthread_shard_wake(1, pongTid);
+		uthread_park();
+	}
+
+	return (now() - start) * 1e9 / ROUND_TRIPS;
+}
+
+int main(int argc, char **argv)
+{
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	int max = argc > 1 ? atoi(argv[1]) : (cpus < 8 ? cpus : 8);
+	double base = 0;
+
+	for (int shards = 1; shards <= max; shards *= 2) {
+		fprintf(stderr, "*** BENCH %d shards ***\n", shards);
+
+		TEST_ASSERT(uthread_start_sharded(shards) == 0);
+		double rate = scaling(shards);
+		if (shards == 1) {
+			base = rate;
+		}
+
+		printf("%2d shards: %8.2f M switches/s (x%.2f)\n",
+				shards, rate / 1e6, rate / base);
+
+		if (shards > 1) {
+			printf("%2d shards: %8.1f ns/round trip\n",
+					shards, round_trip());
+		}
+
+		TEST_ASSERT(uthread_stop_sharded() == 0);
+	}
+
+	fprintf(stderr, "*** TEST submissions ***\n");
+
+	long full = 0;
+
+	TEST_ASSERT(uthread_start_sharded(2) == 0);
+	for (int i = 0; i < SUBMITS; i++) {
+		// Mailbox full: shard 1 catches up meanwhile.
+		while (uthread_shard_submit(1, count_submit, NULL) == -1) {
+			full++;
+			uthread_yield();
+		}
+	}
+	TEST_ASSERT(uthread_stop_sharded() == 0);
+	TEST_ASSERT(submitsRun == SUBMITS);
+	printf("mailbox full %ld times\n", full);
+
+	fprintf(stderr, "*** TEST errors ***\n");
+
+	TEST_ASSERT(uthread_start_sharded(0) == -1);
+	TEST_ASSERT(uthread_shard_submit(0, generator, NULL) == -1);
+
+	return 0;
+}
@@ -0,0 +1,155 @@
+/*
+ * Stack arena benchmark
+ *
+ * Creates a large number of threads which then yield to each other in
+ * round-robin, so that every switch lands on a different stack. Reports the
+ * time per switch and the dTLB load misses per switch, with stacks allocated
+ * by malloc() and with stacks carved out of the huge-page arena.
+ *
+ * The number of threads is capped by the TID space (65535 per scheduler).
+ *
+ * Usage: uthread_stack_bench [threads...]
+ */
+
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <uthread.h>
+
+#define TEST_ASSERT(assert)				\
+do {									\
+	printf("ASSERT: " #assert " ... ");	\
+	if (assert) {						\
+		printf("PASS\n");				\
+	} else	{							\
+		printf("FAIL\n");				\
+		exit(1);						\
+	}									\
+} while(0)
+
+#define ROUNDS 20
+
+static long finished;
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * open_dtlb_counter - Count dTLB load misses of the calling process
+ *
+ * Return: File descriptor of the counter, -1 if unavailable (e.g., no PMU in
+ * a virtual machine, or restricted by perf_event_paranoid).
+ */
+static int open_dtlb_counter(void)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HW_CACHE;
+	attr.config = PERF_COUNT_HW_CACHE_DTLB |
+		      (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+		      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+int spinner(void)
+{
+	// Touch the stack a little, as real threads would.
+	volatile char scratch[256];
+
+	for (int i = 0; i < ROUNDS; i++) {
+		scratch[i] = i;
+		uthread_yield();
+	}
+
+	finished++;
+	return scratch[0];
+}
+
+static void run(int threads, int arena, int counter)
+{
+	uthread_t *tids = malloc(threads * sizeof(uthread_t));
+	long long misses = -1;
+
+	uthread_stack_arena(arena);
+	uthread_start(0);
+
+	finished = 0;
+	for (int i = 0; i < threads; i++) {
+		tids[i] = uthread_create(spinner);
+	}
+
+	// First round materializes every stack, leave it out of the timing.
+	uthread_yield();
+
+	if (counter != -1) {
+		ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+		ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+	}
+
+	double start = now();
+	for (int i = 1; i < ROUNDS; i++) {
+		uthread_yield();
+	}
+	double elapsed = now() - start;
+
+	if (counter != -1) {
+		ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+		if (read(counter, &misses, sizeof(misses)) != sizeof(misses)) {
+			misses = -1;
+		}
+	}
+
+	uthread_join_all(tids, threads, NULL);
+	TEST_ASSERT(finished == threads);
+	uthread_stop();
+
+	double switches = (double)threads * (ROUNDS - 1);
+
+	printf("%6d threads, %-6s: %7.1f ns/switch", threads,
+			arena ? "arena" : "malloc", elapsed * 1e9 / switches);
+	if (misses >= 0) {
+		printf(", %6.2f dTLB misses/switch\n", misses / switches);
+	} else {
+		printf(", dTLB misses n/a\n");
+	}
+
+	free(tids);
+}
+
+int main(int argc, char **argv)
+{
+	int defaults[] = { 10000, 30000, 60000 };
+	int count = argc > 1 ? argc - 1 : 3;
+	int counter = open_dtlb_counter();
+
+	for (int i = 0; i < count; i++) {
+		int threads = argc > 1 ? atoi(argv[i + 1]) : defaults[i];
+
+		fprintf(stderr, "*** BENCH %d threads ***\n", threads);
+		run(threads, 0, counter);
+		run(threads, 1, counter);
+	}
+
+	if (counter != -1) {
+		close(counter);
+	}
+
+	return 0;
+}
@@ -0,0 +1,180 @@
+/*
+ * Run-to-completion task test
+ *
+ * Checks that tasks run in order and can be joined, and that a task which
+ * yields halfway through turns into a regular thread without disturbing the
+ * tasks around it, and that detached tasks give their TID back so that more
+ * than USHRT_MAX of them can run. Then times a burst of short work items run as
+ * tasks against the same burst run as full threads.
+ *
+ * Usage: uthread_tasks [items]
+ */
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <uthread.h>
+
+#define TEST_ASSERT(assert)				\
+do {									\
+	printf("ASSERT: " #assert " ... ");	\
+	if (assert) {						\
+		printf("PASS\n");				\
+	} else	{							\
+		printf("FAIL\n");				\
+		exit(1);						\
+	}									\
+} while(0)
+
+static long counter;
+static int order[4];
+static int orderLen;
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int record(void *arg)
+{
+	order[orderLen++] = (int)(intptr_t)arg;
+	return (int)(intptr_t)arg * 10;
+}
+
+int yielding(void *arg)
+{
+	order[orderLen++] = (int)(intptr_t)arg;
+	uthread_yield();
+	order[orderLen++] = -(int)(intptr_t)arg;
+	return 7;
+}
+
+int work_task(void *arg)
+{
+	counter += (intptr_t)arg;
+	return 0;
+}
+
+int work_thread(void)
+{
+	counter += 1;
+	return 0;
+}
+
+void test_order(void)
+{
+	uthread_t tids[3];
+	int retvals[3];
+
+	fprintf(stderr, "*** TEST order ***\n");
+
+	for (int i = 0; i < 3; i++) {
+		tids[i] = uthread_spawn_task(record, (void*)(intptr_t)(i + 1));
+	}
+
+	TEST_ASSERT(uthread_join_all(tids, 3, retvals) == 0);
+	TEST_ASSERT(orderLen == 3);
+	TEST_ASSERT(order[0] == 1 && order[1] == 2 && order[2] == 3);
+	TEST_ASSERT(retvals[0] == 10 && retvals[2] == 30);
+}
+
+void test_yielding_task(void)
+{
+	uthread_t tids[2];
+	int retvals[2];
+
+	fprintf(stderr, "*** TEST yielding_task ***\n");
+
+	orderLen = 0;
+	tids[0] = uthread_spawn_task(yielding, (void*)1);
+	tids[1] = uthread_spawn_task(record, (void*)2);
+
+	TEST_ASSERT(uthread_join_all(tids, 2, retvals) == 0);
+
+	// Task 2 ran while task 1 was yielding, then task 1 resumed.
+	TEST_ASSERT(orderLen == 3);
+	TEST_ASSERT(order[0] == 1 && order[1] == 2 && order[2] == -1);
+	TEST_ASSERT(retvals[0] == 7 && retvals[1] == 20);
+}
+
+void test_recycled_tids(void)
+{
+	long total = 3L * USHRT_MAX;
+	int failed = 0;
+
+	fprintf(stderr, "*** TEST recycled_tids ***\n");
+
+	counter = 0;
+	for (long i = 0; i < total; i++) {
+		int tid = uthread_spawn_task(work_task, (void*)1);
+
+		if (tid == -1 || uthread_detach(tid) == -1) {
+			failed++;
+		}
+
+		// Let the batch run, which frees its TIDs.
+		if (i % 1000 == 999) {
+			uthread_yield();
+		}
+	}
+	uthread_yield();
+	TEST_ASSERT(failed == 0);
+	TEST_ASSERT(counter == total);
+
+	// Joined threads give their TID back too.
+	orderLen = 0;
+	int tid = uthread_spawn_task(record, (void*)4);
+	int retval;
+	TEST_ASSERT(tid > 0 && uthread_join(tid, &retval) == 0 && retval == 40);
+}
+
+void bench(int items)
+{
+	uthread_t *tids = malloc(items * sizeof(uthread_t));
+
+	fprintf(stderr, "*** BENCH %d items ***\n", items);
+
+	counter = 0;
+	double start = now();
+	for (int i = 0; i < items; i++) {
+		tids[i] = uthread_spawn_task(work_task, (void*)1);
+	}
+	uthread_join_all(tids, items, NULL);
+	double tasks = now() - start;
+	TEST_ASSERT(counter == items);
+
+	counter = 0;
+	start = now();
+	for (int i = 0; i < items; i++) {
+		tids[i] = uthread_create(work_thread);
+	}
+	uthread_join_all(tids, items, NULL);
+	double threads = now() - start;
+	TEST_ASSERT(counter == items);
+
+	printf("tasks:   %8.1f ns/item\n", tasks * 1e9 / items);
+	printf("threads: %8.1f ns/item\n", threads * 1e9 / items);
+
+	free(tids);
+}
+
+int main(int argc, char **argv)
+{
+	int items = argc > 1 ? atoi(argv[1]) : 20000;
+
+	uthread_start(0);
+
+	test_order();
+	test_yielding_task();
+	test_recycled_tids();
+	bench(items);
+
+	uthread_stop();
+
+	return 0;
+}
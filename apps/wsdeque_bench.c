@@ -0,0 +1,108 @@
+/*
+ * Work-stealing deque throughput benchmark
+ *
+ * The owner pushes a fixed number of items and pops them back in LIFO order,
+ * while a varying number of thief pthreads steal from the other end. For every
+ * thief count, the program reports how many items per second were consumed in
+ * total and which share was stolen.
+ *
+ * Usage: wsdeque_bench [max_thieves] [items]
+ *
+ * Build with -O2 -pthread.
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "wsdeque.h"
+
+static wsdeque_t deque;
+static atomic_int running;
+static atomic_long stolen;
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *thief(void *arg)
+{
+	long mine = 0;
+	void *item;
+	(void)arg;
+
+	while (atomic_load_explicit(&running, memory_order_relaxed)) {
+		if (wsdeque_steal(deque, &item) == 0) {
+			mine++;
+		}
+	}
+
+	atomic_fetch_add(&stolen, mine);
+	return NULL;
+}
+
+static void run(int nthieves, long items)
+{
+	pthread_t threads[nthieves > 0 ? nthieves : 1];
+	void *item;
+	long popped = 0;
+
+	deque = wsdeque_create();
+	atomic_store(&running, 1);
+	atomic_store(&stolen, 0);
+
+	for (int i = 0; i < nthieves; i++) {
+		pthread_create(&threads[i], NULL, thief, NULL);
+	}
+
+	double start = now();
+
+	// Push in bursts of 64 then drain half of each burst, like a task spawner.
+	for (long i = 1; i <= items; i++) {
+		wsdeque_push(deque, (void*)(intptr_t)i);
+		if (i % 64 == 0) {
+			for (int j = 0; j < 32; j++) {
+				if (wsdeque_pop(deque, &item) == 0) {
+					popped++;
+				}
+			}
+		}
+	}
+
+	while (wsdeque_pop(deque, &item) == 0) {
+		popped++;
+	}
+
+	double elapsed = now() - start;
+
+	atomic_store(&running, 0);
+	for (int i = 0; i < nthieves; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	long total = popped + atomic_load(&stolen);
+	printf("%7d  %14.0f  %8.1f%%  %s\n", nthieves, total / elapsed,
+	       100.0 * atomic_load(&stolen) / total,
+	       total == items ? "ok" : "LOST ITEMS");
+
+	wsdeque_destroy(deque);
+}
+
+int main(int argc, char **argv)
+{
+	int maxThieves = argc > 1 ? atoi(argv[1]) : 4;
+	long items = argc > 2 ? atol(argv[2]) : 10000000;
+
+	printf("thieves  items/sec       stolen    check\n");
+	for (int t = 0; t <= maxThieves; t++) {
+		run(t, items);
+	}
+
+	return 0;
+}
@@ -0,0 +1,186 @@
+/*
+ * Work-stealing deque tester
+ *
+ * Checks the owner LIFO / thief FIFO semantics of the deque in isolation, then
+ * stresses it with one owner pushing and popping while several thief pthreads
+ * steal concurrently. Every item must be taken exactly once.
+ *
+ * Build with -pthread.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "wsdeque.h"
+
+#define TEST_ASSERT(assert)				\
+do {									\
+	printf("ASSERT: " #assert " ... ");	\
+	if (assert) {						\
+		printf("PASS\n");				\
+	} else	{							\
+		printf("FAIL\n");				\
+		exit(1);						\
+	}									\
+} while(0)
+
+#define STRESS_ITEMS 1000000
+#define STRESS_THIEVES 4
+
+/* Create */
+void test_create(void)
+{
+	fprintf(stderr, "*** TEST create ***\n");
+
+	wsdeque_t d = wsdeque_create();
+	TEST_ASSERT(d != NULL);
+	TEST_ASSERT(wsdeque_destroy(d) == 0);
+}
+
+/* Owner side is LIFO */
+void test_push_pop(void)
+{
+	int data1 = 1, data2 = 2, *ptr;
+	wsdeque_t d;
+
+	fprintf(stderr, "*** TEST push_pop ***\n");
+
+	d = wsdeque_create();
+	wsdeque_push(d, &data1);
+	wsdeque_push(d, &data2);
+	wsdeque_pop(d, (void**)&ptr);
+	TEST_ASSERT(ptr == &data2);
+	wsdeque_pop(d, (void**)&ptr);
+	TEST_ASSERT(ptr == &data1);
+	TEST_ASSERT(wsdeque_pop(d, (void**)&ptr) == -1);
+}
+
+/* Thief side is FIFO */
+void test_steal(void)
+{
+	int data1 = 1, data2 = 2, *ptr;
+	wsdeque_t d;
+
+	fprintf(stderr, "*** TEST steal ***\n");
+
+	d = wsdeque_create();
+	wsdeque_push(d, &data1);
+	wsdeque_push(d, &data2);
+	wsdeque_steal(d, (void**)&ptr);
+	TEST_ASSERT(ptr == &data1);
+	TEST_ASSERT(wsdeque_length(d) == 1);
+	wsdeque_steal(d, (void**)&ptr);
+	TEST_ASSERT(ptr == &data2);
+	TEST_ASSERT(wsdeque_steal(d, (void**)&ptr) == -1);
+}
+
+/* Growth keeps every item in order */
+void test_grow(void)
+{
+	int data[1000];
+	int *ptr = NULL;
+	int ordered = 1;
+	wsdeque_t d;
+
+	fprintf(stderr, "*** TEST grow ***\n");
+
+	d = wsdeque_create();
+	for (int i = 0; i < 1000; i++) {
+		wsdeque_push(d, &data[i]);
+	}
+	TEST_ASSERT(wsdeque_length(d) == 1000);
+
+	for (int i = 0; i < 1000; i++) {
+		wsdeque_steal(d, (void**)&ptr);
+		ordered &= (ptr == &data[i]);
+	}
+	TEST_ASSERT(ordered);
+	TEST_ASSERT(wsdeque_destroy(d) == 0);
+}
+
+/* NULL arguments */
+void test_null(void)
+{
+	void *ptr;
+
+	fprintf(stderr, "*** TEST null ***\n");
+
+	TEST_ASSERT(wsdeque_push(NULL, &ptr) == -1);
+	TEST_ASSERT(wsdeque_pop(NULL, &ptr) == -1);
+	TEST_ASSERT(wsdeque_steal(NULL, &ptr) == -1);
+	TEST_ASSERT(wsdeque_destroy(NULL) == -1);
+}
+
+static wsdeque_t stressDeque;
+static atomic_int taken[STRESS_ITEMS + 1];
+static atomic_int ownerDone;
+
+static void *thief(void *arg)
+{
+	void *item;
+	(void)arg;
+
+	while (!atomic_load(&ownerDone) || wsdeque_length(stressDeque) > 0) {
+		if (wsdeque_steal(stressDeque, &item) == 0) {
+			atomic_fetch_add(&taken[(intptr_t)item], 1);
+		}
+	}
+
+	return NULL;
+}
+
+/* One owner, several thieves, every item taken exactly once */
+void test_stress(void)
+{
+	pthread_t thieves[STRESS_THIEVES];
+	void *item;
+	int exactlyOnce = 1;
+
+	fprintf(stderr, "*** TEST stress ***\n");
+
+	stressDeque = wsdeque_create();
+
+	for (int i = 0; i < STRESS_THIEVES; i++) {
+		pthread_create(&thieves[i], NULL, thief, NULL);
+	}
+
+	// Owner pushes everything, popping one item back every third push.
+	for (intptr_t i = 1; i <= STRESS_ITEMS; i++) {
+		wsdeque_push(stressDeque, (void*)i);
+		if (i % 3 == 0 && wsdeque_pop(stressDeque, &item) == 0) {
+			atomic_fetch_add(&taken[(intptr_t)item], 1);
+		}
+	}
+
+	while (wsdeque_pop(stressDeque, &item) == 0) {
+		atomic_fetch_add(&taken[(intptr_t)item], 1);
+	}
+	atomic_store(&ownerDone, 1);
+
+	for (int i = 0; i < STRESS_THIEVES; i++) {
+		pthread_join(thieves[i], NULL);
+	}
+
+	for (int i = 1; i <= STRESS_ITEMS; i++) {
+		exactlyOnce &= (atomic_load(&taken[i]) == 1);
+	}
+
+	TEST_ASSERT(exactlyOnce);
+	TEST_ASSERT(wsdeque_destroy(stressDeque) == 0);
+}
+
+int main(void)
+{
+	test_create();
+	test_push_pop();
+	test_steal();
+	test_grow();
+	test_null();
+	test_stress();
+
+	return 0;
+}
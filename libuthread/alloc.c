@@ -0,0 +1,127 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "private.h"
+#include "uthread.h"
+
+/* Size of the chunks the arenas are made of, header included */
+#define CHUNK_SIZE 16384
+
+/* Alignment of every allocation, as malloc() provides */
+#define ALLOC_ALIGN 16
+
+/**
+ * @brief chunk - Block of memory carved by a thread arena
+ *
+ * next:	Next chunk of the same arena, or of the free list
+ * data:	Memory handed out, aligned on ALLOC_ALIGN
+ */
+struct chunk {
+	struct chunk* next;
+	_Alignas(ALLOC_ALIGN) char data[];
+};
+
+/* Usable bytes of a regular chunk */
+#define CHUNK_DATA (CHUNK_SIZE - offsetof(struct chunk, data))
+
+/*
+ * Regular chunks given back by exited threads, reused before allocating new
+ * ones. Each scheduler has its own, as threads are only ever destroyed by
+ * their own scheduler.
+ */
+static __thread struct chunk* freeChunks = NULL;
+
+/*
+ * newChunk - Take a regular chunk from the free list, or allocate one
+ */
+static struct chunk* newChunk(void)
+{
+	struct chunk* chunk = freeChunks;
+
+	if (chunk != NULL) {
+		freeChunks = chunk->next;
+		return chunk;
+	}
+
+	return malloc(CHUNK_SIZE);
+}
+
+void *uthread_alloc(size_t size)
+{
+	if (currentThread == NULL || size == 0 || size > SIZE_MAX / 2) {
+		return NULL;
+	}
+
+	struct alloc_arena* arena = &currentThread->arena;
+
+	size = (size + ALLOC_ALIGN - 1) & ~(size_t)(ALLOC_ALIGN - 1);
+
+	// Larger than a chunk: a chunk of its own, freed as is.
+	if (size > CHUNK_DATA) {
+		struct chunk* large = malloc(offsetof(struct chunk, data) + size);
+
+		if (large == NULL) {
+			return NULL;
+		}
+
+		large->next = arena->large;
+		arena->large = large;
+		return large->data;
+	}
+
+	if ((size_t)(arena->end - arena->next) < size) {
+		struct chunk* chunk = newChunk();
+
+		if (chunk == NULL) {
+			return NULL;
+		}
+
+		// The rest of the current chunk is wasted.
+		if (arena->chunks == NULL) {
+			arena->last = chunk;
+		}
+		chunk->next = arena->chunks;
+		arena->chunks = chunk;
+		arena->next = chunk->data;
+		arena->end = chunk->data + CHUNK_DATA;
+	}
+
+	void* memory = arena->next;
+	arena->next += size;
+
+	return memory;
+}
+
+void alloc_release(TCB* tcb)
+{
+	struct alloc_arena* arena = &tcb->arena;
+
+	// Regular chunks go back to the free list at once.
+	if (arena->chunks != NULL) {
+		arena->last->next = freeChunks;
+		freeChunks = arena->chunks;
+	}
+
+	while (arena->large != NULL) {
+		struct chunk* large = arena->large;
+
+		arena->large = large->next;
+		free(large);
+	}
+
+	arena->chunks = NULL;
+	arena->last = NULL;
+	arena->next = NULL;
+	arena->end = NULL;
+}
+
+void alloc_stop(void)
+{
+	while (freeChunks != NULL) {
+		struct chunk* chunk = freeChunks;
+
+		freeChunks = chunk->next;
+		free(chunk);
+	}
+}
@@ -0,0 +1,165 @@
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "private.h"
+#include "queue.h"
+#include "uthread.h"
+
+/**
+ * @brief uthread_barrier - Struct representing a barrier
+ *
+ * int count:		Number of threads meeting at each phase
+ * int arrived:		Number of threads waiting at the current phase
+ * queue_t waiters:	Threads blocked until the last one arrives
+ */
+struct uthread_barrier {
+	int count;
+	int arrived;
+	queue_t waiters;
+};
+
+/**
+ * @brief uthread_latch - Struct representing a countdown latch
+ *
+ * int counter:		Number of count downs left before the latch opens
+ * queue_t waiters:	Threads blocked until the counter drops to 0
+ */
+struct uthread_latch {
+	int counter;
+	queue_t waiters;
+};
+
+uthread_barrier_t uthread_barrier_create(int count)
+{
+	if (count < 1) {
+		return NULL;
+	}
+
+	uthread_barrier_t barrier = malloc(sizeof(struct uthread_barrier));
+
+	if (barrier == NULL) {
+		return NULL;
+	}
+
+	barrier->waiters = queue_create();
+
+	if (barrier->waiters == NULL) {
+		free(barrier);
+		return NULL;
+	}
+
+	barrier->count = count;
+	barrier->arrived = 0;
+
+	return barrier;
+}
+
+int uthread_barrier_destroy(uthread_barrier_t barrier)
+{
+	if (barrier == NULL || barrier->arrived > 0) {
+		return -1;
+	}
+
+	queue_destroy(barrier->waiters);
+	free(barrier);
+	return 0;
+}
+
+int uthread_barrier_wait(uthread_barrier_t barrier)
+{
+	if (barrier == NULL) {
+		return -1;
+	}
+
+	// Last one in: the phase is over, release everybody at once.
+	if (++barrier->arrived == barrier->count) {
+		barrier->arrived = 0;
+		uthread_unblock_all(barrier->waiters);
+		return 1;
+	}
+
+	// Nobody could release the thread if it is not queued.
+	if (queue_enqueue(barrier->waiters, currentThread) == -1) {
+		barrier->arrived--;
+		return -1;
+	}
+
+	if (uthread_block() == -1) {
+		queue_delete(barrier->waiters, currentThread);
+		barrier->arrived--;
+		return -1;
+	}
+
+	return 0;
+}
+
+uthread_latch_t uthread_latch_create(int count)
+{
+	if (count < 0) {
+		return NULL;
+	}
+
+	uthread_latch_t latch = malloc(sizeof(struct uthread_latch));
+
+	if (latch == NULL) {
+		return NULL;
+	}
+
+	latch->waiters = queue_create();
+
+	if (latch->waiters == NULL) {
+		free(latch);
+		return NULL;
+	}
+
+	latch->counter = count;
+
+	return latch;
+}
+
+int uthread_latch_destroy(uthread_latch_t latch)
+{
+	if (latch == NULL || queue_length(latch->waiters) > 0) {
+		return -1;
+	}
+
+	queue_destroy(latch->waiters);
+	free(latch);
+	return 0;
+}
+
+int uthread_latch_count_down(uthread_latch_t latch)
+{
+	if (latch == NULL || latch->counter == 0) {
+		return -1;
+	}
+
+	// Opened: release every waiter at once.
+	if (--latch->counter == 0) {
+		uthread_unblock_all(latch->waiters);
+	}
+
+	return 0;
+}
+
+int uthread_latch_wait(uthread_latch_t latch)
+{
+	if (latch == NULL) {
+		return -1;
+	}
+
+	if (latch->counter == 0) {
+		return 0;
+	}
+
+	if (queue_enqueue(latch->waiters, currentThread) == -1) {
+		return -1;
+	}
+
+	if (uthread_block() == -1) {
+		queue_delete(latch->waiters, currentThread);
+		return -1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,241 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "private.h"
+#include "uthread.h"
+
+/* Number of helper kernel threads running blocking calls */
+#define BLOCKING_HELPERS 4
+
+/* Maximum number of completions collected per read() on the pipe */
+#define BLOCKING_BATCH 64
+
+/**
+ * @brief blocking_request - A blocking call shipped to the helper pool
+ *
+ * The request lives on the stack of the calling thread, which stays blocked
+ * until a helper reports the request as complete.
+ *
+ * func, arg:	Call to perform
+ * result:	Return value of the call
+ * error:	Value of errno after the call
+ * tcb:		Thread to unblock once the call completed
+ * doneFd:	Completion pipe of the scheduler running @tcb
+ * next:	Next request waiting for a helper
+ */
+struct blocking_request {
+	uthread_blocking_func_t func;
+	void* arg;
+	long result;
+	int error;
+	TCB* tcb;
+	int doneFd;
+	struct blocking_request* next;
+};
+
+/*
+ * The helpers are shared by all the schedulers of the process, each scheduler
+ * collecting its own completions from its own pipe.
+ */
+static pthread_t helpers[BLOCKING_HELPERS];
+static int numHelpers = 0;
+
+/* Requests waiting for a helper, and the helpers, protected by @lock */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t available = PTHREAD_COND_INITIALIZER;
+static struct blocking_request* head = NULL;
+static struct blocking_request* tail = NULL;
+static int stopping = 0;
+
+/* Helpers write completed requests to donePipe[1], the scheduler reads them */
+static __thread int donePipe[2] = { -1, -1 };
+
+/* Requests submitted but not yet collected, only touched by the scheduler */
+static __thread int pending = 0;
+
+static void* helperMain(void* arg)
+{
+	(void)arg;
+
+	for (;;) {
+		pthread_mutex_lock(&lock);
+		while (head == NULL && !stopping) {
+			pthread_cond_wait(&available, &lock);
+		}
+
+		if (head == NULL) {
+			pthread_mutex_unlock(&lock);
+			return NULL;
+		}
+
+		struct blocking_request* req = head;
+		head = req->next;
+		if (head == NULL) {
+			tail = NULL;
+		}
+		pthread_mutex_unlock(&lock);
+
+		req->result = req->func(req->arg);
+		req->error = errno;
+
+		// Pointer-sized writes to a pipe are atomic.
+		while (write(req->doneFd, &req, sizeof(req)) == -1 &&
+		       errno == EINTR) {
+			// Interrupted by a signal, write again.
+		}
+	}
+}
+
+/*
+ * startHelpers - Start the helper pool, if not already started
+ *
+ * Also opens the completion pipe of the calling scheduler.
+ *
+ * Return: 0 if the pool is running, -1 if it could not be started.
+ */
+static int startHelpers(void)
+{
+	if (donePipe[0] != -1) {
+		return 0;
+	}
+
+	if (pipe(donePipe) == -1) {
+		return -1;
+	}
+
+	// The scheduler collects completions without ever blocking on read().
+	fcntl(donePipe[0], F_SETFL, O_NONBLOCK);
+	fcntl(donePipe[0], F_SETFD, FD_CLOEXEC);
+	fcntl(donePipe[1], F_SETFD, FD_CLOEXEC);
+
+	pthread_mutex_lock(&lock);
+
+	if (numHelpers == 0) {
+		// Helpers must not receive the signals meant for the scheduler.
+		sigset_t all, old;
+		sigfillset(&all);
+		pthread_sigmask(SIG_SETMASK, &all, &old);
+
+		stopping = 0;
+		while (numHelpers < BLOCKING_HELPERS) {
+			if (pthread_create(&helpers[numHelpers], NULL, helperMain,
+					   NULL)) {
+				break;
+			}
+			numHelpers++;
+		}
+
+		pthread_sigmask(SIG_SETMASK, &old, NULL);
+	}
+
+	int started = numHelpers > 0;
+	pthread_mutex_unlock(&lock);
+
+	if (!started) {
+		close(donePipe[0]);
+		close(donePipe[1]);
+		donePipe[0] = donePipe[1] = -1;
+		return -1;
+	}
+
+	return 0;
+}
+
+long uthread_blocking_call(uthread_blocking_func_t func, void *arg)
+{
+	if (func == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	// Library not started or no helper available, call in place.
+	if (currentThread == NULL || startHelpers() == -1) {
+		return func(arg);
+	}
+
+	struct blocking_request req = {
+		.func = func,
+		.arg = arg,
+		.tcb = currentThread,
+		.doneFd = donePipe[1],
+		.next = NULL,
+	};
+
+	pthread_mutex_lock(&lock);
+	if (tail != NULL) {
+		tail->next = &req;
+	} else {
+		head = &req;
+	}
+	tail = &req;
+	pthread_cond_signal(&available);
+	pthread_mutex_unlock(&lock);
+
+	pending++;
+
+	// Let other threads run until a helper is done with the call.
+	uthread_block();
+
+	errno = req.error;
+	return req.result;
+}
+
+int blocking_pending(void)
+{
+	return pending;
+}
+
+int blocking_fd(void)
+{
+	return donePipe[0];
+}
+
+void blocking_poll(void)
+{
+	struct blocking_request* done[BLOCKING_BATCH];
+	ssize_t bytes;
+
+	if (donePipe[0] == -1) {
+		return;
+	}
+
+	// Each completion is written as a whole pointer, so reads never split one.
+	while ((bytes = read(donePipe[0], done, sizeof(done))) > 0) {
+		int count = bytes / sizeof(done[0]);
+
+		for (int i = 0; i < count; i++) {
+			pending--;
+			uthread_unblock(done[i]->tcb);
+		}
+	}
+}
+
+void blocking_stop(void)
+{
+	if (donePipe[0] != -1) {
+		close(donePipe[0]);
+		close(donePipe[1]);
+		donePipe[0] = donePipe[1] = -1;
+	}
+
+	// Other shards may still be using the helpers.
+	if (shard_count() > 0 || numHelpers == 0) {
+		return;
+	}
+
+	pthread_mutex_lock(&lock);
+	stopping = 1;
+	pthread_cond_broadcast(&available);
+	pthread_mutex_unlock(&lock);
+
+	for (int i = 0; i < numHelpers; i++) {
+		pthread_join(helpers[i], NULL);
+	}
+	numHelpers = 0;
+}
@@ -4,28 +4,38 @@
 #include "private.h"
 #include "uthread.h"
 
-/* Size of the stack for a thread (in bytes) */
-#define UTHREAD_STACK_SIZE 32768
-
 void uthread_ctx_switch(uthread_ctx_t *prev, uthread_ctx_t *next)
 {
 	/*
 	 * swapcontext() saves the current context in structure pointer by @prev
 	 * and actives the context pointed by @next
 	 */
+	profileSwitching = 1;
 	if (swapcontext(prev, next)) {
 		perror("swapcontext");
 		exit(1);
 	}
+	profileSwitching = 0;
 }
 
 void *uthread_ctx_alloc_stack(void)
 {
-	return malloc(UTHREAD_STACK_SIZE);
+	void *stack = arena_alloc_stack();
+
+	// Arena disabled or exhausted.
+	if (stack == NULL) {
+		stack = malloc(UTHREAD_STACK_SIZE);
+	}
+
+	return stack;
 }
 
 void uthread_ctx_destroy_stack(void *top_of_stack)
 {
+	if (arena_free_stack(top_of_stack) == 0) {
+		return;
+	}
+
 	free(top_of_stack);
 }
 
@@ -39,6 +49,7 @@ static void uthread_ctx_bootstrap(uthread_func_t func)
 	 * Enable interrupts right after being elected to run for the first time
 	 */
 	preempt_enable();
+	profileSwitching = 0;
 
 	/* Execute thread and when done, exit with the return value */
 	uthread_exit(func());
@@ -0,0 +1,134 @@
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "private.h"
+#include "uthread.h"
+
+/* Rounds of destructors at exit, for destructors setting values themselves */
+#define DESTRUCTOR_ROUNDS 4
+
+/* Destructor of every key, set before the key is handed out */
+static void (*destructors[UTHREAD_KEYS_MAX])(void *);
+
+/* Number of keys created, shared by every scheduler */
+static atomic_int numKeys;
+
+/*
+ * slotOf - Slot of @key in thread @tcb
+ * @create: Whether to allocate the spill array if needed
+ *
+ * Return: NULL if @key lives in the spill array and there is none, or it could
+ * not be allocated.
+ */
+static void** slotOf(TCB* tcb, int key, int create)
+{
+	if (key < LOCALS_INLINE) {
+		return &tcb->locals[key];
+	}
+
+	if (tcb->spilledLocals == NULL) {
+		if (!create) {
+			return NULL;
+		}
+
+		tcb->spilledLocals = calloc(UTHREAD_KEYS_MAX - LOCALS_INLINE,
+					    sizeof(void*));
+
+		if (tcb->spilledLocals == NULL) {
+			return NULL;
+		}
+	}
+
+	return &tcb->spilledLocals[key - LOCALS_INLINE];
+}
+
+int uthread_key_create(void (*destructor)(void *))
+{
+	int key = atomic_load(&numKeys);
+
+	do {
+		if (key == UTHREAD_KEYS_MAX) {
+			return -1;
+		}
+	} while (!atomic_compare_exchange_weak(&numKeys, &key, key + 1));
+
+	// Not used before exit, which needs a value set with the key first.
+	destructors[key] = destructor;
+
+	return key;
+}
+
+void *uthread_getspecific(int key)
+{
+	TCB* self = currentThread;
+
+	// Fast path: an index and a load.
+	if ((unsigned)key < LOCALS_INLINE && self != NULL) {
+		return self->locals[key];
+	}
+
+	if (key < LOCALS_INLINE || key >= UTHREAD_KEYS_MAX || self == NULL ||
+	    self->spilledLocals == NULL) {
+		return NULL;
+	}
+
+	return self->spilledLocals[key - LOCALS_INLINE];
+}
+
+int uthread_setspecific(int key, const void *value)
+{
+	if (key < 0 || key >= atomic_load_explicit(&numKeys,
+						  memory_order_relaxed) ||
+	    currentThread == NULL) {
+		return -1;
+	}
+
+	void** slot = slotOf(currentThread, key, value != NULL);
+
+	// Nothing spilled yet, so the value was NULL already.
+	if (slot == NULL) {
+		return value != NULL ? -1 : 0;
+	}
+
+	*slot = (void*)value;
+	return 0;
+}
+
+void locals_exit(TCB* tcb)
+{
+	int keys = atomic_load(&numKeys);
+
+	for (int round = 0; round < DESTRUCTOR_ROUNDS; round++) {
+		int called = 0;
+
+		for (int key = 0; key < keys; key++) {
+			void** slot = slotOf(tcb, key, 0);
+
+			if (slot == NULL) {
+				break;
+			}
+
+			void* value = *slot;
+
+			if (value == NULL || destructors[key] == NULL) {
+				continue;
+			}
+
+			// Cleared first, as in POSIX: the destructor may set it again.
+			*slot = NULL;
+			destructors[key](value);
+			called = 1;
+		}
+
+		if (!called) {
+			break;
+		}
+	}
+}
+
+void locals_release(TCB* tcb)
+{
+	free(tcb->spilledLocals);
+	tcb->spilledLocals = NULL;
+}
@@ -0,0 +1,179 @@
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "mpmc_queue.h"
+
+/* Size of a cache line, used to keep producer and consumer indices apart */
+#define CACHE_LINE 64
+
+/**
+ * @brief mpmc_slot - A single slot of the queue
+ *
+ * sequence:	Equal to the enqueue position when the slot is free for that
+ *		position, and to position + 1 once it holds an item
+ * value:	Data item stored in the slot
+ */
+struct mpmc_slot {
+	_Atomic size_t sequence;
+	void* value;
+};
+
+/**
+ * @brief mpmc_queue - Struct representing lock-free queue data structure
+ *
+ * enqueuePos:	Next position to be claimed by a producer
+ * dequeuePos:	Next position to be claimed by a consumer
+ * mask:	Capacity - 1, capacity being a power of 2
+ * slots:	Array of capacity slots
+ */
+struct mpmc_queue {
+	_Alignas(CACHE_LINE) _Atomic size_t enqueuePos;
+	_Alignas(CACHE_LINE) _Atomic size_t dequeuePos;
+	_Alignas(CACHE_LINE) size_t mask;
+	struct mpmc_slot* slots;
+};
+
+mpmc_queue_t mpmc_queue_create(unsigned int capacity)
+{
+	if (capacity == 0) {
+		return NULL;
+	}
+
+	// Round capacity up to a power of 2 so positions wrap with a mask.
+	size_t size = 1;
+	while (size < capacity) {
+		size <<= 1;
+	}
+
+	mpmc_queue_t queue = aligned_alloc(CACHE_LINE, sizeof(struct mpmc_queue));
+
+	if (queue == NULL) {
+		return NULL;
+	}
+
+	queue->slots = malloc(size * sizeof(struct mpmc_slot));
+
+	if (queue->slots == NULL) {
+		free(queue);
+		return NULL;
+	}
+
+	for (size_t i = 0; i < size; i++) {
+		atomic_init(&queue->slots[i].sequence, i);
+		queue->slots[i].value = NULL;
+	}
+
+	queue->mask = size - 1;
+	atomic_init(&queue->enqueuePos, 0);
+	atomic_init(&queue->dequeuePos, 0);
+
+	return queue;
+}
+
+int mpmc_queue_destroy(mpmc_queue_t queue)
+{
+	if (queue == NULL) {
+		return -1;
+	}
+
+	if (mpmc_queue_length(queue) != 0) {
+		return -1;
+	}
+
+	free(queue->slots);
+	free(queue);
+	return 0;
+}
+
+int mpmc_queue_enqueue(mpmc_queue_t queue, void *data)
+{
+	if (queue == NULL || data == NULL) {
+		return -1;
+	}
+
+	struct mpmc_slot* slot;
+	size_t pos = atomic_load_explicit(&queue->enqueuePos, memory_order_relaxed);
+
+	for (;;) {
+		slot = &queue->slots[pos & queue->mask];
+		size_t seq = atomic_load_explicit(&slot->sequence,
+						  memory_order_acquire);
+		intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+		if (diff == 0) {
+			// Slot is free for this position, try to claim it.
+			if (atomic_compare_exchange_weak_explicit(&queue->enqueuePos,
+					&pos, pos + 1, memory_order_relaxed,
+					memory_order_relaxed)) {
+				break;
+			}
+		} else if (diff < 0) {
+			// Slot still holds the item from one lap ago: queue is full.
+			return -1;
+		} else {
+			// Another producer claimed this position, reload.
+			pos = atomic_load_explicit(&queue->enqueuePos,
+						   memory_order_relaxed);
+		}
+	}
+
+	slot->value = data;
+	atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);
+
+	return 0;
+}
+
+int mpmc_queue_dequeue(mpmc_queue_t queue, void **data)
+{
+	if (queue == NULL || data == NULL) {
+		return -1;
+	}
+
+	struct mpmc_slot* slot;
+	size_t pos = atomic_load_explicit(&queue->dequeuePos, memory_order_relaxed);
+
+	for (;;) {
+		slot = &queue->slots[pos & queue->mask];
+		size_t seq = atomic_load_explicit(&slot->sequence,
+						  memory_order_acquire);
+		intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+		if (diff == 0) {
+			// Slot holds the item for this position, try to claim it.
+			if (atomic_compare_exchange_weak_explicit(&queue->dequeuePos,
+					&pos, pos + 1, memory_order_relaxed,
+					memory_order_relaxed)) {
+				break;
+			}
+		} else if (diff < 0) {
+			// Producer has not filled this slot yet: queue is empty.
+			return -1;
+		} else {
+			// Another consumer claimed this position, reload.
+			pos = atomic_load_explicit(&queue->dequeuePos,
+						   memory_order_relaxed);
+		}
+	}
+
+	*data = slot->value;
+
+	// Hand the slot back to producers for the next lap.
+	atomic_store_explicit(&slot->sequence, pos + queue->mask + 1,
+			      memory_order_release);
+
+	return 0;
+}
+
+int mpmc_queue_length(mpmc_queue_t queue)
+{
+	if (queue == NULL) {
+		return -1;
+	}
+
+	size_t head = atomic_load_explicit(&queue->dequeuePos, memory_order_relaxed);
+	size_t tail = atomic_load_explicit(&queue->enqueuePos, memory_order_relaxed);
+
+	return tail > head ? (int)(tail - head) : 0;
+}
@@ -0,0 +1,71 @@
+#ifndef _MPMC_QUEUE_H
+#define _MPMC_QUEUE_H
+
+/*
+ * mpmc_queue_t - Lock-free multi-producer/multi-consumer queue type
+ *
+ * A bounded FIFO queue which can be shared between kernel threads without a
+ * lock. Any number of threads may enqueue and dequeue concurrently, which makes
+ * it suitable for handing work from pthreads to the uthread scheduler.
+ *
+ * Items are stored in a fixed array of slots, each carrying a sequence number
+ * that tells producers and consumers whose turn it is (Vyukov's bounded queue).
+ * Enqueue and dequeue are O(1) and never allocate memory, so they are also safe
+ * to call from signal handlers.
+ *
+ * Apart from being bounded and thread-safe, the semantics match those of
+ * queue_t: data items are dequeued in the order they were enqueued.
+ */
+typedef struct mpmc_queue* mpmc_queue_t;
+
+/*
+ * mpmc_queue_create - Allocate an empty lock-free queue
+ * @capacity: Maximum number of items, rounded up to a power of 2
+ *
+ * Return: Pointer to new empty queue. NULL if @capacity is 0 or in case of
+ * failure when allocating the new queue.
+ */
+mpmc_queue_t mpmc_queue_create(unsigned int capacity);
+
+/*
+ * mpmc_queue_destroy - Deallocate a lock-free queue
+ * @queue: Queue to deallocate
+ *
+ * No other thread may be accessing @queue at this point.
+ *
+ * Return: -1 if @queue is NULL or if @queue is not empty. 0 if @queue was
+ * successfully destroyed.
+ */
+int mpmc_queue_destroy(mpmc_queue_t queue);
+
+/*
+ * mpmc_queue_enqueue - Enqueue data item
+ * @queue: Queue in which to enqueue item
+ * @data: Address of data item to enqueue
+ *
+ * Return: -1 if @queue or @data are NULL, or if the queue is full. 0 if @data
+ * was successfully enqueued in @queue.
+ */
+int mpmc_queue_enqueue(mpmc_queue_t queue, void *data);
+
+/*
+ * mpmc_queue_dequeue - Dequeue data item
+ * @queue: Queue in which to dequeue item
+ * @data: Address of data pointer where item is received
+ *
+ * Return: -1 if @queue or @data are NULL, or if the queue is empty. 0 if @data
+ * was set with the oldest item available in @queue.
+ */
+int mpmc_queue_dequeue(mpmc_queue_t queue, void **data);
+
+/*
+ * mpmc_queue_length - Queue length
+ * @queue: Queue to get the length of
+ *
+ * The length is only a snapshot when other threads are active.
+ *
+ * Return: -1 if @queue is NULL. Length of @queue otherwise.
+ */
+int mpmc_queue_length(mpmc_queue_t queue);
+
+#endif /* _MPMC_QUEUE_H */
@@ -0,0 +1,181 @@
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "private.h"
+#include "uthread.h"
+
+/* Counting modes of a scheduler */
+#define PERF_OFF 0
+#define PERF_TSC 1
+#define PERF_HW 2
+
+/* Whether schedulers started from now on count, see uthread_perf_counters() */
+static int perfEnabled = 0;
+
+/* Events of the group, in the order of TCB.perf, the first one leads */
+static const uint64_t perfEvents[PERF_COUNTERS] = {
+	[PERF_INSTRUCTIONS] = PERF_COUNT_HW_INSTRUCTIONS,
+	[PERF_CYCLES] = PERF_COUNT_HW_CPU_CYCLES,
+	[PERF_CACHE_MISSES] = PERF_COUNT_HW_CACHE_MISSES,
+	[PERF_BRANCH_MISSES] = PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+/*
+ * Counting mode of the calling scheduler, the descriptors of its event group
+ * and the counter values at the last switch.
+ */
+static __thread int perfMode = PERF_OFF;
+static __thread int perfFds[PERF_COUNTERS] = { -1, -1, -1, -1 };
+static __thread uint64_t perfLast[PERF_COUNTERS];
+
+/*
+ * openEvent - Open a counter of the calling kernel thread
+ * @config: PERF_COUNT_HW_* event
+ * @leader: Descriptor of the group leader, -1 to open the leader
+ *
+ * Only user space is counted, which unprivileged processes are allowed to do
+ * under the default perf_event_paranoid setting.
+ */
+static int openEvent(uint64_t config, int leader)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = config;
+	attr.disabled = leader == -1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_GROUP;
+
+	return syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+}
+
+static void closeEvents(void)
+{
+	for (int i = 0; i < PERF_COUNTERS; i++) {
+		if (perfFds[i] != -1) {
+			close(perfFds[i]);
+			perfFds[i] = -1;
+		}
+	}
+}
+
+/*
+ * readCounters - Read the current value of every counter
+ * @values: Array of PERF_COUNTERS values, only cycles in TSC mode
+ */
+static void readCounters(uint64_t* values)
+{
+	if (perfMode == PERF_HW) {
+		struct {
+			uint64_t nr;
+			uint64_t values[PERF_COUNTERS];
+		} group;
+
+		// One system call for the whole group.
+		if (read(perfFds[0], &group, sizeof(group)) == sizeof(group)) {
+			memcpy(values, group.values, sizeof(group.values));
+			return;
+		}
+
+		// Counters lost (e.g., multiplexed out), keep the last values.
+		memcpy(values, perfLast, sizeof(perfLast));
+		return;
+	}
+
+	memset(values, 0, PERF_COUNTERS * sizeof(uint64_t));
+	values[PERF_CYCLES] = uthread_clock();
+}
+
+void perf_start(void)
+{
+	if (!perfEnabled) {
+		perfMode = PERF_OFF;
+		return;
+	}
+
+	perfMode = PERF_HW;
+
+	for (int i = 0; i < PERF_COUNTERS; i++) {
+		perfFds[i] = openEvent(perfEvents[i], i == 0 ? -1 : perfFds[0]);
+
+		// No PMU (e.g., in a virtual machine), or not allowed.
+		if (perfFds[i] == -1) {
+			closeEvents();
+			perfMode = PERF_TSC;
+			break;
+		}
+	}
+
+	if (perfMode == PERF_HW) {
+		ioctl(perfFds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+		ioctl(perfFds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	}
+
+	readCounters(perfLast);
+}
+
+void perf_switch(TCB* tcb)
+{
+	uint64_t now[PERF_COUNTERS];
+
+	if (perfMode == PERF_OFF) {
+		return;
+	}
+
+	readCounters(now);
+
+	for (int i = 0; i < PERF_COUNTERS; i++) {
+		tcb->perf[i] += now[i] - perfLast[i];
+		perfLast[i] = now[i];
+	}
+}
+
+void perf_stop(void)
+{
+	closeEvents();
+	perfMode = PERF_OFF;
+}
+
+void uthread_perf_counters(int enable)
+{
+	perfEnabled = enable;
+}
+
+int uthread_perf_thread(uthread_t tid, struct uthread_perf_stats *stats)
+{
+	uint64_t counts[PERF_COUNTERS];
+
+	if (stats == NULL || perfMode == PERF_OFF || threadTable == NULL ||
+	    threadTable[tid] == NULL) {
+		return -1;
+	}
+
+	TCB* tcb = threadTable[tid];
+
+	memcpy(counts, tcb->perf, sizeof(counts));
+
+	// The calling thread is running right now, include its current slice.
+	if (tcb == currentThread) {
+		uint64_t now[PERF_COUNTERS];
+
+		readCounters(now);
+		for (int i = 0; i < PERF_COUNTERS; i++) {
+			counts[i] += now[i] - perfLast[i];
+		}
+	}
+
+	stats->instructions = counts[PERF_INSTRUCTIONS];
+	stats->cycles = counts[PERF_CYCLES];
+	stats->cacheMisses = counts[PERF_CACHE_MISSES];
+	stats->branchMisses = counts[PERF_BRANCH_MISSES];
+	stats->hardware = perfMode == PERF_HW;
+
+	return 0;
+}
@@ -0,0 +1,263 @@
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "private.h"
+#include "queue.h"
+#include "uthread.h"
+
+/**
+ * @brief uthread_future - Struct representing the result of a work item
+ *
+ * int done:		Whether the item was executed
+ * int result:		Return value of the item
+ * TCB* waiter:		Thread blocked in uthread_future_get(), if any
+ */
+struct uthread_future {
+	int done;
+	int result;
+	TCB* waiter;
+};
+
+/**
+ * @brief closure - A work item waiting for a worker
+ */
+struct closure {
+	uthread_task_func_t func;
+	void* arg;
+	struct uthread_future* future;
+};
+
+/**
+ * @brief uthread_pool - Struct representing a worker pool
+ *
+ * struct closure* items:	Circular buffer of items waiting for a worker
+ * int capacity:		Size of @items
+ * int head:			Index of the oldest item
+ * int count:			Number of items waiting
+ * queue_t idleWorkers:		Workers blocked until an item is submitted
+ * queue_t submitters:		Threads blocked until there is room in @items
+ * uthread_t* workers:		TIDs of the workers
+ * int numWorkers:		Number of workers
+ * int stopping:		Set once the pool is being destroyed
+ */
+struct uthread_pool {
+	struct closure* items;
+	int capacity;
+	int head;
+	int count;
+	queue_t idleWorkers;
+	queue_t submitters;
+	uthread_t* workers;
+	int numWorkers;
+	int stopping;
+};
+
+/*
+ * workerMain - Worker loop
+ * @arg: Pool the worker belongs to
+ *
+ * Run items until the pool is being destroyed and no item is left, or until
+ * no other thread could ever submit one.
+ */
+static int workerMain(void* arg)
+{
+	uthread_pool_t pool = arg;
+
+	for (;;) {
+		while (pool->count == 0) {
+			if (pool->stopping) {
+				return 0;
+			}
+
+			// Nobody could wake the worker up, it exits instead.
+			if (queue_enqueue(pool->idleWorkers, currentThread) == -1) {
+				return -1;
+			}
+
+			if (uthread_block() == -1) {
+				queue_delete(pool->idleWorkers, currentThread);
+				return -1;
+			}
+		}
+
+		struct closure item = pool->items[pool->head];
+		pool->head = (pool->head + 1) % pool->capacity;
+		pool->count--;
+
+		// There is room for one more item now.
+		TCB* submitter = NULL;
+		if (queue_dequeue(pool->submitters, (void**)&submitter) == 0) {
+			uthread_unblock(submitter);
+		}
+
+		int result = item.func(item.arg);
+
+		if (item.future != NULL) {
+			item.future->result = result;
+			item.future->done = 1;
+
+			if (item.future->waiter != NULL) {
+				uthread_unblock(item.future->waiter);
+			}
+		}
+	}
+}
+
+uthread_pool_t uthread_pool_create(int workers, int capacity)
+{
+	if (workers <= 0 || capacity <= 0) {
+		return NULL;
+	}
+
+	uthread_pool_t pool = calloc(1, sizeof(struct uthread_pool));
+
+	if (pool == NULL) {
+		return NULL;
+	}
+
+	pool->items = malloc(capacity * sizeof(struct closure));
+	pool->workers = malloc(workers * sizeof(uthread_t));
+	pool->idleWorkers = queue_create();
+	pool->submitters = queue_create();
+	pool->capacity = capacity;
+
+	if (pool->items == NULL || pool->workers == NULL ||
+	    pool->idleWorkers == NULL || pool->submitters == NULL) {
+		free(pool->items);
+		free(pool->workers);
+		queue_destroy(pool->idleWorkers);
+		queue_destroy(pool->submitters);
+		free(pool);
+		return NULL;
+	}
+
+	// Workers start as tasks, each keeps its stack once it first blocks.
+	for (int i = 0; i < workers; i++) {
+		int tid = uthread_spawn_task(workerMain, pool);
+
+		if (tid == -1) {
+			break;
+		}
+
+		pool->workers[pool->numWorkers++] = tid;
+	}
+
+	if (pool->numWorkers < workers) {
+		uthread_pool_destroy(pool);
+		return NULL;
+	}
+
+	return pool;
+}
+
+int uthread_pool_submit(uthread_pool_t pool, uthread_task_func_t func,
+			void *arg, uthread_future_t *future)
+{
+	if (pool == NULL || func == NULL) {
+		return -1;
+	}
+
+	// Backpressure: wait for a worker to take an item.
+	while (pool->count == pool->capacity && !pool->stopping) {
+		if (queue_enqueue(pool->submitters, currentThread) == -1) {
+			return -1;
+		}
+
+		if (uthread_block() == -1) {
+			queue_delete(pool->submitters, currentThread);
+			return -1;
+		}
+	}
+
+	if (pool->stopping) {
+		return -1;
+	}
+
+	struct uthread_future* result = NULL;
+
+	if (future != NULL) {
+		result = malloc(sizeof(struct uthread_future));
+
+		if (result == NULL) {
+			return -1;
+		}
+
+		result->done = 0;
+		result->waiter = NULL;
+		*future = result;
+	}
+
+	int tail = (pool->head + pool->count) % pool->capacity;
+	pool->items[tail].func = func;
+	pool->items[tail].arg = arg;
+	pool->items[tail].future = result;
+	pool->count++;
+
+	TCB* worker = NULL;
+	if (queue_dequeue(pool->idleWorkers, (void**)&worker) == 0) {
+		uthread_unblock(worker);
+	}
+
+	return 0;
+}
+
+int uthread_future_get(uthread_future_t future, int *result)
+{
+	if (future == NULL) {
+		return -1;
+	}
+
+	if (!future->done) {
+		future->waiter = currentThread;
+
+		// The item can never be executed, the future stays valid.
+		if (uthread_block() == -1) {
+			future->waiter = NULL;
+			return -1;
+		}
+	}
+
+	if (result != NULL) {
+		*result = future->result;
+	}
+
+	free(future);
+	return 0;
+}
+
+int uthread_pool_destroy(uthread_pool_t pool)
+{
+	if (pool == NULL) {
+		return -1;
+	}
+
+	// A worker cannot join itself: the pool would be freed under the
+	// workers still running.
+	for (int i = 0; i < pool->numWorkers; i++) {
+		if (pool->workers[i] == currentThread->TID) {
+			return -1;
+		}
+	}
+
+	pool->stopping = 1;
+
+	// Idle workers exit right away, busy ones once no item is left.
+	TCB* waiter = NULL;
+	while (queue_dequeue(pool->idleWorkers, (void**)&waiter) == 0) {
+		uthread_unblock(waiter);
+	}
+
+	while (queue_dequeue(pool->submitters, (void**)&waiter) == 0) {
+		uthread_unblock(waiter);
+	}
+
+	uthread_join_all(pool->workers, pool->numWorkers, NULL);
+
+	queue_destroy(pool->idleWorkers);
+	queue_destroy(pool->submitters);
+	free(pool->workers);
+	free(pool->items);
+	free(pool);
+
+	return 0;
+}
@@ -0,0 +1,323 @@
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "pqueue.h"
+
+/* Number of children of a heap node */
+#define ARITY 4
+
+/* Initial number of slots, grown by doubling */
+#define PQUEUE_INITIAL_SIZE 16
+
+/**
+ * @brief pqueue_entry - Slot of the heap
+ *
+ * key:		Key of the item
+ * data:	Data item
+ * handle:	Handle of the item, index in @positions
+ */
+struct pqueue_entry {
+	long long key;
+	void* data;
+	int handle;
+};
+
+/**
+ * @brief pqueue - Struct representing priority queue data structure
+ *
+ * cmp:		Comparator, NULL to order by key
+ * heap:	Items, each one smaller than its ARITY children
+ * length:	Number of items in @heap
+ * size:	Number of slots of @heap and @positions
+ * positions:	Index in @heap of the item of each handle, -1 for free handles
+ * freeHandles:	Stack of free handles, the top one at @numFree - 1
+ * numFree:	Number of free handles
+ * numHandles:	Number of handles handed out at least once
+ */
+struct pqueue {
+	pqueue_cmp_func_t cmp;
+	struct pqueue_entry* heap;
+	int length;
+	int size;
+	int* positions;
+	int* freeHandles;
+	int numFree;
+	int numHandles;
+};
+
+pqueue_t pqueue_create(pqueue_cmp_func_t cmp)
+{
+	pqueue_t pqueue = malloc(sizeof(struct pqueue));
+
+	if (pqueue == NULL) {
+		return NULL;
+	}
+
+	pqueue->heap = malloc(PQUEUE_INITIAL_SIZE * sizeof(struct pqueue_entry));
+	pqueue->positions = malloc(PQUEUE_INITIAL_SIZE * sizeof(int));
+	pqueue->freeHandles = malloc(PQUEUE_INITIAL_SIZE * sizeof(int));
+
+	if (pqueue->heap == NULL || pqueue->positions == NULL ||
+	    pqueue->freeHandles == NULL) {
+		free(pqueue->heap);
+		free(pqueue->positions);
+		free(pqueue->freeHandles);
+		free(pqueue);
+		return NULL;
+	}
+
+	pqueue->cmp = cmp;
+	pqueue->length = 0;
+	pqueue->size = PQUEUE_INITIAL_SIZE;
+	pqueue->numFree = 0;
+	pqueue->numHandles = 0;
+
+	return pqueue;
+}
+
+int pqueue_destroy(pqueue_t pqueue)
+{
+	if (pqueue == NULL || pqueue->length != 0) {
+		return -1;
+	}
+
+	free(pqueue->heap);
+	free(pqueue->positions);
+	free(pqueue->freeHandles);
+	free(pqueue);
+
+	return 0;
+}
+
+/*
+ * before - Whether entry @a must be handed out before entry @b
+ */
+static inline int before(pqueue_t pqueue, const struct pqueue_entry* a,
+			 const struct pqueue_entry* b)
+{
+	if (pqueue->cmp != NULL) {
+		return pqueue->cmp(a->data, b->data) < 0;
+	}
+
+	return a->key < b->key;
+}
+
+/*
+ * place - Store @entry in slot @index of the heap
+ */
+static inline void place(pqueue_t pqueue, int index,
+			 const struct pqueue_entry* entry)
+{
+	pqueue->heap[index] = *entry;
+	pqueue->positions[entry->handle] = index;
+}
+
+/*
+ * siftUp - Move the entry at @index up until its parent is not larger
+ *
+ * Return: Final index of the entry.
+ */
+static int siftUp(pqueue_t pqueue, int index)
+{
+	struct pqueue_entry entry = pqueue->heap[index];
+
+	while (index > 0) {
+		int parent = (index - 1) / ARITY;
+
+		if (!before(pqueue, &entry, &pqueue->heap[parent])) {
+			break;
+		}
+
+		place(pqueue, index, &pqueue->heap[parent]);
+		index = parent;
+	}
+
+	place(pqueue, index, &entry);
+	return index;
+}
+
+/*
+ * siftDown - Move the entry at @index down until no child is smaller
+ */
+static void siftDown(pqueue_t pqueue, int index)
+{
+	struct pqueue_entry entry = pqueue->heap[index];
+
+	for (;;) {
+		int first = index * ARITY + 1;
+
+		if (first >= pqueue->length) {
+			break;
+		}
+
+		// Smallest of the children, which sit next to each other.
+		int last = first + ARITY < pqueue->length ?
+			   first + ARITY : pqueue->length;
+		int smallest = first;
+
+		for (int child = first + 1; child < last; child++) {
+			if (before(pqueue, &pqueue->heap[child],
+				   &pqueue->heap[smallest])) {
+				smallest = child;
+			}
+		}
+
+		if (!before(pqueue, &pqueue->heap[smallest], &entry)) {
+			break;
+		}
+
+		place(pqueue, index, &pqueue->heap[smallest]);
+		index = smallest;
+	}
+
+	place(pqueue, index, &entry);
+}
+
+/*
+ * grow - Double the number of slots
+ *
+ * Return: 0 in case of success, -1 in case of memory allocation error.
+ */
+static int grow(pqueue_t pqueue)
+{
+	int size = pqueue->size * 2;
+	struct pqueue_entry* heap = realloc(pqueue->heap,
+					    size * sizeof(struct pqueue_entry));
+
+	if (heap == NULL) {
+		return -1;
+	}
+	pqueue->heap = heap;
+
+	int* positions = realloc(pqueue->positions, size * sizeof(int));
+
+	if (positions == NULL) {
+		return -1;
+	}
+	pqueue->positions = positions;
+
+	int* freeHandles = realloc(pqueue->freeHandles, size * sizeof(int));
+
+	if (freeHandles == NULL) {
+		return -1;
+	}
+	pqueue->freeHandles = freeHandles;
+
+	pqueue->size = size;
+	return 0;
+}
+
+/*
+ * validHandle - Whether @handle refers to an item of @pqueue
+ */
+static int validHandle(pqueue_t pqueue, int handle)
+{
+	return handle >= 0 && handle < pqueue->numHandles &&
+	       pqueue->positions[handle] != -1;
+}
+
+/*
+ * removeAt - Remove the entry at @index from the heap, and free its handle
+ */
+static void removeAt(pqueue_t pqueue, int index)
+{
+	int handle = pqueue->heap[index].handle;
+
+	pqueue->positions[handle] = -1;
+	pqueue->freeHandles[pqueue->numFree++] = handle;
+	pqueue->length--;
+
+	if (index == pqueue->length) {
+		return;
+	}
+
+	// The last entry fills the hole, then moves whichever way it has to.
+	place(pqueue, index, &pqueue->heap[pqueue->length]);
+	if (siftUp(pqueue, index) == index) {
+		siftDown(pqueue, index);
+	}
+}
+
+int pqueue_push(pqueue_t pqueue, long long key, void *data)
+{
+	if (pqueue == NULL || data == NULL) {
+		return -1;
+	}
+
+	// There are as many handles as slots, so a full heap has no free handle.
+	if (pqueue->length == pqueue->size && grow(pqueue) == -1) {
+		return -1;
+	}
+
+	int handle = pqueue->numFree > 0 ?
+		     pqueue->freeHandles[--pqueue->numFree] :
+		     pqueue->numHandles++;
+	struct pqueue_entry entry = { .key = key, .data = data,
+				      .handle = handle };
+
+	place(pqueue, pqueue->length++, &entry);
+	siftUp(pqueue, pqueue->length - 1);
+
+	return handle;
+}
+
+int pqueue_pop(pqueue_t pqueue, void **data)
+{
+	if (pqueue == NULL || data == NULL || pqueue->length == 0) {
+		return -1;
+	}
+
+	*data = pqueue->heap[0].data;
+	removeAt(pqueue, 0);
+
+	return 0;
+}
+
+int pqueue_peek(pqueue_t pqueue, void **data, long long *key)
+{
+	if (pqueue == NULL || data == NULL || pqueue->length == 0) {
+		return -1;
+	}
+
+	*data = pqueue->heap[0].data;
+	if (key != NULL) {
+		*key = pqueue->heap[0].key;
+	}
+
+	return 0;
+}
+
+int pqueue_update(pqueue_t pqueue, int handle, long long key)
+{
+	if (pqueue == NULL || !validHandle(pqueue, handle)) {
+		return -1;
+	}
+
+	int index = pqueue->positions[handle];
+
+	pqueue->heap[index].key = key;
+	if (siftUp(pqueue, index) == index) {
+		siftDown(pqueue, index);
+	}
+
+	return 0;
+}
+
+int pqueue_remove(pqueue_t pqueue, int handle)
+{
+	if (pqueue == NULL || !validHandle(pqueue, handle)) {
+		return -1;
+	}
+
+	removeAt(pqueue, pqueue->positions[handle]);
+	return 0;
+}
+
+int pqueue_length(pqueue_t pqueue)
+{
+	if (pqueue == NULL) {
+		return -1;
+	}
+
+	return pqueue->length;
+}
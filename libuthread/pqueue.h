@@ -0,0 +1,114 @@
+#ifndef _PQUEUE_H
+#define _PQUEUE_H
+
+/*
+ * pqueue_t - Priority queue type
+ *
+ * A priority queue hands data items out smallest first, either by an integer
+ * key given with each item or by a user comparator. Items are kept in a 4-ary
+ * heap stored in a single array, so that the children of a node share one or
+ * two cache lines.
+ *
+ * Each item pushed gets a handle, which stays valid until the item is popped
+ * or removed, and lets its key be changed or the item be removed without
+ * searching for it.
+ *
+ * pqueue_push(), pqueue_pop(), pqueue_update() and pqueue_remove() are
+ * O(log n), pqueue_peek() and pqueue_length() are O(1).
+ */
+typedef struct pqueue* pqueue_t;
+
+/*
+ * pqueue_cmp_func_t - Priority queue comparator type
+ * @a, @b: Data items to compare
+ *
+ * Return: A negative value if @a must be handed out before @b, a positive
+ * value if after, 0 if either way.
+ */
+typedef int (*pqueue_cmp_func_t)(const void *a, const void *b);
+
+/*
+ * pqueue_create - Allocate an empty priority queue
+ * @cmp: (Optional) Comparator ordering the items, NULL to order them by key
+ *
+ * Return: Pointer to new empty priority queue. NULL in case of failure when
+ * allocating the new priority queue.
+ */
+pqueue_t pqueue_create(pqueue_cmp_func_t cmp);
+
+/*
+ * pqueue_destroy - Deallocate a priority queue
+ * @pqueue: Priority queue to deallocate
+ *
+ * Return: -1 if @pqueue is NULL or if @pqueue is not empty. 0 if @pqueue was
+ * successfully destroyed.
+ */
+int pqueue_destroy(pqueue_t pqueue);
+
+/*
+ * pqueue_push - Insert data item
+ * @pqueue: Priority queue in which to insert item
+ * @key: Key of the item, ignored if @pqueue has a comparator
+ * @data: Address of data item to insert
+ *
+ * Return: -1 if @pqueue or @data are NULL, or in case of memory allocation
+ * error. Otherwise, the handle of the item (a non-negative integer).
+ */
+int pqueue_push(pqueue_t pqueue, long long key, void *data);
+
+/*
+ * pqueue_pop - Remove the smallest data item
+ * @pqueue: Priority queue from which to remove item
+ * @data: Address of data pointer where item is received
+ *
+ * Among equal items, which one comes first is unspecified.
+ *
+ * Return: -1 if @pqueue or @data are NULL, or if @pqueue is empty. 0 if @data
+ * was set with the smallest item.
+ */
+int pqueue_pop(pqueue_t pqueue, void **data);
+
+/*
+ * pqueue_peek - Get the smallest data item without removing it
+ * @pqueue: Priority queue to look into
+ * @data: Address of data pointer where item is received
+ * @key: (Optional) Address where the key of the item is received
+ *
+ * Return: -1 if @pqueue or @data are NULL, or if @pqueue is empty. 0
+ * otherwise.
+ */
+int pqueue_peek(pqueue_t pqueue, void **data, long long *key);
+
+/*
+ * pqueue_update - Move a data item after its key changed
+ * @pqueue: Priority queue holding the item
+ * @handle: Handle of the item, as returned by pqueue_push()
+ * @key: New key of the item, ignored if @pqueue has a comparator
+ *
+ * The key may decrease or increase. With a comparator, must be called once
+ * the item changed in a way that affects its order.
+ *
+ * Return: -1 if @pqueue is NULL or if @handle does not refer to an item of
+ * @pqueue. 0 otherwise.
+ */
+int pqueue_update(pqueue_t pqueue, int handle, long long key);
+
+/*
+ * pqueue_remove - Remove a data item
+ * @pqueue: Priority queue holding the item
+ * @handle: Handle of the item, as returned by pqueue_push()
+ *
+ * Return: -1 if @pqueue is NULL or if @handle does not refer to an item of
+ * @pqueue. 0 otherwise.
+ */
+int pqueue_remove(pqueue_t pqueue, int handle);
+
+/*
+ * pqueue_length - Priority queue length
+ * @pqueue: Priority queue to get the length of
+ *
+ * Return: -1 if @pqueue is NULL. Length of @pqueue otherwise.
+ */
+int pqueue_length(pqueue_t pqueue);
+
+#endif /* _PQUEUE_H */
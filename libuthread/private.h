@@ -10,10 +10,25 @@
 /**
  * Private context API
  */
+#include <signal.h>
+#include <stdint.h>
+#include <time.h>
 #include <ucontext.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
 #include "uthread.h"
 
+/*
+ * Scheduler statistics are maintained unless the library is built with
+ * UTHREAD_STATS=0 (see the Makefile).
+ */
+#ifndef UTHREAD_STATS
+#define UTHREAD_STATS 1
+#endif
+
 /* These are the different TCB states. */
 #define READY 0
 #define RUNNING 1
@@ -33,8 +48,49 @@
  */
 typedef ucontext_t uthread_ctx_t;
 
+/* Size of the stack for a thread (in bytes) */
+#define UTHREAD_STACK_SIZE 32768
+
+/* Hardware events counted per thread, see perf_switch() */
+#define PERF_INSTRUCTIONS 0
+#define PERF_CYCLES 1
+#define PERF_CACHE_MISSES 2
+#define PERF_BRANCH_MISSES 3
+#define PERF_COUNTERS 4
+
+/* Thread-local values held in the TCB itself, see uthread_key_create() */
+#define LOCALS_INLINE 8
+
 typedef struct _TCB TCB;
 
+/**
+ * @brief - Thread arena struct
+ * alloc_arena - Memory handed out by uthread_alloc() to a thread
+ *
+ * struct chunk* chunks - Regular chunks, the one being carved first
+ * struct chunk* last - Last regular chunk, to give them all back at once
+ * char* next - Next free byte of the chunk being carved
+ * char* end - End of the chunk being carved
+ * struct chunk* large - Allocations too large for a chunk, one chunk each
+ */
+struct alloc_arena {
+    struct chunk* chunks;
+    struct chunk* last;
+    char* next;
+    char* end;
+    struct chunk* large;
+};
+
+/**
+ * @brief - Join group struct
+ * join_group - Threads being joined together by uthread_join_all()
+ *
+ * int remaining - Number of threads of the group that have not exited yet
+ */
+struct join_group {
+    int remaining;
+};
+
 /**
  * @brief - TCB struct
  * TCB - The struct representing a Thread Control Block
@@ -45,27 +101,87 @@ typedef struct _TCB TCB;
  * 
  * uthread_t TID - Stores the TID of the thread
  * TCB* joinedToThread - Keeps track of any thread that has called join() on TCB
- * uthread_ctx_t* context - Context or state of the thread
- * void* stack - Stores the thread-specific stack
+ * struct join_group* joinGroup - Group of threads joined along with TCB, if any
+ * uthread_ctx_t* context - Context or state of the thread, NULL until first run
+ * void* stack - Stores the thread-specific stack, NULL until first run
+ * uthread_func_t func - Function executed by the thread
+ * uthread_task_func_t task - Function executed by the task, NULL for threads
+ * void* taskArg - Argument passed to the task function
  * int status - Thread status, values defined in private.h
  * int retVal - Any return value for thread upon completion
+ * uint64_t stamp - Clock value when the thread last started running or waiting
+ * struct uthread_thread_stats* stats - Run and ready times of the thread, in a
+ *	table of its scheduler readable from other kernel threads (NULL without
+ *	statistics)
+ * int weight - Share of CPU time under the fair policy, 1024 by default
+ * uint64_t vruntime - Virtual runtime under the fair policy
+ * uint64_t sliceStart - Clock value when the thread last got the CPU
+ * uint64_t readySeq - Enqueue order, breaks ties between equal vruntimes
+ * TCB* heapChild, heapSibling - Links in the fair policy's pairing heap
+ * int priority - Level the thread starts at under MLFQ, see uthread_set_priority
+ * int level - Current MLFQ level, at or below @priority
+ * uint64_t levelUsed - Nanoseconds of CPU time used at the current level
+ * unsigned boostEpoch - Last MLFQ priority boost applied to the thread
+ * uint64_t deadline - Absolute deadline in nanoseconds, 0 if none
+ * int heapIndex - Position in the EDF heap, -1 if not in it
+ * int detached - Whether the thread is destroyed on exit instead of joined
+ * TCB* nextDetached - Next dead detached thread waiting to be destroyed
+ * int parked - Whether the thread is blocked in uthread_park()
+ * int wakeToken - Wakeup received while not parked, consumed by the next park
+ * int threadClass - Class whose histograms the thread's times are recorded in
+ * uint64_t perf[] - Hardware events counted while running, see perf_switch()
+ * struct alloc_arena arena - Memory allocated with uthread_alloc()
+ * void* locals[] - Values of the first LOCALS_INLINE thread-local keys
+ * void** spilledLocals - Values of the other keys, NULL until one is set
 */
 struct _TCB 
 {
     uthread_t TID;
     TCB* joinedToThread;
+    struct join_group* joinGroup;
     uthread_ctx_t* context;
     void* stack;
+    uthread_func_t func;
+    uthread_task_func_t task;
+    void* taskArg;
     int status;
     int retVal;
+    uint64_t stamp;
+    struct uthread_thread_stats* stats;
+    int weight;
+    uint64_t vruntime;
+    uint64_t sliceStart;
+    uint64_t readySeq;
+    TCB* heapChild;
+    TCB* heapSibling;
+    int priority;
+    int level;
+    uint64_t levelUsed;
+    unsigned boostEpoch;
+    uint64_t deadline;
+    int heapIndex;
+    int detached;
+    TCB* nextDetached;
+    int parked;
+    int wakeToken;
+    int threadClass;
+    uint64_t perf[PERF_COUNTERS];
+    struct alloc_arena arena;
+    void* locals[LOCALS_INLINE];
+    void** spilledLocals;
 };
 
 
-/* Global variables accessible by all threads */
-extern int numTIDs; // Number of TIDs that have been created
-extern queue_t readyQueue; // Queue of tcb's that are "ready" to be run
-extern queue_t zombieQueue; // Queue of dead tcb's, zombies until collected
-extern TCB* currentThread; // Currently running thread.
+/*
+ * Scheduler state accessible by all threads. Each kernel thread running a
+ * scheduler has its own copy, see uthread_start_sharded().
+ */
+extern __thread int numTIDs; // Number of TIDs handed out before any is reused
+extern __thread queue_t readyQueue; // Queue of tcb's that are "ready" to be run
+extern __thread queue_t zombieQueue; // Queue of dead tcb's, zombies until collected
+extern __thread TCB* currentThread; // Currently running thread.
+extern __thread TCB** threadTable; // Live tcb's indexed by TID, NULL once destroyed
+extern __thread int numParked; // Number of threads blocked in uthread_park()
 
 /*
  * newTCB - Create a new TCB struct
@@ -80,6 +196,468 @@ TCB* newTCB(int TID);
  */
 void destroyTCB(TCB* tcb);
 
+/*
+ * uthread_clock - Read the scheduler clock
+ *
+ * Return: The time stamp counter where available, the monotonic clock in
+ * nanoseconds otherwise.
+ */
+static inline uint64_t uthread_clock(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+
+/**
+ * Private statistics API
+ */
+
+#if UTHREAD_STATS
+
+/* Counters of the scheduler running on the calling kernel thread */
+extern __thread struct uthread_stats* schedStats;
+
+/*
+ * STATS_ADD - Add @n to counter @field
+ *
+ * Each scheduler is the single writer of its counters, so a relaxed load and
+ * store suffice and let uthread_stats_snapshot() read the counters from any
+ * kernel thread.
+ */
+#define STATS_ADD(field, n) \
+    __atomic_store_n(&schedStats->field, schedStats->field + (n), __ATOMIC_RELAXED)
+
+/*
+ * STATS_THREAD_ADD - Add @n to per-thread counter @field of @tcb
+ *
+ * Single writer as well, read by uthread_stats_shard_thread().
+ */
+#define STATS_THREAD_ADD(tcb, field, n) \
+    __atomic_store_n(&(tcb)->stats->field, (tcb)->stats->field + (n), \
+                     __ATOMIC_RELAXED)
+
+/* STATS_WAIT_START - @tcb starts waiting (ready or blocked) */
+#define STATS_WAIT_START(tcb) ((tcb)->stamp = uthread_clock())
+
+/*
+ * stats_hist_add - Record @ticks in histogram @hist of class @threadClass
+ * @hist: UTHREAD_HIST_DELAY or UTHREAD_HIST_RUN
+ */
+void stats_hist_add(int hist, int threadClass, uint64_t ticks);
+
+/* STATS_RUN_END - @tcb, currently running, enters the scheduler */
+#define STATS_RUN_END(tcb) do {                                     \
+    uint64_t _now = uthread_clock();                                \
+    STATS_THREAD_ADD(tcb, runTicks, _now - (tcb)->stamp);           \
+    stats_hist_add(UTHREAD_HIST_RUN, (tcb)->threadClass,            \
+                   _now - (tcb)->stamp);                            \
+    (tcb)->stamp = _now;                                            \
+} while (0)
+
+/* STATS_DISPATCH - @tcb, which was ready, starts running */
+#define STATS_DISPATCH(tcb) do {                                    \
+    uint64_t _now = uthread_clock();                                \
+    STATS_THREAD_ADD(tcb, readyTicks, _now - (tcb)->stamp);         \
+    stats_hist_add(UTHREAD_HIST_DELAY, (tcb)->threadClass,          \
+                   _now - (tcb)->stamp);                            \
+    (tcb)->stamp = _now;                                            \
+    STATS_THREAD_ADD(tcb, dispatches, 1);                           \
+} while (0)
+
+#else
+
+#define STATS_ADD(field, n) do { } while (0)
+#define STATS_WAIT_START(tcb) do { } while (0)
+#define STATS_RUN_END(tcb) do { } while (0)
+#define STATS_DISPATCH(tcb) do { } while (0)
+
+#endif /* UTHREAD_STATS */
+
+/**
+ * Private thread arena API
+ */
+
+/*
+ * alloc_release - Release the arena of thread @tcb
+ *
+ * Regular chunks are spliced onto the free list of the calling scheduler in
+ * constant time, large allocations are freed.
+ */
+void alloc_release(TCB* tcb);
+
+/*
+ * alloc_stop - Free the chunks kept by the calling scheduler
+ */
+void alloc_stop(void);
+
+/**
+ * Private thread-local storage API
+ */
+
+/*
+ * locals_exit - Run the destructors of the thread-local values of @tcb
+ *
+ * Called by the exiting thread itself, before it is marked dead.
+ */
+void locals_exit(TCB* tcb);
+
+/*
+ * locals_release - Free the thread-local storage of @tcb
+ */
+void locals_release(TCB* tcb);
+
+/**
+ * Private performance counters API
+ */
+
+/*
+ * perf_start - Open the performance counters of the calling scheduler
+ *
+ * Does nothing unless enabled with uthread_perf_counters(). Falls back on
+ * counting cycles with the scheduler clock if hardware counters cannot be
+ * opened.
+ */
+void perf_start(void);
+
+/*
+ * perf_switch - Charge the events counted since the last switch to @tcb
+ * @tcb: Thread that was running, about to enter the scheduler
+ */
+void perf_switch(TCB* tcb);
+
+/*
+ * perf_stop - Close the performance counters of the calling scheduler
+ */
+void perf_stop(void);
+
+/*
+ * stats_start - Reset the statistics of a scheduler
+ * @shard: Index of the scheduler's shard, 0 when not sharded
+ *
+ * The first shard, which starts before any other, resets the statistics left
+ * by the shards of a previous run too, and takes a reference point for the
+ * clock. The latency histograms of a shard are allocated when it first starts.
+ *
+ * Return: 0 in case of success, -1 in case of memory allocation error.
+ */
+int stats_start(int shard);
+
+/*
+ * stats_thread_start - Give thread @tcb its entry in the per-thread table
+ *
+ * The table of each scheduler is indexed by TID, and grows by chunks which are
+ * kept until the process exits, so that other kernel threads can read them at
+ * any time. TIDs are not reused before the scheduler is restarted.
+ *
+ * Return: 0 in case of success, -1 in case of memory allocation error.
+ */
+int stats_thread_start(TCB* tcb);
+
+/**
+ * Private scheduling policy API
+ */
+
+/*
+ * sched_start - Select the scheduling policy and reset its state
+ * @policy: One of the UTHREAD_SCHED_* policies
+ *
+ * Return: -1 if @policy is unknown or in case of failure (memory allocation),
+ * 0 otherwise.
+ */
+int sched_start(int policy);
+
+/*
+ * sched_stop - Release the state of the policy, the ready set must be empty
+ */
+void sched_stop(void);
+
+/*
+ * sched_enqueue - Add a READY thread to the ready set
+ */
+void sched_enqueue(TCB* tcb);
+
+/*
+ * sched_enqueue_all - Add a batch of READY threads to the ready set
+ * @threads: Queue of the threads, in the order they should be added, left
+ * empty
+ */
+void sched_enqueue_all(queue_t threads);
+
+/*
+ * sched_dequeue - Remove the next thread to run from the ready set
+ *
+ * Return: The next thread to run, NULL if no thread is ready.
+ */
+TCB* sched_dequeue(void);
+
+/*
+ * sched_length - Number of threads in the ready set
+ */
+int sched_length(void);
+
+/*
+ * sched_exit - Thread @tcb is done
+ *
+ * Its deadline, if any, counts as missed if it has already passed.
+ */
+void sched_exit(TCB* tcb);
+
+/*
+ * sched_run_start - Thread @tcb starts running
+ */
+void sched_run_start(TCB* tcb);
+
+/*
+ * sched_run_end - Thread @tcb, currently running, enters the scheduler
+ *
+ * Charges the CPU time used since sched_run_start() (or the previous call)
+ * to @tcb.
+ */
+void sched_run_end(TCB* tcb);
+
+/*
+ * uthread_block - Block the currently running thread
+ *
+ * Mark the currently running thread as BLOCKED and switch to the next ready
+ * thread, without putting the current thread back into the ready queue. If no
+ * thread is ready but blocking calls are still in flight, wait for one of them
+ * to complete.
+ *
+ * Return: 0 once another thread (or a completed blocking call) has made the
+ * thread ready again with uthread_unblock(), -1 if no thread could ever do so.
+ */
+int uthread_block(void);
+
+/*
+ * uthread_unblock - Unblock a thread
+ * @tcb: Thread previously blocked with uthread_block()
+ *
+ * Mark @tcb as READY and put it back into the ready queue.
+ */
+void uthread_unblock(TCB* tcb);
+
+/*
+ * uthread_unblock_all - Unblock a batch of threads
+ * @threads: Queue of threads previously blocked with uthread_block(), left
+ * empty
+ *
+ * Same as calling uthread_unblock() on each thread in order, but the threads
+ * join the ready queue all at once.
+ */
+void uthread_unblock_all(queue_t threads);
+
+
+/**
+ * Private blocking call API
+ */
+
+/*
+ * blocking_pending - Number of blocking calls still being run by helpers
+ */
+int blocking_pending(void);
+
+/*
+ * blocking_fd - File descriptor readable once a blocking call completed
+ *
+ * Return: -1 if the helper pool was never started, the descriptor otherwise.
+ */
+int blocking_fd(void);
+
+/*
+ * blocking_poll - Collect completed blocking calls
+ *
+ * Unblock the threads of every blocking call completed so far, without waiting
+ * for the ones still in flight.
+ */
+void blocking_poll(void);
+
+/*
+ * blocking_stop - Stop the helper pool
+ *
+ * Close the completion pipe of the calling scheduler, then terminate and join
+ * every helper pthread unless other shards are still running. Must only be
+ * called once no blocking call is pending.
+ */
+void blocking_stop(void);
+
+
+/**
+ * Private asynchronous I/O API
+ */
+
+/*
+ * uring_pending - Number of I/O requests whose completion was not reaped
+ */
+int uring_pending(void);
+
+/*
+ * uring_fd - File descriptor readable once an I/O request completed
+ *
+ * Return: -1 if the ring was never set up, the descriptor otherwise.
+ */
+int uring_fd(void);
+
+/*
+ * uring_submit - Submit every prepared I/O request to the kernel
+ *
+ * If the ring turns out to be unusable, the requests not taken fail with the
+ * errno of io_uring_enter(), and later ones go through the helper pool.
+ */
+void uring_submit(void);
+
+/*
+ * uring_dispatch - Account for a thread being dispatched
+ *
+ * Prepared requests are submitted together once every thread that was ready
+ * when the first of them was prepared got dispatched, so that all threads
+ * blocking in the same scheduling round share a single system call.
+ */
+void uring_dispatch(void);
+
+/*
+ * uring_poll - Reap completed I/O requests
+ *
+ * Unblock the threads of every I/O request completed so far, without waiting
+ * for the ones still in flight.
+ */
+void uring_poll(void);
+
+/*
+ * uring_stop - Tear down the ring
+ *
+ * Must only be called once no I/O request is pending.
+ */
+void uring_stop(void);
+
+/**
+ * Private sharding API
+ */
+
+/* Maximum number of shards, see uthread_start_sharded() */
+#define SHARD_MAX 64
+
+/*
+ * shard_count - Number of shards
+ *
+ * Return: Number of shards while sharded mode is running, 0 otherwise.
+ */
+int shard_count(void);
+
+/*
+ * shard_pending - Whether messages may still arrive from other shards
+ *
+ * Any other shard may send a message at any time, which may make any thread
+ * of the calling scheduler ready again, so a running shard always waits for
+ * one rather than reporting a deadlock.
+ *
+ * Return: 1 if the calling scheduler is a running shard, 0 otherwise.
+ */
+int shard_pending(void);
+
+/*
+ * shard_fd - File descriptor signaled when messages arrive
+ *
+ * Only valid after shard_sleep() returned 0.
+ */
+int shard_fd(void);
+
+/*
+ * shard_sleep - Announce that the scheduler is about to wait on shard_fd()
+ *
+ * Other shards only signal shard_fd() once told so.
+ *
+ * Return: -1 if messages already arrived, in which case the scheduler must not
+ * wait. 0 otherwise.
+ */
+int shard_sleep(void);
+
+/*
+ * shard_poll - Process the messages sent by other shards
+ *
+ * Submitted work is turned into detached tasks, and woken threads are made
+ * ready.
+ */
+void shard_poll(void);
+
+/**
+ * Private remote inbox API
+ */
+
+/*
+ * remote_start - Set up the inbox of uthread_wake_remote() and co.
+ *
+ * Only the first scheduler started gets the inbox, the call does nothing for
+ * the others.
+ *
+ * Return: -1 in case of failure (memory allocation, eventfd creation), 0
+ * otherwise.
+ */
+int remote_start(void);
+
+/*
+ * remote_pending - Whether messages from other kernel threads may make a
+ * thread ready
+ *
+ * Return: 1 if the calling scheduler owns the inbox and has parked threads,
+ * which only a remote wakeup may be left to unpark, or a submitted task still
+ * to create. 0 otherwise.
+ */
+int remote_pending(void);
+
+/*
+ * remote_held - Whether a submitted task waits to be created
+ *
+ * Such a task could not be created when its message was processed (USHRT_MAX
+ * threads alive, memory allocation), and is tried again by remote_poll().
+ *
+ * Return: 1 if the calling scheduler owns the inbox and holds such a task, 0
+ * otherwise.
+ */
+int remote_held(void);
+
+/*
+ * remote_fd - File descriptor signaled when messages arrive
+ *
+ * Only valid after remote_sleep() returned 0.
+ */
+int remote_fd(void);
+
+/*
+ * remote_sleep - Announce that the scheduler is about to wait on remote_fd()
+ *
+ * Return: -1 if messages already arrived, in which case the scheduler must not
+ * wait. 0 otherwise.
+ */
+int remote_sleep(void);
+
+/*
+ * remote_poll - Process the messages posted to the inbox
+ *
+ * Only the messages present on entry are processed.
+ */
+void remote_poll(void);
+
+/*
+ * remote_stop - Tear down the inbox, if owned by the calling scheduler
+ */
+void remote_stop(void);
+
+
+/**
+ * Private profiler API
+ */
+
+/*
+ * profileSwitching - Set while uthread_ctx_switch() swaps contexts, so that
+ * the profiler does not take the half-switched stack for the thread's own.
+ */
+extern __thread volatile sig_atomic_t profileSwitching;
 
 /*
  * uthread_ctx_switch - Switch between two execution contexts
@@ -116,6 +694,34 @@ int uthread_ctx_init(uthread_ctx_t *uctx, void *top_of_stack,
 					 uthread_func_t func);
 
 
+/**
+ * Private stack arena API
+ */
+
+/*
+ * arena_alloc_stack - Take a stack from the huge-page arena
+ *
+ * Return: Stack of UTHREAD_STACK_SIZE bytes, NULL if the arena is disabled or
+ * cannot grow anymore.
+ */
+void *arena_alloc_stack(void);
+
+/*
+ * arena_free_stack - Give a stack back to the arena
+ * @stack: Stack to free
+ *
+ * Return: -1 if @stack does not belong to the arena of the calling scheduler,
+ * 0 otherwise.
+ */
+int arena_free_stack(void *stack);
+
+/*
+ * arena_stop - Unmap the arena of the calling scheduler
+ *
+ * Every stack taken from the arena must have been freed, or be unused.
+ */
+void arena_stop(void);
+
 /**
  * Private preemption API
  */
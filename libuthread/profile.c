@@ -0,0 +1,294 @@
+#define _GNU_SOURCE
+#include <execinfo.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "private.h"
+#include "uthread.h"
+
+/* Number of samples kept, about 16s of CPU time at 1000Hz */
+#define PROFILE_SAMPLES 16384
+
+/* Deepest backtrace recorded, outermost frames are cut */
+#define PROFILE_DEPTH 32
+
+/* Frames of the signal handler and of the signal trampoline */
+#define PROFILE_SKIP 2
+
+/* Pseudo TIDs of samples taken outside of any thread */
+#define TID_NONE -1
+
+/**
+ * @brief sample - One tick of the profiler
+ *
+ * shard:	Shard of the kernel thread that was interrupted
+ * tid:		Thread that was running, TID_NONE for other kernel threads
+ * switching:	Whether the scheduler was switching contexts
+ * depth:	Number of frames in @pcs
+ * pcs:		Backtrace, innermost frame first
+ */
+struct sample {
+	int shard;
+	int tid;
+	int switching;
+	int depth;
+	void* pcs[PROFILE_DEPTH];
+};
+
+__thread volatile sig_atomic_t profileSwitching = 0;
+
+/* Samples, allocated by the first uthread_profile_start() and kept */
+static struct sample* samples = NULL;
+
+/* Number of samples claimed so far, may exceed PROFILE_SAMPLES */
+static atomic_uint numSamples;
+
+/* Set while the profiler runs */
+static atomic_int active;
+
+/* Number of signal handlers running, waited for before reading samples */
+static atomic_int inHandler;
+
+/* Signal disposition replaced by the profiler */
+static struct sigaction savedAction;
+
+static void onProfile(int sig)
+{
+	void* pcs[PROFILE_DEPTH + PROFILE_SKIP];
+	unsigned index;
+
+	(void)sig;
+
+	atomic_fetch_add(&inHandler, 1);
+
+	// Late tick, delivered after the profiler stopped.
+	if (!atomic_load(&active)) {
+		atomic_fetch_sub(&inHandler, 1);
+		return;
+	}
+
+	index = atomic_fetch_add_explicit(&numSamples, 1, memory_order_relaxed);
+
+	// Buffer full, only counted.
+	if (index >= PROFILE_SAMPLES) {
+		atomic_fetch_sub(&inHandler, 1);
+		return;
+	}
+
+	struct sample* s = &samples[index];
+	int depth = backtrace(pcs, PROFILE_DEPTH + PROFILE_SKIP) - PROFILE_SKIP;
+
+	s->shard = uthread_shard_self();
+	s->tid = currentThread != NULL ? currentThread->TID : TID_NONE;
+	s->switching = profileSwitching;
+	s->depth = depth > 0 ? depth : 0;
+	memcpy(s->pcs, pcs + PROFILE_SKIP, s->depth * sizeof(void*));
+
+	atomic_fetch_sub(&inHandler, 1);
+}
+
+static int compareSamples(const void* a, const void* b)
+{
+	const struct sample* x = a;
+	const struct sample* y = b;
+
+	if (x->shard != y->shard) {
+		return x->shard - y->shard;
+	}
+
+	if (x->tid != y->tid) {
+		return x->tid - y->tid;
+	}
+
+	if (x->switching != y->switching) {
+		return x->switching - y->switching;
+	}
+
+	if (x->depth != y->depth) {
+		return x->depth - y->depth;
+	}
+
+	return memcmp(x->pcs, y->pcs, x->depth * sizeof(void*));
+}
+
+/*
+ * printFrame - Print the name of a frame, as found by backtrace_symbols()
+ * @out: Output stream
+ * @symbol: "module(function+offset) [address]" or "module(+offset) [address]"
+ *
+ * Prints the function name if known, the module and offset otherwise, without
+ * the characters that delimit frames in the folded format.
+ */
+static void printFrame(FILE* out, const char* symbol)
+{
+	const char* open = strchr(symbol, '(');
+	const char* plus = open != NULL ? strchr(open, '+') : NULL;
+	const char* close = open != NULL ? strchr(open, ')') : NULL;
+
+	if (open == NULL || close == NULL) {
+		fputs("[unknown]", out);
+		return;
+	}
+
+	if (plus != NULL && plus > open + 1 && plus < close) {
+		fprintf(out, "%.*s", (int)(plus - open - 1), open + 1);
+		return;
+	}
+
+	// No symbol: keep the module name, without its directory.
+	const char* module = symbol;
+
+	for (const char* c = symbol; c < open; c++) {
+		if (*c == '/') {
+			module = c + 1;
+		}
+	}
+
+	fprintf(out, "%.*s%.*s", (int)(open - module), module,
+		(int)(close - open - 1), open + 1);
+}
+
+/*
+ * printStack - Print one line of folded output
+ * @out: Output stream
+ * @s: Sample representative of the stack
+ * @count: Number of samples with that stack
+ */
+static void printStack(FILE* out, const struct sample* s, int count)
+{
+	if (shard_count() > 0) {
+		fprintf(out, "shard_%d;", s->shard);
+	}
+
+	if (s->tid == TID_NONE) {
+		fputs("[kernel thread]", out);
+	} else {
+		fprintf(out, "uthread_%d", s->tid);
+	}
+
+	char** symbols = backtrace_symbols(s->pcs, s->depth);
+
+	// Outermost frame first.
+	for (int i = s->depth - 1; symbols != NULL && i >= 0; i--) {
+		fputc(';', out);
+		printFrame(out, symbols[i]);
+	}
+
+	if (s->switching) {
+		fputs(";[context switch]", out);
+	}
+
+	fprintf(out, " %d\n", count);
+	free(symbols);
+}
+
+int uthread_profile_start(int hz)
+{
+	struct sigaction action;
+	struct itimerval timer;
+	void* warmup[1];
+
+	if (hz <= 0 || hz > 1000000 || atomic_load(&active)) {
+		return -1;
+	}
+
+	if (samples == NULL) {
+		samples = malloc(PROFILE_SAMPLES * sizeof(struct sample));
+
+		if (samples == NULL) {
+			return -1;
+		}
+	}
+
+	atomic_store(&numSamples, 0);
+	atomic_store(&active, 1);
+
+	// The first backtrace() loads the unwinder, which must not happen in the
+	// signal handler.
+	backtrace(warmup, 1);
+
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = onProfile;
+	action.sa_flags = SA_RESTART;
+	sigemptyset(&action.sa_mask);
+
+	if (sigaction(SIGPROF, &action, &savedAction) == -1) {
+		atomic_store(&active, 0);
+		return -1;
+	}
+
+	// Below 2Hz the interval is a second or more, which tv_usec cannot hold.
+	timer.it_interval.tv_sec = 1 / hz;
+	timer.it_interval.tv_usec = 1000000 / hz % 1000000;
+	timer.it_value = timer.it_interval;
+
+	if (setitimer(ITIMER_PROF, &timer, NULL) == -1) {
+		atomic_store(&active, 0);
+		sigaction(SIGPROF, &savedAction, NULL);
+		return -1;
+	}
+
+	return 0;
+}
+
+int uthread_profile_stop(FILE *out)
+{
+	struct itimerval timer;
+	struct timespec now = { 0, 0 };
+	sigset_t profMask, oldMask;
+
+	if (!atomic_load(&active)) {
+		return -1;
+	}
+
+	memset(&timer, 0, sizeof(timer));
+	setitimer(ITIMER_PROF, &timer, NULL);
+	atomic_store(&active, 0);
+
+	// A tick may still be pending, which must not reach the disposition
+	// replaced (by default, terminating the process): consume it while the
+	// handler, which drops late ticks, is still installed.
+	sigemptyset(&profMask);
+	sigaddset(&profMask, SIGPROF);
+	pthread_sigmask(SIG_BLOCK, &profMask, &oldMask);
+
+	while (sigtimedwait(&profMask, NULL, &now) == SIGPROF) {
+		// Dropped.
+	}
+
+	// Let handlers running on other kernel threads finish their sample.
+	while (atomic_load(&inHandler) > 0) {
+		// Nothing to do.
+	}
+
+	sigaction(SIGPROF, &savedAction, NULL);
+	pthread_sigmask(SIG_SETMASK, &oldMask, NULL);
+
+	unsigned taken = atomic_load(&numSamples);
+	unsigned kept = taken < PROFILE_SAMPLES ? taken : PROFILE_SAMPLES;
+
+	// Identical stacks end up next to each other.
+	qsort(samples, kept, sizeof(struct sample), compareSamples);
+
+	for (unsigned i = 0; i < kept; ) {
+		unsigned j = i + 1;
+
+		while (j < kept && compareSamples(&samples[i], &samples[j]) == 0) {
+			j++;
+		}
+
+		printStack(out, &samples[i], j - i);
+		i = j;
+	}
+
+	if (taken > kept) {
+		fprintf(out, "[dropped] %u\n", taken - kept);
+	}
+
+	return 0;
+}
@@ -1,47 +1,74 @@
-#include <stdio.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
 #include "queue.h"
 
+/* Number of slots of the first ring, grown by doubling */
+#define QUEUE_INITIAL_SIZE 16
+
+/*
+ * Fewer slots than this are compared one at a time, see find(). Without
+ * optimizations, every SIMD intrinsic goes through memory, which takes more
+ * slots to pay off.
+ */
+#ifdef __OPTIMIZE__
+#define QUEUE_SIMD_MIN 8
+#else
+#define QUEUE_SIMD_MIN 32
+#endif
+
 /**
  * @brief queue - Struct representing queue data structure
- * 
- * queueNode front: 	Front of the queue
- * queueNode back: 		Back of the queue
- * unsigned int length:	Length of the queue 
+ *
+ * Items are kept in a ring of contiguous slots, so that looking for an item is
+ * a scan of an array, which SIMD compares go through several slots at a time.
+ *
+ * Positions are free-running counters: the item at position p lives in slot
+ * p & (size - 1), and keeps its position until it leaves the queue, even when
+ * the ring grows. This is what lets queue_iterate() carry on while items are
+ * enqueued, dequeued or deleted by its callback.
+ *
+ * void** slots:		Ring of items, NULL for items deleted while
+ *				iterating
+ * unsigned int head:		Position of the oldest slot
+ * unsigned int tail:		Position after the newest slot
+ * unsigned int size:		Number of slots, a power of 2 (0 until the first
+ *				enqueue)
+ * unsigned int length:		Number of items, not counting NULL slots
+ * unsigned int iterating:	Number of queue_iterate() calls in progress
  */
 struct queue {
-	queueNode front;
-	queueNode back;
+	void** slots;
+	unsigned int head;
+	unsigned int tail;
+	unsigned int size;
 	unsigned int length;
-} queue;
-
- /* @brief queue_node - Struct representing queue data structure
- * 
- * queueNode nextNode: 	Next node on the queue
- * void* value: 		Value stored by the queue
- */
-struct queue_node {
-	queueNode nextNode;
-	void* value;
-} queue_node;
+	unsigned int iterating;
+};
 
 queue_t queue_create(void)
 {
 	// Attempt to allocate space for a queue struct
-	queue_t queue = malloc(sizeof(queue));
-	
+	queue_t queue = malloc(sizeof(struct queue));
+
 	// Malloc failed
 	if (queue == NULL) {
 		return NULL;
 	}
 
-	// Initialize all pointers to null. Length starts at 0.
-	queue->front = NULL;
-	queue->back = NULL;
+	// No slots until the first enqueue. Length starts at 0.
+	queue->slots = NULL;
+	queue->head = 0;
+	queue->tail = 0;
+	queue->size = 0;
 	queue->length = 0;
+	queue->iterating = 0;
 
 	return queue;
 }
@@ -49,27 +76,59 @@ queue_t queue_create(void)
 /***
  * Destroy queue struct and free any allocated memory.
  * @brief Destroy queue.
- * 
+ *
  * @param queue pointer to queue struct is being destroyed.
 */
 int queue_destroy(queue_t queue)
 {
-	// If the queue is NULL or empty, return -1.
+	// If the queue is NULL or not empty, return -1.
 	if (queue == NULL) {
 		return -1;
 	}
 
-	if (queue_length(queue) == 0) {
+	if (queue->length != 0) {
 		return -1;
 	}
 
-	// Queue is empty, so simply free() pointer to struct.
+	free(queue->slots);
 	free(queue);
 	return 0;
 }
 
+/*
+ * slot - Address of the slot of position @pos
+ */
+static inline void** slot(queue_t queue, unsigned int pos)
+{
+	return &queue->slots[pos & (queue->size - 1)];
+}
+
+/*
+ * grow - Double the number of slots, keeping every item at its position
+ *
+ * Return: 0 in case of success, -1 in case of memory allocation error.
+ */
+static int grow(queue_t queue)
+{
+	unsigned int size = queue->size ? queue->size * 2 : QUEUE_INITIAL_SIZE;
+	void** slots = malloc(size * sizeof(void*));
+
+	if (slots == NULL) {
+		return -1;
+	}
+
+	for (unsigned int pos = queue->head; pos != queue->tail; pos++) {
+		slots[pos & (size - 1)] = *slot(queue, pos);
+	}
+
+	free(queue->slots);
+	queue->slots = slots;
+	queue->size = size;
+	return 0;
+}
+
 int queue_enqueue(queue_t queue, void *data)
-{	
+{
 	// If queue or data are NULL, return -1.
 	if (queue == NULL) {
 		return -1;
@@ -79,32 +138,12 @@ int queue_enqueue(queue_t queue, void *data)
 		return -1;
 	}
 
-	// Attempt to allocate space for a new node element.
-	queueNode newElement = malloc(sizeof(queueNode));
-
-	// Malloc error
-	if (newElement == NULL) {
+	// The ring is full, or was never allocated.
+	if (queue->tail - queue->head == queue->size && grow(queue) == -1) {
 		return -1;
 	}
 
-	// A freshly new element has no known next node.
-	newElement->nextNode = NULL;	
-
-	// Value stored by the node is the data to be enqueued.
-	newElement->value = data;
-
-	if (queue_length(queue) == 0) {
-		// If the node length is 0, 
-		// then the new element is both the back and front
-		queue->front = newElement;
-		queue->back = newElement;
-	} else {
-		// newElement is the new back to this queue
-		queueNode temp = queue->back;
-		temp->nextNode = newElement;
-		queue->back = newElement;
-	}
-
+	*slot(queue, queue->tail++) = data;
 	queue->length++;
 
 	return 0;
@@ -121,33 +160,246 @@ int queue_dequeue(queue_t queue, void **data)
 		return -1;
 	}
 
-	if (queue_length(queue) == 0) {
+	if (queue->length == 0) {
 		return -1;
 	}
 
-	// Store current queue->front value and save to data
-	queueNode toDequeue = queue->front;
-	*data = toDequeue->value;
+	// Skip items deleted during an iteration still in progress.
+	while (*slot(queue, queue->head) == NULL) {
+		queue->head++;
+	}
 
-	// Reassign front to the next node of the previous front node
-	queue->front = toDequeue->nextNode;
+	*data = *slot(queue, queue->head++);
+	queue->length--;
 
-	// If this was the last element in the queue, 
-	// the queue has no more back.	
-	if (queue_length(queue) == 1) {
-		queue->back = NULL;
+	return 0;
+}
+
+int queue_splice(queue_t queue, queue_t other)
+{
+	// If either queue is NULL, the same one, or other is being iterated
+	// through (it may have holes), return -1.
+	if (queue == NULL || other == NULL || queue == other) {
+		return -1;
 	}
 
-	queue->length--;
-	
-	// Free dequeued element
-	free(toDequeue);
+	if (other->iterating > 0) {
+		return -1;
+	}
+
+	unsigned int count = other->tail - other->head;
+
+	// Make room once for all the items.
+	while (queue->tail - queue->head + count > queue->size) {
+		if (grow(queue) == -1) {
+			return -1;
+		}
+	}
+
+	for (unsigned int pos = other->head; pos != other->tail; pos++) {
+		*slot(queue, queue->tail++) = *slot(other, pos);
+	}
+
+	queue->length += count;
+	other->head = other->tail;
+	other->length = 0;
 
 	return 0;
 }
 
+/*
+ * findScalar - Index of the first of @count pointers equal to @data
+ *
+ * Return: @count if there is none.
+ */
+static size_t findScalar(void* const* slots, size_t count, const void* data)
+{
+	for (size_t i = 0; i < count; i++) {
+		if (slots[i] == data) {
+			return i;
+		}
+	}
+
+	return count;
+}
+
+#if defined(__x86_64__)
+/*
+ * findSSE2 - findScalar(), comparing 4 pointers per iteration
+ *
+ * SSE2 only compares 32-bit lanes: a pointer matches if both its halves do.
+ */
+static size_t findSSE2(void* const* slots, size_t count, const void* data)
+{
+	__m128i key = _mm_set1_epi64x((long long)(uintptr_t)data);
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m128i a = _mm_cmpeq_epi32(
+			_mm_loadu_si128((const __m128i*)(slots + i)), key);
+		__m128i b = _mm_cmpeq_epi32(
+			_mm_loadu_si128((const __m128i*)(slots + i + 2)), key);
+
+		a = _mm_and_si128(a, _mm_shuffle_epi32(a, _MM_SHUFFLE(2, 3, 0, 1)));
+		b = _mm_and_si128(b, _mm_shuffle_epi32(b, _MM_SHUFFLE(2, 3, 0, 1)));
+
+		int mask = _mm_movemask_pd(_mm_castsi128_pd(a)) |
+			   _mm_movemask_pd(_mm_castsi128_pd(b)) << 2;
+
+		if (mask != 0) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+
+	return i + findScalar(slots + i, count - i, data);
+}
+
+/*
+ * findAVX2 - findScalar(), comparing 8 pointers per iteration
+ *
+ * Compiled for AVX2 whatever the flags of the library, and only called once
+ * the CPU was found to support it.
+ */
+__attribute__((target("avx2")))
+static size_t findAVX2(void* const* slots, size_t count, const void* data)
+{
+	__m256i key = _mm256_set1_epi64x((long long)(uintptr_t)data);
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m256i a = _mm256_cmpeq_epi64(
+			_mm256_loadu_si256((const __m256i*)(slots + i)), key);
+		__m256i b = _mm256_cmpeq_epi64(
+			_mm256_loadu_si256((const __m256i*)(slots + i + 4)), key);
+
+		int mask = _mm256_movemask_pd(_mm256_castsi256_pd(a)) |
+			   _mm256_movemask_pd(_mm256_castsi256_pd(b)) << 4;
+
+		if (mask != 0) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+
+	return i + findScalar(slots + i, count - i, data);
+}
+#endif
+
+/*
+ * findIn - Index of the first of @count contiguous slots equal to @data
+ *
+ * Return: @count if there is none.
+ */
+static size_t findIn(void* const* slots, size_t count, const void* data)
+{
+	if (count < QUEUE_SIMD_MIN) {
+		return findScalar(slots, count, data);
+	}
+
+#if defined(__x86_64__)
+	if (__builtin_cpu_supports("avx2")) {
+		return findAVX2(slots, count, data);
+	}
+
+	return findSSE2(slots, count, data);
+#else
+	return findScalar(slots, count, data);
+#endif
+}
+
+/*
+ * find - Position of the oldest item equal to @data
+ *
+ * The items from the head to the end of the ring are searched first, then the
+ * ones that wrapped around to its start.
+ *
+ * Return: The tail position if @data is not in @queue.
+ */
+static unsigned int find(queue_t queue, const void* data)
+{
+	unsigned int count = queue->tail - queue->head;
+
+	// A few slots are compared right here, which saves the calls of
+	// findIn() when the library is built without optimizations.
+	if (count < QUEUE_SIMD_MIN) {
+		void** slots = queue->slots;
+		unsigned int mask = queue->size - 1;
+		unsigned int pos = queue->head;
+
+		while (pos != queue->tail && slots[pos & mask] != data) {
+			pos++;
+		}
+
+		return pos;
+	}
+
+	unsigned int first = queue->head & (queue->size - 1);
+	unsigned int before = queue->size - first < count ?
+			      queue->size - first : count;
+	size_t index = findIn(queue->slots + first, before, data);
+
+	if (index == before && before < count) {
+		index = before + findIn(queue->slots, count - before, data);
+	}
+
+	return queue->head + index;
+}
+
+int queue_find(queue_t queue, void *data)
+{
+	// If the queue or data are NULL, return -1.
+	if (queue == NULL) {
+		return -1;
+	}
+
+	if (data == NULL) {
+		return -1;
+	}
+
+	return find(queue, data) != queue->tail ? 0 : -1;
+}
+
+/*
+ * shift - Move the @count items from position @from by @by positions
+ *
+ * @by is 1 or -1. The items are moved in at most three runs, split where
+ * either the items or their destination wrap around the ring, starting from
+ * the side that moves into the free slot.
+ */
+static void shift(queue_t queue, unsigned int from, unsigned int count, int by)
+{
+	unsigned int mask = queue->size - 1;
+
+	while (count > 0) {
+		unsigned int src, dst, run;
+
+		if (by > 0) {
+			// Last run: up to where the items or the destination
+			// start over at the beginning of the ring.
+			unsigned int last = from + count - 1;
+
+			src = last & mask;
+			dst = (last + by) & mask;
+			run = (src < dst ? src : dst) + 1;
+			run = run < count ? run : count;
+			src -= run - 1;
+			dst -= run - 1;
+		} else {
+			// First run: up to the end of the ring.
+			src = from & mask;
+			dst = (from + by) & mask;
+			run = queue->size - (src > dst ? src : dst);
+			run = run < count ? run : count;
+			from += run;
+		}
+
+		memmove(queue->slots + dst, queue->slots + src,
+			run * sizeof(void*));
+		count -= run;
+	}
+}
+
 int queue_delete(queue_t queue, void *data)
-{		
+{
 	// If the queue or data are NULL, return -1.
 	if (queue == NULL) {
 		return -1;
@@ -157,71 +409,103 @@ int queue_delete(queue_t queue, void *data)
 		return -1;
 	}
 
-	// Loop through queue, from front->->back.
-	queueNode node = queue->front;
-	queueNode prevNode = NULL;
-	while (node != NULL) {
-		// If there is a match
-		if (node->value == data) {
-			if (node->nextNode != NULL) {
-				// If there is a node after the found node, 
-				// it must be re-linked to the queue upon
-				// removal of the matching node
-				if (prevNode != NULL) {
-					prevNode->nextNode = node->nextNode;
-				} else {
-					queue->front = node->nextNode;
-				}
-			} else {
-				// If there is a node before the found node,
-				// it must be re-linked to the rest of the 
-				// queue upon removal of the matching node
-				if (prevNode != NULL) {
-					prevNode->nextNode = NULL;
-					queue->back = prevNode;
-				} else {
-					queue->back = NULL;
-					queue->front = NULL;
-				}
-			}
-			free(node);
-			return 0;
+	if (queue->length == 0) {
+		return -1;
+	}
+
+	// The oldest item is often the one deleted, it needs no search.
+	unsigned int pos = *slot(queue, queue->head) == data ? queue->head :
+			   find(queue, data);
+
+	if (pos == queue->tail) {
+		return -1;
+	}
+
+	queue->length--;
+
+	// Leave a hole, so that no item moves under queue_iterate().
+	if (queue->iterating > 0) {
+		*slot(queue, pos) = NULL;
+		return 0;
+	}
+
+	// Close the gap by moving whichever side has fewer items, if any.
+	if (pos == queue->head) {
+		queue->head++;
+	} else if (pos == queue->tail - 1) {
+		queue->tail--;
+	} else if (pos - queue->head < queue->tail - pos) {
+		shift(queue, queue->head, pos - queue->head, 1);
+		queue->head++;
+	} else {
+		shift(queue, pos + 1, queue->tail - pos - 1, -1);
+		queue->tail--;
+	}
+
+	return 0;
+}
+
+/*
+ * compact - Remove the holes left by deletions during an iteration
+ */
+static void compact(queue_t queue)
+{
+	unsigned int to = queue->head;
+
+	for (unsigned int pos = queue->head; pos != queue->tail; pos++) {
+		void* data = *slot(queue, pos);
+
+		if (data != NULL) {
+			*slot(queue, to++) = data;
 		}
-		// Iterate
-		prevNode = node;
-		node = node->nextNode;
 	}
 
-	return -1;
+	queue->tail = to;
 }
 
 int queue_iterate(queue_t queue, queue_func_t func, void *arg, void **data)
 {
-	// If queue or data are NULL, return -1
+	// If queue or func are NULL, return -1. data is optional.
 	if (queue == NULL) {
 		return -1;
 	}
 
-	if (data == NULL) {
+	if (func == NULL) {
 		return -1;
 	}
 
-	// Loop through node from front->->back
-	queueNode node = queue->front;
+	queue->iterating++;
 
-	while (node != NULL) {
-		// Attempt to run the function and collect the return value.
-		int returnSignal = func(queue, node->value, arg);
+	// Loop through positions from front->->back. They stay put while func
+	// enqueues or deletes items, and dequeues move the head past them.
+	for (unsigned int pos = queue->head; pos != queue->tail; pos++) {
+		if ((int)(pos - queue->head) < 0) {
+			pos = queue->head;
 
-		// If the function returns one, the loop stops, 
-		// and the struct element's pertinent value is stored
-		if (returnSignal == 1) {
-			*data = node->value;
-			return 0;
+			if (pos == queue->tail) {
+				break;
+			}
 		}
 
-		// Iterate
-		node = node->nextNode;
+		void* item = *slot(queue, pos);
+
+		// Deleted earlier in this iteration.
+		if (item == NULL) {
+			continue;
+		}
+
+		// If the function returns one, the loop stops,
+		// and the pertinent value is stored
+		if (func(queue, item, arg) == 1) {
+			if (data != NULL) {
+				*data = item;
+			}
+			break;
+		}
+	}
+
+	if (--queue->iterating == 0 && queue->tail - queue->head != queue->length) {
+		compact(queue);
 	}
 
 	return 0;
@@ -236,4 +520,3 @@ int queue_length(queue_t queue)
 	// Return the length property of the queue struct
 	return queue->length;
 }
-
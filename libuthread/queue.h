@@ -8,19 +8,11 @@
  * other.  When dequeueing, the queue must returned the oldest enqueued item
  * first and so on.
  *
- * Apart from delete and iterate operations, all operations should be O(1).
+ * Apart from delete, find and iterate operations, all operations should be
+ * O(1). Items are stored contiguously, and searched for several at a time.
  */
 typedef struct queue* queue_t;
 
-/*
- * queue_t - Queue Node type
- *
- * A queue node is an opaque data structure storing individual nodes on the queue. 
- * Nodes provide access to values on the queue as well as the the next node
- * in the queue, if any.
- */
-typedef struct queue_node* queueNode;
-
 /*
  * queue_create - Allocate an empty queue
  *
@@ -67,6 +59,21 @@ int queue_enqueue(queue_t queue, void *data);
  */
 int queue_dequeue(queue_t queue, void **data);
 
+/*
+ * queue_splice - Move all the items of a queue to the back of another
+ * @queue: Queue receiving the items
+ * @other: Queue whose items are moved, left empty
+ *
+ * The items of @other keep their order, after the items already in @queue.
+ * Room is made once for all of them, which is cheaper than dequeueing and
+ * enqueueing them one at a time.
+ *
+ * Return: -1 if @queue or @other are NULL or the same queue, if @other is
+ * being iterated through, or in case of memory allocation error (in which
+ * case both queues are left unchanged). 0 if the items were moved.
+ */
+int queue_splice(queue_t queue, queue_t other);
+
 /*
  * queue_delete - Delete data item
  * @queue: Queue in which to delete item
@@ -80,6 +87,19 @@ int queue_dequeue(queue_t queue, void **data);
  */
 int queue_delete(queue_t queue, void *data);
 
+/*
+ * queue_find - Find data item
+ * @queue: Queue in which to find item
+ * @data: Data to find
+ *
+ * Find in queue @queue an item equal to @data, comparing pointers directly
+ * rather than through a callback as queue_iterate() does.
+ *
+ * Return: -1 if @queue or @data are NULL, or if @data was not found in the
+ * queue. 0 if @data was found in @queue.
+ */
+int queue_find(queue_t queue, void *data);
+
 /*
  * queue_func_t - Queue callback function type
  * @queue: Queue to which item belongs
@@ -0,0 +1,181 @@
+#ifndef _QUEUE_TYPED_H
+#define _QUEUE_TYPED_H
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * QUEUE_DEFINE - Define a queue of items of type @T, named @name
+ *
+ * Unlike queue_t, which holds pointers to data allocated elsewhere, the
+ * queue defined here holds the items themselves, by value, in a ring of
+ * contiguous slots. Enqueueing a small record costs no allocation and
+ * dequeueing it no pointer chase. The ring doubles when full.
+ *
+ * QUEUE_DEFINE(name, T) defines type name_t and the following functions, all
+ * static inline, with the semantics of their queue_t counterparts:
+ *
+ *	void name_init(name_t *queue);
+ *	int name_destroy(name_t *queue);
+ *	int name_enqueue(name_t *queue, T item);
+ *	int name_dequeue(name_t *queue, T *item);
+ *	int name_peek(name_t *queue, T *item);
+ *	int name_length(name_t *queue);
+ *
+ * name_t is usually embedded in another structure, or a local variable, and
+ * set up with name_init(): there is no allocation until the first enqueue.
+ * name_destroy() frees the ring, and fails if the queue is not empty.
+ * name_enqueue() fails only in case of memory allocation error.
+ * name_dequeue() and name_peek() fail if the queue is empty.
+ */
+#define QUEUE_DEFINE(name, T)						\
+typedef struct name {							\
+	T* items;							\
+	unsigned int head;						\
+	unsigned int tail;						\
+	unsigned int size;						\
+} name##_t;								\
+									\
+static inline void name##_init(name##_t *queue)				\
+{									\
+	queue->items = NULL;						\
+	queue->head = 0;						\
+	queue->tail = 0;						\
+	queue->size = 0;						\
+}									\
+									\
+static inline int name##_destroy(name##_t *queue)			\
+{									\
+	if (queue->tail != queue->head) {				\
+		return -1;						\
+	}								\
+									\
+	free(queue->items);						\
+	name##_init(queue);						\
+	return 0;							\
+}									\
+									\
+static inline unsigned int name##_mask(const name##_t *queue)		\
+{									\
+	return queue->size - 1;						\
+}									\
+									\
+/* Double the ring, moving the items to the front of the new one */	\
+static inline int name##_grow(name##_t *queue)				\
+{									\
+	unsigned int size = queue->size ? queue->size * 2 : 16;		\
+	unsigned int length = queue->tail - queue->head;		\
+	unsigned int first = queue->head & name##_mask(queue);		\
+	T* items = malloc(size * sizeof(T));				\
+									\
+	if (items == NULL) {						\
+		return -1;						\
+	}								\
+									\
+	if (length > 0) {						\
+		unsigned int part = queue->size - first;		\
+									\
+		if (part > length) {					\
+			part = length;					\
+		}							\
+		memcpy(items, queue->items + first, part * sizeof(T));	\
+		memcpy(items + part, queue->items,			\
+		       (length - part) * sizeof(T));			\
+	}								\
+									\
+	free(queue->items);						\
+	queue->items = items;						\
+	queue->head = 0;						\
+	queue->tail = length;						\
+	queue->size = size;						\
+	return 0;							\
+}									\
+									\
+static inline int name##_enqueue(name##_t *queue, T item)		\
+{									\
+	if (queue->tail - queue->head == queue->size &&			\
+	    name##_grow(queue) == -1) {					\
+		return -1;						\
+	}								\
+									\
+	queue->items[queue->tail++ & name##_mask(queue)] = item;	\
+	return 0;							\
+}									\
+									\
+_QUEUE_DEFINE_COMMON(name, T)
+
+/*
+ * QUEUE_DEFINE_FIXED - Define a bounded queue of items of type @T, named @name
+ *
+ * Same as QUEUE_DEFINE(), except that the ring has room for @capacity items,
+ * a power of 2 known at compile time, and is stored in name_t itself. There is
+ * never any allocation: name_enqueue() fails if the queue is full, and
+ * name_destroy() only checks that the queue is empty.
+ */
+#define QUEUE_DEFINE_FIXED(name, T, capacity)				\
+_Static_assert((capacity) > 0 && ((capacity) & ((capacity) - 1)) == 0,	\
+	       #name ": capacity must be a power of 2");		\
+									\
+typedef struct name {							\
+	unsigned int head;						\
+	unsigned int tail;						\
+	T items[capacity];						\
+} name##_t;								\
+									\
+static inline void name##_init(name##_t *queue)				\
+{									\
+	queue->head = 0;						\
+	queue->tail = 0;						\
+}									\
+									\
+static inline int name##_destroy(name##_t *queue)			\
+{									\
+	return queue->tail != queue->head ? -1 : 0;			\
+}									\
+									\
+static inline unsigned int name##_mask(const name##_t *queue)		\
+{									\
+	(void)queue;							\
+	return (capacity) - 1;						\
+}									\
+									\
+static inline int name##_enqueue(name##_t *queue, T item)		\
+{									\
+	if (queue->tail - queue->head == (capacity)) {			\
+		return -1;						\
+	}								\
+									\
+	queue->items[queue->tail++ & name##_mask(queue)] = item;	\
+	return 0;							\
+}									\
+									\
+_QUEUE_DEFINE_COMMON(name, T)
+
+/* Operations that only depend on the indices and name_mask() */
+#define _QUEUE_DEFINE_COMMON(name, T)					\
+static inline int name##_dequeue(name##_t *queue, T *item)		\
+{									\
+	if (queue->tail == queue->head) {				\
+		return -1;						\
+	}								\
+									\
+	*item = queue->items[queue->head++ & name##_mask(queue)];	\
+	return 0;							\
+}									\
+									\
+static inline int name##_peek(name##_t *queue, T *item)		\
+{									\
+	if (queue->tail == queue->head) {				\
+		return -1;						\
+	}								\
+									\
+	*item = queue->items[queue->head & name##_mask(queue)];	\
+	return 0;							\
+}									\
+									\
+static inline int name##_length(name##_t *queue)			\
+{									\
+	return queue->tail - queue->head;				\
+}
+
+#endif /* _QUEUE_TYPED_H */
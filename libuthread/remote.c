@@ -0,0 +1,320 @@
+#include <errno.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "mpmc_queue.h"
+#include "private.h"
+#include "uthread.h"
+
+/* Number of messages that can be in flight at once */
+#define REMOTE_SLOTS 1024
+
+/* Kinds of messages */
+#define REMOTE_SUBMIT 0
+#define REMOTE_WAKE 1
+
+/**
+ * @brief remote_msg - A request posted from outside the scheduler
+ *
+ * kind:	REMOTE_SUBMIT or REMOTE_WAKE
+ * tid:		Thread to wake up, for REMOTE_WAKE
+ * func, arg:	Task to run, for REMOTE_SUBMIT
+ */
+struct remote_msg {
+	int kind;
+	uthread_t tid;
+	uthread_task_func_t func;
+	void* arg;
+};
+
+/**
+ * @brief remote - Inbox of the scheduler for other kernel threads
+ *
+ * Senders may be signal handlers, which can neither lock nor allocate: message
+ * slots are allocated up front and handed around through two lock-free queues.
+ * A sender takes a slot from @freeSlots, fills it and posts it to @messages,
+ * and the scheduler gives it back once handled.
+ *
+ * messages:	Posted messages, in order
+ * freeSlots:	Slots not in use
+ * eventFd:	Signaled by senders when the scheduler sleeps
+ * sleeping:	Set while the scheduler waits for events
+ * held:	Message of a task that could not be created yet, only used by
+ *		the scheduler
+ * slots:	Storage of every message
+ */
+struct remote {
+	mpmc_queue_t messages;
+	mpmc_queue_t freeSlots;
+	int eventFd;
+	_Atomic int sleeping;
+	struct remote_msg* held;
+	struct remote_msg slots[REMOTE_SLOTS];
+};
+
+/* Inbox of the scheduler that owns it, NULL when there is none */
+static struct remote* _Atomic inbox = NULL;
+
+/* Number of post() calls in progress, which remote_stop() waits for */
+static atomic_int senders = 0;
+
+/* Set on the kernel thread whose scheduler owns the inbox */
+static __thread int owner = 0;
+
+static void releaseInbox(struct remote* box)
+{
+	if (box->eventFd != -1) {
+		close(box->eventFd);
+	}
+
+	mpmc_queue_destroy(box->messages);
+	mpmc_queue_destroy(box->freeSlots);
+	free(box);
+}
+
+/*
+ * post - Send a message to the scheduler owning the inbox
+ *
+ * Async-signal-safe: only lock-free queue operations and a write() to an
+ * eventfd, the latter only if the scheduler sleeps.
+ *
+ * Counted in @senders from before the inbox is loaded, so that remote_stop()
+ * cannot release an inbox that a sender still uses.
+ */
+static int post(int kind, uthread_t tid, uthread_task_func_t func, void* arg)
+{
+	atomic_fetch_add(&senders, 1);
+
+	struct remote* box = atomic_load(&inbox);
+	struct remote_msg* msg;
+
+	if (box == NULL) {
+		atomic_fetch_sub(&senders, 1);
+		return -1;
+	}
+
+	// Every slot is in flight: the scheduler is not keeping up.
+	if (mpmc_queue_dequeue(box->freeSlots, (void**)&msg) == -1) {
+		atomic_fetch_sub(&senders, 1);
+		return -1;
+	}
+
+	msg->kind = kind;
+	msg->tid = tid;
+	msg->func = func;
+	msg->arg = arg;
+
+	// Cannot fail, there are as many places as slots.
+	mpmc_queue_enqueue(box->messages, msg);
+
+	// Pairs with the fence in remote_sleep(): either the scheduler sees the
+	// message before sleeping, or we see it sleeping.
+	atomic_thread_fence(memory_order_seq_cst);
+
+	if (atomic_load_explicit(&box->sleeping, memory_order_relaxed)) {
+		int savedErrno = errno;
+		uint64_t one = 1;
+
+		while (write(box->eventFd, &one, sizeof(one)) == -1 &&
+		       errno == EINTR) {
+			// Interrupted by a signal, write again.
+		}
+
+		errno = savedErrno;
+	}
+
+	atomic_fetch_sub(&senders, 1);
+	return 0;
+}
+
+int remote_start(void)
+{
+	// Another scheduler already owns the inbox.
+	if (atomic_load(&inbox) != NULL) {
+		return 0;
+	}
+
+	struct remote* box = malloc(sizeof(struct remote));
+
+	if (box == NULL) {
+		return -1;
+	}
+
+	box->messages = mpmc_queue_create(REMOTE_SLOTS);
+	box->freeSlots = mpmc_queue_create(REMOTE_SLOTS);
+	box->eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	atomic_init(&box->sleeping, 0);
+	box->held = NULL;
+
+	if (box->messages == NULL || box->freeSlots == NULL ||
+	    box->eventFd == -1) {
+		releaseInbox(box);
+		return -1;
+	}
+
+	for (int i = 0; i < REMOTE_SLOTS; i++) {
+		mpmc_queue_enqueue(box->freeSlots, &box->slots[i]);
+	}
+
+	struct remote* none = NULL;
+
+	// Lost the race against a scheduler started concurrently.
+	if (!atomic_compare_exchange_strong(&inbox, &none, box)) {
+		releaseInbox(box);
+		return 0;
+	}
+
+	owner = 1;
+	return 0;
+}
+
+int remote_pending(void)
+{
+	return owner && (numParked > 0 ||
+			 atomic_load_explicit(&inbox, memory_order_relaxed)->held != NULL);
+}
+
+int remote_held(void)
+{
+	return owner &&
+	       atomic_load_explicit(&inbox, memory_order_relaxed)->held != NULL;
+}
+
+int remote_fd(void)
+{
+	return atomic_load_explicit(&inbox, memory_order_relaxed)->eventFd;
+}
+
+int remote_sleep(void)
+{
+	struct remote* box = atomic_load_explicit(&inbox, memory_order_relaxed);
+
+	atomic_store_explicit(&box->sleeping, 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_seq_cst);
+
+	if (box->held != NULL || mpmc_queue_length(box->messages) > 0) {
+		atomic_store_explicit(&box->sleeping, 0, memory_order_relaxed);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * handleMessage - Act on message @msg
+ *
+ * Return: -1 if @msg is a task that cannot be created yet, because USHRT_MAX
+ * threads are alive or memory ran out, 0 otherwise.
+ */
+static int handleMessage(const struct remote_msg* msg)
+{
+	if (msg->kind == REMOTE_SUBMIT) {
+		int tid = uthread_spawn_task(msg->func, msg->arg);
+
+		if (tid == -1) {
+			return -1;
+		}
+
+		uthread_detach(tid);
+	} else {
+		uthread_unpark(msg->tid);
+	}
+
+	return 0;
+}
+
+void remote_poll(void)
+{
+	if (!owner) {
+		return;
+	}
+
+	struct remote* box = atomic_load_explicit(&inbox, memory_order_relaxed);
+
+	// Woken up, or about to be: clear the signal so the next sleep blocks.
+	if (atomic_load_explicit(&box->sleeping, memory_order_relaxed)) {
+		uint64_t count;
+
+		atomic_store_explicit(&box->sleeping, 0, memory_order_relaxed);
+		while (read(box->eventFd, &count, sizeof(count)) == -1 &&
+		       errno == EINTR) {
+			// Interrupted by a signal, read again.
+		}
+	}
+
+	/*
+	 * A task that could not be created yet is tried again first: accepted
+	 * work is never dropped, and the messages behind it keep their order.
+	 * Meanwhile, its slot stays in use.
+	 */
+	if (box->held != NULL) {
+		if (handleMessage(box->held) == -1) {
+			return;
+		}
+
+		mpmc_queue_enqueue(box->freeSlots, box->held);
+		box->held = NULL;
+	}
+
+	/*
+	 * Drain the inbox in one batch per scheduling round, but only the
+	 * messages already there: senders posting faster than they are handled
+	 * cannot hold the scheduler in here.
+	 */
+	int batch = mpmc_queue_length(box->messages);
+	struct remote_msg* msg;
+
+	while (batch-- > 0 &&
+	       mpmc_queue_dequeue(box->messages, (void**)&msg) == 0) {
+		if (handleMessage(msg) == -1) {
+			box->held = msg;
+			return;
+		}
+
+		mpmc_queue_enqueue(box->freeSlots, msg);
+	}
+}
+
+void remote_stop(void)
+{
+	if (!owner) {
+		return;
+	}
+
+	struct remote* box = atomic_exchange(&inbox, NULL);
+
+	// Senders that loaded the inbox before it was withdrawn finish posting.
+	while (atomic_load(&senders) > 0) {
+		// Nothing to do.
+	}
+
+	// Messages posted too late are dropped.
+	void* msg;
+	while (mpmc_queue_dequeue(box->messages, &msg) == 0) {
+		// Nothing to do.
+	}
+	while (mpmc_queue_dequeue(box->freeSlots, &msg) == 0) {
+		// Nothing to do.
+	}
+
+	releaseInbox(box);
+	owner = 0;
+}
+
+int uthread_wake_remote(uthread_t tid)
+{
+	return post(REMOTE_WAKE, tid, NULL, NULL);
+}
+
+int uthread_submit_remote(uthread_task_func_t func, void *arg)
+{
+	if (func == NULL) {
+		return -1;
+	}
+
+	return post(REMOTE_SUBMIT, 0, func, arg);
+}
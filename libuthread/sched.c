@@ -0,0 +1,630 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "private.h"
+#include "queue.h"
+#include "uthread.h"
+
+/* Weight of a thread whose weight was never changed */
+#define DEFAULT_WEIGHT 1024
+
+/* Scheduling policy selected at uthread_start_sched() */
+static __thread int policy = UTHREAD_SCHED_FIFO;
+
+/**
+ * Fair policy
+ *
+ * Ready threads are kept in a pairing heap ordered by virtual runtime: the CPU
+ * time a thread consumed, scaled down by its weight. The thread that got the
+ * least weighted CPU time so far always runs next, so a thread that yields
+ * often gets picked more often than one burning its whole turn.
+ */
+
+/* Root of the pairing heap of ready threads */
+static __thread TCB* fairRoot = NULL;
+static __thread int fairLength = 0;
+
+/* Virtual runtime of the last thread picked, never decreases */
+static __thread uint64_t minVruntime = 0;
+
+/* Enqueue counter, breaks ties between equal virtual runtimes in FIFO order */
+static __thread uint64_t enqueueSeq = 0;
+
+static int fairBefore(TCB* a, TCB* b)
+{
+	if (a->vruntime != b->vruntime) {
+		return a->vruntime < b->vruntime;
+	}
+
+	return a->readySeq < b->readySeq;
+}
+
+/*
+ * fairMeld - Meld two pairing heaps
+ *
+ * Return: Root of the resulting heap.
+ */
+static TCB* fairMeld(TCB* a, TCB* b)
+{
+	if (a == NULL) {
+		return b;
+	}
+
+	if (b == NULL) {
+		return a;
+	}
+
+	if (fairBefore(b, a)) {
+		TCB* temp = a;
+		a = b;
+		b = temp;
+	}
+
+	// The larger root becomes the first child of the smaller one.
+	b->heapSibling = a->heapChild;
+	a->heapChild = b;
+
+	return a;
+}
+
+/*
+ * fairMergePairs - Merge the children of a removed root
+ *
+ * Standard two-pass pairing: meld children in pairs from left to right, then
+ * meld the pairs together from right to left. Done iteratively, reusing the
+ * sibling links to hold the list of pairs.
+ *
+ * Return: Root of the resulting heap.
+ */
+static TCB* fairMergePairs(TCB* first)
+{
+	TCB* pairs = NULL;
+
+	while (first != NULL) {
+		TCB* a = first;
+		TCB* b = a->heapSibling;
+
+		if (b == NULL) {
+			a->heapSibling = pairs;
+			pairs = a;
+			break;
+		}
+
+		first = b->heapSibling;
+		a->heapSibling = NULL;
+		b->heapSibling = NULL;
+
+		TCB* pair = fairMeld(a, b);
+		pair->heapSibling = pairs;
+		pairs = pair;
+	}
+
+	TCB* root = NULL;
+
+	while (pairs != NULL) {
+		TCB* next = pairs->heapSibling;
+		pairs->heapSibling = NULL;
+		root = fairMeld(root, pairs);
+		pairs = next;
+	}
+
+	return root;
+}
+
+static void fairEnqueue(TCB* tcb)
+{
+	// New and woken threads start from the current minimum, so that they
+	// neither starve others nor get starved.
+	if (tcb->vruntime < minVruntime) {
+		tcb->vruntime = minVruntime;
+	}
+
+	tcb->readySeq = enqueueSeq++;
+	tcb->heapChild = NULL;
+	tcb->heapSibling = NULL;
+
+	fairRoot = fairMeld(fairRoot, tcb);
+	fairLength++;
+}
+
+static TCB* fairDequeue(void)
+{
+	TCB* min = fairRoot;
+
+	if (min == NULL) {
+		return NULL;
+	}
+
+	fairRoot = fairMergePairs(min->heapChild);
+	fairLength--;
+
+	min->heapChild = NULL;
+	minVruntime = min->vruntime > minVruntime ? min->vruntime : minVruntime;
+
+	return min;
+}
+
+/**
+ * MLFQ policy
+ *
+ * One FIFO queue per level, and a bitmap of the non-empty levels, so that the
+ * highest one is found with a single bit scan. Quanta are measured with the
+ * monotonic clock, as they are expressed in nanoseconds.
+ */
+
+#define MLFQ_LEVELS (UTHREAD_PRIO_LOWEST + 1)
+
+/* Quantum of the highest level, doubled at each level below */
+#define MLFQ_QUANTUM_NS 2000000ULL
+
+/* Period of the priority boost */
+#define MLFQ_BOOST_NS 100000000ULL
+
+static __thread queue_t levels[MLFQ_LEVELS];
+
+/* Bit @i is set when levels[@i] is not empty */
+static __thread unsigned levelMask = 0;
+static __thread int mlfqLength = 0;
+
+/* Time of the last boost, and number of boosts so far */
+static __thread uint64_t lastBoost = 0;
+static __thread unsigned boostEpoch = 0;
+
+static uint64_t clockNs(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void mlfqEnqueue(TCB* tcb)
+{
+	// A boost happened while the thread was running or blocked.
+	if (tcb->boostEpoch != boostEpoch) {
+		tcb->boostEpoch = boostEpoch;
+		tcb->level = tcb->priority;
+		tcb->levelUsed = 0;
+	}
+
+	queue_enqueue(levels[tcb->level], tcb);
+	levelMask |= 1U << tcb->level;
+	mlfqLength++;
+}
+
+static TCB* mlfqDequeue(void)
+{
+	TCB* next = NULL;
+
+	if (levelMask == 0) {
+		return NULL;
+	}
+
+	int level = __builtin_ctz(levelMask);
+
+	queue_dequeue(levels[level], (void**)&next);
+	if (queue_length(levels[level]) == 0) {
+		levelMask &= ~(1U << level);
+	}
+	mlfqLength--;
+
+	return next;
+}
+
+/*
+ * mlfqBoost - Move every thread back to its priority level
+ *
+ * Queued threads are moved right away, the others when they are queued next.
+ */
+static void mlfqBoost(void)
+{
+	boostEpoch++;
+
+	for (int level = UTHREAD_PRIO_HIGHEST + 1; level < MLFQ_LEVELS; level++) {
+		int count = queue_length(levels[level]);
+
+		for (int i = 0; i < count; i++) {
+			TCB* tcb = NULL;
+
+			queue_dequeue(levels[level], (void**)&tcb);
+			mlfqLength--;
+			mlfqEnqueue(tcb);
+		}
+
+		if (queue_length(levels[level]) == 0) {
+			levelMask &= ~(1U << level);
+		}
+	}
+}
+
+static void mlfqRunEnd(TCB* tcb)
+{
+	uint64_t now = clockNs();
+
+	tcb->levelUsed += now - tcb->sliceStart;
+	tcb->sliceStart = now;
+
+	// Quantum used up, over one or several turns: move one level down.
+	if (tcb->level < UTHREAD_PRIO_LOWEST &&
+	    tcb->levelUsed >= MLFQ_QUANTUM_NS << tcb->level) {
+		tcb->level++;
+		tcb->levelUsed = 0;
+	}
+
+	if (now - lastBoost >= MLFQ_BOOST_NS) {
+		lastBoost = now;
+		mlfqBoost();
+	}
+}
+
+/**
+ * EDF policy
+ *
+ * Ready threads with a deadline are kept in a binary min-heap ordered by
+ * deadline, each thread knowing its own position so that it can be moved when
+ * its deadline changes. Threads without a deadline wait in the FIFO ready
+ * queue, and only run once the heap is empty.
+ */
+
+#define EDF_INITIAL_CAPACITY 64
+
+static __thread TCB** edfHeap = NULL;
+static __thread int edfLength = 0;
+static __thread int edfCapacity = 0;
+
+/* Deadlines missed since the start */
+static __thread unsigned long long deadlineMisses = 0;
+
+static int edfBefore(TCB* a, TCB* b)
+{
+	if (a->deadline != b->deadline) {
+		return a->deadline < b->deadline;
+	}
+
+	return a->readySeq < b->readySeq;
+}
+
+static void edfPlace(TCB* tcb, int index)
+{
+	edfHeap[index] = tcb;
+	tcb->heapIndex = index;
+}
+
+static void edfSiftUp(int index)
+{
+	TCB* tcb = edfHeap[index];
+
+	while (index > 0) {
+		int parent = (index - 1) / 2;
+
+		if (!edfBefore(tcb, edfHeap[parent])) {
+			break;
+		}
+
+		edfPlace(edfHeap[parent], index);
+		index = parent;
+	}
+
+	edfPlace(tcb, index);
+}
+
+static void edfSiftDown(int index)
+{
+	TCB* tcb = edfHeap[index];
+
+	for (;;) {
+		int child = 2 * index + 1;
+
+		if (child >= edfLength) {
+			break;
+		}
+
+		if (child + 1 < edfLength &&
+		    edfBefore(edfHeap[child + 1], edfHeap[child])) {
+			child++;
+		}
+
+		if (!edfBefore(edfHeap[child], tcb)) {
+			break;
+		}
+
+		edfPlace(edfHeap[child], index);
+		index = child;
+	}
+
+	edfPlace(tcb, index);
+}
+
+/*
+ * edfRemove - Remove thread @tcb from wherever it is queued
+ */
+static void edfRemove(TCB* tcb)
+{
+	if (tcb->heapIndex == -1) {
+		queue_delete(readyQueue, tcb);
+		return;
+	}
+
+	int index = tcb->heapIndex;
+	TCB* last = edfHeap[--edfLength];
+
+	tcb->heapIndex = -1;
+
+	if (last != tcb) {
+		edfPlace(last, index);
+		edfSiftDown(index);
+		edfSiftUp(last->heapIndex);
+	}
+}
+
+static void edfEnqueue(TCB* tcb)
+{
+	tcb->readySeq = enqueueSeq++;
+
+	if (tcb->deadline != 0 && edfLength == edfCapacity) {
+		int capacity = edfCapacity ? 2 * edfCapacity : EDF_INITIAL_CAPACITY;
+		TCB** heap = realloc(edfHeap, capacity * sizeof(TCB*));
+
+		// Out of memory, the thread just loses its precedence.
+		if (heap != NULL) {
+			edfHeap = heap;
+			edfCapacity = capacity;
+		}
+	}
+
+	if (tcb->deadline == 0 || edfLength == edfCapacity) {
+		queue_enqueue(readyQueue, tcb);
+		return;
+	}
+
+	edfPlace(tcb, edfLength++);
+	edfSiftUp(tcb->heapIndex);
+}
+
+static TCB* edfDequeue(void)
+{
+	TCB* next = NULL;
+
+	if (edfLength == 0) {
+		queue_dequeue(readyQueue, (void**)&next);
+		return next;
+	}
+
+	next = edfHeap[0];
+	edfRemove(next);
+
+	return next;
+}
+
+/*
+ * settleDeadline - The deadline of @tcb is met or missed, now
+ */
+static void settleDeadline(TCB* tcb)
+{
+	if (tcb->deadline != 0 && clockNs() > tcb->deadline) {
+		deadlineMisses++;
+	}
+}
+
+int sched_start(int newPolicy)
+{
+	if (newPolicy != UTHREAD_SCHED_FIFO && newPolicy != UTHREAD_SCHED_FAIR &&
+	    newPolicy != UTHREAD_SCHED_MLFQ && newPolicy != UTHREAD_SCHED_EDF) {
+		return -1;
+	}
+
+	if (newPolicy == UTHREAD_SCHED_MLFQ) {
+		for (int level = 0; level < MLFQ_LEVELS; level++) {
+			levels[level] = queue_create();
+
+			if (levels[level] == NULL) {
+				while (--level >= 0) {
+					queue_destroy(levels[level]);
+					levels[level] = NULL;
+				}
+				return -1;
+			}
+		}
+	}
+
+	policy = newPolicy;
+
+	fairRoot = NULL;
+	fairLength = 0;
+	minVruntime = 0;
+	enqueueSeq = 0;
+
+	levelMask = 0;
+	mlfqLength = 0;
+	lastBoost = clockNs();
+	boostEpoch = 0;
+
+	edfLength = 0;
+	deadlineMisses = 0;
+
+	return 0;
+}
+
+void sched_stop(void)
+{
+	if (policy == UTHREAD_SCHED_MLFQ) {
+		for (int level = 0; level < MLFQ_LEVELS; level++) {
+			queue_destroy(levels[level]);
+			levels[level] = NULL;
+		}
+	}
+
+	free(edfHeap);
+	edfHeap = NULL;
+	edfCapacity = 0;
+}
+
+void sched_enqueue(TCB* tcb)
+{
+	if (policy == UTHREAD_SCHED_FAIR) {
+		fairEnqueue(tcb);
+	} else if (policy == UTHREAD_SCHED_MLFQ) {
+		mlfqEnqueue(tcb);
+	} else if (policy == UTHREAD_SCHED_EDF) {
+		edfEnqueue(tcb);
+	} else {
+		queue_enqueue(readyQueue, tcb);
+	}
+}
+
+void sched_enqueue_all(queue_t threads)
+{
+	// FIFO: one splice of the whole batch onto the ready queue.
+	if (policy == UTHREAD_SCHED_FIFO &&
+	    queue_splice(readyQueue, threads) == 0) {
+		return;
+	}
+
+	TCB* tcb = NULL;
+
+	while (queue_dequeue(threads, (void**)&tcb) == 0) {
+		sched_enqueue(tcb);
+	}
+}
+
+TCB* sched_dequeue(void)
+{
+	TCB* next = NULL;
+
+	if (policy == UTHREAD_SCHED_FAIR) {
+		return fairDequeue();
+	}
+
+	if (policy == UTHREAD_SCHED_MLFQ) {
+		return mlfqDequeue();
+	}
+
+	if (policy == UTHREAD_SCHED_EDF) {
+		return edfDequeue();
+	}
+
+	queue_dequeue(readyQueue, (void**)&next);
+	return next;
+}
+
+int sched_length(void)
+{
+	if (policy == UTHREAD_SCHED_FAIR) {
+		return fairLength;
+	}
+
+	if (policy == UTHREAD_SCHED_MLFQ) {
+		return mlfqLength;
+	}
+
+	if (policy == UTHREAD_SCHED_EDF) {
+		return edfLength + queue_length(readyQueue);
+	}
+
+	return queue_length(readyQueue);
+}
+
+void sched_exit(TCB* tcb)
+{
+	settleDeadline(tcb);
+	tcb->deadline = 0;
+}
+
+void sched_run_start(TCB* tcb)
+{
+	if (policy == UTHREAD_SCHED_FAIR) {
+		tcb->sliceStart = uthread_clock();
+	} else if (policy == UTHREAD_SCHED_MLFQ) {
+		tcb->sliceStart = clockNs();
+	}
+}
+
+void sched_run_end(TCB* tcb)
+{
+	if (policy == UTHREAD_SCHED_MLFQ) {
+		mlfqRunEnd(tcb);
+		return;
+	}
+
+	if (policy != UTHREAD_SCHED_FAIR) {
+		return;
+	}
+
+	uint64_t now = uthread_clock();
+	uint64_t ran = now - tcb->sliceStart;
+
+	// Charge the time run so far, scaled by the weight of the thread.
+	tcb->vruntime += ran * DEFAULT_WEIGHT / tcb->weight;
+	tcb->sliceStart = now;
+}
+
+int uthread_set_weight(uthread_t tid, int weight)
+{
+	if (weight <= 0 || threadTable == NULL || threadTable[tid] == NULL) {
+		return -1;
+	}
+
+	threadTable[tid]->weight = weight;
+	return 0;
+}
+
+int uthread_set_priority(uthread_t tid, int prio)
+{
+	if (prio < UTHREAD_PRIO_HIGHEST || prio > UTHREAD_PRIO_LOWEST ||
+	    threadTable == NULL || threadTable[tid] == NULL) {
+		return -1;
+	}
+
+	TCB* tcb = threadTable[tid];
+	int queued = policy == UTHREAD_SCHED_MLFQ && tcb->status == READY;
+
+	// Move a queued thread over to its new level.
+	if (queued) {
+		queue_delete(levels[tcb->level], tcb);
+		if (queue_length(levels[tcb->level]) == 0) {
+			levelMask &= ~(1U << tcb->level);
+		}
+		mlfqLength--;
+	}
+
+	tcb->priority = prio;
+	tcb->level = prio;
+	tcb->levelUsed = 0;
+
+	if (queued) {
+		mlfqEnqueue(tcb);
+	}
+
+	return 0;
+}
+
+int uthread_set_deadline(uthread_t tid, unsigned long long deadline)
+{
+	if (threadTable == NULL || threadTable[tid] == NULL) {
+		return -1;
+	}
+
+	TCB* tcb = threadTable[tid];
+	int queued = policy == UTHREAD_SCHED_EDF && tcb->status == READY;
+
+	settleDeadline(tcb);
+
+	// Requeue a ready thread according to its new deadline.
+	if (queued) {
+		edfRemove(tcb);
+	}
+
+	tcb->deadline = deadline;
+
+	if (queued) {
+		edfEnqueue(tcb);
+	}
+
+	return 0;
+}
+
+unsigned long long uthread_deadline_misses(void)
+{
+	return deadlineMisses;
+}
@@ -0,0 +1,499 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "private.h"
+#include "uthread.h"
+
+/* Size of a cache line, used to keep producer and consumer indices apart */
+#define CACHE_LINE 64
+
+/* Number of messages a mailbox holds, a power of 2 */
+#define MAILBOX_SLOTS 256
+
+/* Kinds of messages */
+#define MSG_SUBMIT 0
+#define MSG_WAKE 1
+#define MSG_STOP 2
+
+/* Shard startup states */
+#define SHARD_STARTING 0
+#define SHARD_RUNNING 1
+#define SHARD_FAILED 2
+#define SHARD_STOPPED 3
+
+/**
+ * @brief shard_msg - A message sent from one shard to another
+ *
+ * kind:	MSG_SUBMIT, MSG_WAKE or MSG_STOP
+ * tid:		Thread to wake up, for MSG_WAKE
+ * func, arg:	Task to run, for MSG_SUBMIT
+ */
+struct shard_msg {
+	int kind;
+	uthread_t tid;
+	uthread_task_func_t func;
+	void* arg;
+};
+
+/**
+ * @brief mailbox - Single-producer single-consumer ring of messages
+ *
+ * There is one mailbox per ordered pair of shards, so that a mailbox is only
+ * written by the kernel thread of the sending shard and only read by the
+ * kernel thread of the receiving one, which needs no lock.
+ *
+ * head:	Next message to read, only advanced by the receiver
+ * tail:	Next slot to write, only advanced by the sender
+ * slots:	Messages between head and tail
+ */
+struct mailbox {
+	_Alignas(CACHE_LINE) _Atomic unsigned head;
+	_Alignas(CACHE_LINE) _Atomic unsigned tail;
+	_Alignas(CACHE_LINE) struct shard_msg slots[MAILBOX_SLOTS];
+};
+
+/**
+ * @brief shard - A kernel thread running its own scheduler
+ *
+ * thread:	Kernel thread of the shard, unused for shard 0
+ * created:	Whether @thread was created and must be joined
+ * index:	Index of the shard
+ * cpu:		CPU the shard is pinned to
+ * state:	SHARD_STARTING, SHARD_RUNNING, SHARD_FAILED or SHARD_STOPPED
+ * eventFd:	Signaled by senders when the shard sleeps
+ * sleeping:	Set while the scheduler of the shard waits for events
+ * stopping:	Set once the shard was told to stop, only used by the shard
+ */
+struct shard {
+	_Alignas(CACHE_LINE) pthread_t thread;
+	int created;
+	int index;
+	int cpu;
+	_Atomic int state;
+	int eventFd;
+	_Atomic int sleeping;
+	int stopping;
+};
+
+/* Shards and mailboxes, only modified while no other shard is running */
+static struct shard* shards = NULL;
+static struct mailbox* mailboxes = NULL;
+static int numShards = 0;
+
+/* Affinity of the kernel thread that started sharded mode, restored at stop */
+static cpu_set_t savedAffinity;
+
+/* Shard run by the calling kernel thread, NULL when not sharded */
+static __thread struct shard* self = NULL;
+
+static struct mailbox* mailboxOf(int from, int to)
+{
+	return &mailboxes[from * numShards + to];
+}
+
+static void pin(int cpu)
+{
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+/*
+ * sendMessage - Post message @msg to shard @to
+ *
+ * The receiver is only signaled if it sleeps.
+ *
+ * Return: -1 if the mailbox is full, 0 otherwise.
+ */
+static int sendMessage(int to, const struct shard_msg* msg)
+{
+	struct mailbox* box = mailboxOf(self->index, to);
+	unsigned tail = atomic_load_explicit(&box->tail, memory_order_relaxed);
+
+	// The receiver is not keeping up, let the caller decide what to do.
+	if (tail - atomic_load_explicit(&box->head, memory_order_acquire) ==
+	    MAILBOX_SLOTS) {
+		return -1;
+	}
+
+	box->slots[tail % MAILBOX_SLOTS] = *msg;
+	atomic_store_explicit(&box->tail, tail + 1, memory_order_release);
+
+	// Pairs with the fence in shard_sleep(): either the receiver sees the
+	// message before sleeping, or we see it sleeping.
+	atomic_thread_fence(memory_order_seq_cst);
+
+	struct shard* target = &shards[to];
+
+	if (atomic_load_explicit(&target->sleeping, memory_order_relaxed)) {
+		uint64_t one = 1;
+
+		while (write(target->eventFd, &one, sizeof(one)) == -1 &&
+		       errno == EINTR) {
+			// Interrupted by a signal, write again.
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * handleMessage - Act on message @msg
+ *
+ * Return: -1 if @msg is a task that cannot be created yet, because USHRT_MAX
+ * threads are alive or memory ran out, 0 otherwise.
+ */
+static int handleMessage(const struct shard_msg* msg)
+{
+	if (msg->kind == MSG_SUBMIT) {
+		int tid = uthread_spawn_task(msg->func, msg->arg);
+
+		if (tid == -1) {
+			return -1;
+		}
+
+		uthread_detach(tid);
+	} else if (msg->kind == MSG_WAKE) {
+		uthread_unpark(msg->tid);
+	} else {
+		self->stopping = 1;
+		uthread_unpark(0);
+	}
+
+	return 0;
+}
+
+static int inboxEmpty(void)
+{
+	for (int from = 0; from < numShards; from++) {
+		struct mailbox* box = mailboxOf(from, self->index);
+
+		if (atomic_load_explicit(&box->tail, memory_order_acquire) !=
+		    atomic_load_explicit(&box->head, memory_order_relaxed)) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+int shard_count(void)
+{
+	return numShards;
+}
+
+int shard_pending(void)
+{
+	return self != NULL && !self->stopping;
+}
+
+int shard_fd(void)
+{
+	return self->eventFd;
+}
+
+int shard_sleep(void)
+{
+	atomic_store_explicit(&self->sleeping, 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_seq_cst);
+
+	if (!inboxEmpty()) {
+		atomic_store_explicit(&self->sleeping, 0, memory_order_relaxed);
+		return -1;
+	}
+
+	return 0;
+}
+
+void shard_poll(void)
+{
+	if (self == NULL) {
+		return;
+	}
+
+	// Woken up, or about to be: clear the signal so the next sleep blocks.
+	if (atomic_load_explicit(&self->sleeping, memory_order_relaxed)) {
+		uint64_t count;
+
+		atomic_store_explicit(&self->sleeping, 0, memory_order_relaxed);
+		while (read(self->eventFd, &count, sizeof(count)) == -1 &&
+		       errno == EINTR) {
+			// Interrupted by a signal, read again.
+		}
+	}
+
+	// Drain every mailbox in one batch per scheduling round.
+	for (int from = 0; from < numShards; from++) {
+		struct mailbox* box = mailboxOf(from, self->index);
+		unsigned head = atomic_load_explicit(&box->head, memory_order_relaxed);
+		unsigned tail = atomic_load_explicit(&box->tail, memory_order_acquire);
+
+		if (head == tail) {
+			continue;
+		}
+
+		/*
+		 * A task that cannot be created yet stays first in the mailbox,
+		 * and is tried again next round: accepted work is never dropped,
+		 * and the messages behind it keep their order.
+		 */
+		while (head != tail &&
+		       handleMessage(&box->slots[head % MAILBOX_SLOTS]) == 0) {
+			head++;
+		}
+
+		atomic_store_explicit(&box->head, head, memory_order_release);
+	}
+}
+
+/*
+ * shardMain - Kernel thread of a shard other than shard 0
+ *
+ * Runs a scheduler of its own, whose main thread sleeps until the shard is
+ * told to stop. Meanwhile, messages make the other threads of the shard run.
+ */
+static void* shardMain(void* arg)
+{
+	struct shard* shard = arg;
+
+	self = shard;
+	pin(shard->cpu);
+
+	if (uthread_start(0) == -1) {
+		atomic_store(&shard->state, SHARD_FAILED);
+		return NULL;
+	}
+
+	atomic_store(&shard->state, SHARD_RUNNING);
+
+	while (!shard->stopping) {
+		uthread_park();
+	}
+
+	// Let the threads that are still ready, or waiting for a blocking call
+	// or an I/O request, finish. Yielding polls for their completion: the
+	// main thread must not block, nobody would wake it up.
+	while (uthread_stop() == -1) {
+		uthread_yield();
+	}
+
+	return NULL;
+}
+
+/*
+ * stopShards - Stop and join the shards running their own kernel thread
+ *
+ * Meanwhile, shard 0 keeps taking the messages sent to it, so that the other
+ * shards get room in their mailboxes. The threads started by these messages
+ * run once the other shards stopped.
+ */
+static void stopShards(void)
+{
+	struct shard_msg stop = { .kind = MSG_STOP };
+
+	for (int i = 1; i < numShards; i++) {
+		// A running shard drains its mailboxes, room is made shortly.
+		while (atomic_load(&shards[i].state) == SHARD_RUNNING &&
+		       sendMessage(i, &stop) == -1) {
+			shard_poll();
+			sched_yield();
+		}
+	}
+
+	for (int i = 1; i < numShards; i++) {
+		while (shards[i].created &&
+		       pthread_tryjoin_np(shards[i].thread, NULL) == EBUSY) {
+			shard_poll();
+			sched_yield();
+		}
+
+		atomic_store(&shards[i].state, SHARD_STOPPED);
+	}
+}
+
+/*
+ * releaseShards - Free the shards and leave sharded mode
+ */
+static void releaseShards(void)
+{
+	for (int i = 0; i < numShards; i++) {
+		if (shards[i].eventFd != -1) {
+			close(shards[i].eventFd);
+		}
+	}
+
+	free(shards);
+	free(mailboxes);
+	shards = NULL;
+	mailboxes = NULL;
+	numShards = 0;
+	self = NULL;
+
+	pthread_setaffinity_np(pthread_self(), sizeof(savedAffinity),
+			       &savedAffinity);
+}
+
+int uthread_start_sharded(int ncores)
+{
+	int cpus[CPU_SETSIZE];
+	int numCpus = 0;
+
+	if (ncores < 1 || ncores > SHARD_MAX || shards != NULL) {
+		return -1;
+	}
+
+	// Shards are spread over the CPUs the process may run on.
+	if (pthread_getaffinity_np(pthread_self(), sizeof(savedAffinity),
+				   &savedAffinity) != 0) {
+		return -1;
+	}
+
+	for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (CPU_ISSET(cpu, &savedAffinity)) {
+			cpus[numCpus++] = cpu;
+		}
+	}
+
+	shards = calloc(ncores, sizeof(struct shard));
+	mailboxes = aligned_alloc(CACHE_LINE,
+				  ncores * ncores * sizeof(struct mailbox));
+
+	if (shards == NULL || mailboxes == NULL) {
+		free(shards);
+		free(mailboxes);
+		shards = NULL;
+		mailboxes = NULL;
+		return -1;
+	}
+
+	memset(mailboxes, 0, ncores * ncores * sizeof(struct mailbox));
+	numShards = ncores;
+
+	for (int i = 0; i < ncores; i++) {
+		shards[i].index = i;
+		shards[i].cpu = cpus[i % numCpus];
+		shards[i].eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+		if (shards[i].eventFd == -1) {
+			releaseShards();
+			return -1;
+		}
+	}
+
+	// The calling kernel thread becomes shard 0.
+	self = &shards[0];
+	pin(shards[0].cpu);
+
+	if (uthread_start(0) == -1) {
+		releaseShards();
+		return -1;
+	}
+
+	atomic_store(&shards[0].state, SHARD_RUNNING);
+
+	int failed = 0;
+
+	for (int i = 1; i < ncores; i++) {
+		if (pthread_create(&shards[i].thread, NULL, shardMain, &shards[i])) {
+			atomic_store(&shards[i].state, SHARD_FAILED);
+		} else {
+			shards[i].created = 1;
+		}
+	}
+
+	// Wait for every shard to be up, to report failures.
+	for (int i = 1; i < ncores; i++) {
+		while (atomic_load(&shards[i].state) == SHARD_STARTING) {
+			sched_yield();
+		}
+
+		failed |= atomic_load(&shards[i].state) == SHARD_FAILED;
+	}
+
+	if (failed) {
+		stopShards();
+		releaseShards();
+		uthread_stop();
+		return -1;
+	}
+
+	return 0;
+}
+
+int uthread_stop_sharded(void)
+{
+	// Only the main thread of shard 0 stops sharded mode.
+	if (self == NULL || self->index != 0 || currentThread->TID != 0) {
+		return -1;
+	}
+
+	if (sched_length() > 0) {
+		return -1;
+	}
+
+	stopShards();
+
+	// Threads started by the last messages of the other shards, including
+	// tasks still waiting for a TID. What they send to other shards is
+	// refused from now on.
+	shard_poll();
+
+	while (sched_length() > 0 || !inboxEmpty()) {
+		uthread_yield();
+	}
+
+	releaseShards();
+
+	return uthread_stop();
+}
+
+int uthread_shard_self(void)
+{
+	return self != NULL ? self->index : 0;
+}
+
+int uthread_shard_submit(int shard, uthread_task_func_t func, void *arg)
+{
+	if (self == NULL || shard < 0 || shard >= numShards || func == NULL ||
+	    atomic_load(&shards[shard].state) == SHARD_STOPPED) {
+		return -1;
+	}
+
+	// Local work needs no message.
+	if (shard == self->index) {
+		int tid = uthread_spawn_task(func, arg);
+
+		return tid == -1 ? -1 : uthread_detach(tid);
+	}
+
+	struct shard_msg msg = { .kind = MSG_SUBMIT, .func = func, .arg = arg };
+
+	return sendMessage(shard, &msg);
+}
+
+int uthread_shard_wake(int shard, uthread_t tid)
+{
+	if (self == NULL || shard < 0 || shard >= numShards ||
+	    atomic_load(&shards[shard].state) == SHARD_STOPPED) {
+		return -1;
+	}
+
+	if (shard == self->index) {
+		return uthread_unpark(tid);
+	}
+
+	struct shard_msg msg = { .kind = MSG_WAKE, .tid = tid };
+
+	return sendMessage(shard, &msg);
+}
@@ -0,0 +1,154 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+#include "private.h"
+#include "uthread.h"
+
+/* Size of a huge page, the unit in which the arena grows */
+#define ARENA_CHUNK (2UL << 20)
+
+/* Address space reserved up front, enough for more stacks than TIDs */
+#define ARENA_RESERVE (4UL << 30)
+
+#ifndef MAP_HUGETLB
+#define MAP_HUGETLB 0
+#endif
+
+/* Whether new stacks come from the arena, see uthread_stack_arena() */
+static int arenaEnabled = 0;
+
+/**
+ * @brief arena - Stacks packed in huge pages
+ *
+ * The whole range is reserved at once, without any access, and chunks are
+ * mapped at its end as more stacks are needed. Explicit huge pages are tried
+ * first, then transparent ones. Freed stacks are kept in a LIFO list threaded
+ * through their own memory, so the most recently used stack is reused first.
+ *
+ * Each scheduler has its own arena, as stacks are always allocated and freed
+ * by the kernel thread of the shard they belong to.
+ *
+ * reserved:	Range reserved with mmap(), NULL until first used
+ * base:	Start of the reserved range, aligned on a chunk
+ * mapped:	Bytes mapped at the start of the range
+ * carved:	Bytes handed out as stacks so far, at most @mapped
+ * freeList:	Stacks freed and not handed out again
+ * noHugetlb:	Set once explicit huge pages turned out to be unavailable
+ */
+static __thread struct {
+	void* reserved;
+	char* base;
+	size_t mapped;
+	size_t carved;
+	void* freeList;
+	int noHugetlb;
+} arena;
+
+/*
+ * arenaGrow - Map one more chunk at the end of the arena
+ *
+ * Return: 0 in case of success, -1 if the arena is full or out of memory.
+ */
+static int arenaGrow(void)
+{
+	if (arena.reserved == NULL) {
+		// Over-reserve by a chunk so that the start can be aligned.
+		void* range = mmap(NULL, ARENA_RESERVE + ARENA_CHUNK, PROT_NONE,
+				   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+				   -1, 0);
+
+		if (range == MAP_FAILED) {
+			return -1;
+		}
+
+		uintptr_t aligned = ((uintptr_t)range + ARENA_CHUNK - 1) &
+				    ~(ARENA_CHUNK - 1);
+		arena.reserved = range;
+		arena.base = (char*)aligned;
+	}
+
+	if (arena.mapped == ARENA_RESERVE) {
+		return -1;
+	}
+
+	char* chunk = arena.base + arena.mapped;
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED;
+
+	if (!arena.noHugetlb && MAP_HUGETLB != 0 &&
+	    mmap(chunk, ARENA_CHUNK, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB,
+		 -1, 0) != MAP_FAILED) {
+		arena.mapped += ARENA_CHUNK;
+		return 0;
+	}
+
+	// No explicit huge page reserved, ask for a transparent one.
+	arena.noHugetlb = 1;
+
+	if (mmap(chunk, ARENA_CHUNK, PROT_READ | PROT_WRITE, flags, -1,
+		 0) == MAP_FAILED) {
+		return -1;
+	}
+	madvise(chunk, ARENA_CHUNK, MADV_HUGEPAGE);
+
+	arena.mapped += ARENA_CHUNK;
+	return 0;
+}
+
+void* arena_alloc_stack(void)
+{
+	if (!arenaEnabled) {
+		return NULL;
+	}
+
+	if (arena.freeList != NULL) {
+		void* stack = arena.freeList;
+		arena.freeList = *(void**)stack;
+		return stack;
+	}
+
+	if (arena.carved + UTHREAD_STACK_SIZE > arena.mapped &&
+	    arenaGrow() == -1) {
+		return NULL;
+	}
+
+	void* stack = arena.base + arena.carved;
+	arena.carved += UTHREAD_STACK_SIZE;
+
+	return stack;
+}
+
+int arena_free_stack(void* stack)
+{
+	char* address = stack;
+
+	if (arena.base == NULL || address < arena.base ||
+	    address >= arena.base + arena.mapped) {
+		return -1;
+	}
+
+	*(void**)stack = arena.freeList;
+	arena.freeList = stack;
+
+	return 0;
+}
+
+void arena_stop(void)
+{
+	if (arena.reserved == NULL) {
+		return;
+	}
+
+	munmap(arena.reserved, ARENA_RESERVE + ARENA_CHUNK);
+	arena.reserved = NULL;
+	arena.base = NULL;
+	arena.mapped = 0;
+	arena.carved = 0;
+	arena.freeList = NULL;
+	arena.noHugetlb = 0;
+}
+
+void uthread_stack_arena(int enable)
+{
+	arenaEnabled = enable;
+}
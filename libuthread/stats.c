@@ -0,0 +1,367 @@
+#include <stddef.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "private.h"
+#include "uthread.h"
+
+int uthread_set_class(uthread_t tid, int cls)
+{
+	if (cls < 0 || cls >= UTHREAD_CLASSES || threadTable == NULL ||
+	    threadTable[tid] == NULL) {
+		return -1;
+	}
+
+	threadTable[tid]->threadClass = cls;
+	return 0;
+}
+
+#if UTHREAD_STATS
+
+/*
+ * Latency histograms are log-linear: values below HIST_SUB each get a bucket,
+ * then every power of 2 is split into HIST_SUB buckets. Values of 2^HIST_TOP
+ * ticks and more land in the last bucket.
+ */
+#define HIST_SUB_BITS 4
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_TOP 48
+#define HIST_BUCKETS ((HIST_TOP - HIST_SUB_BITS + 1) * HIST_SUB)
+
+/* Counters of every shard, summed up by uthread_stats_snapshot() */
+static struct uthread_stats shardStats[SHARD_MAX];
+
+__thread struct uthread_stats* schedStats = &shardStats[0];
+
+/*
+ * Histograms of every shard, summed up by uthread_stats_percentiles(). NULL
+ * until the shard first starts, then kept for the following runs.
+ */
+typedef uint64_t hist_t[UTHREAD_CLASSES][2][HIST_BUCKETS];
+static hist_t* shardHists[SHARD_MAX];
+
+static __thread hist_t* schedHists = NULL;
+
+/* Entries of a chunk of a per-thread table */
+#define THREAD_CHUNK 1024
+#define THREAD_CHUNKS ((USHRT_MAX + 1) / THREAD_CHUNK)
+
+/*
+ * Per-thread tables of every shard, indexed by TID, and the number of TIDs
+ * handed out in each. Chunks are allocated on demand and kept for the following
+ * runs, so that uthread_stats_shard_thread() never reads freed memory.
+ */
+static struct uthread_thread_stats* shardThreads[SHARD_MAX][THREAD_CHUNKS];
+static unsigned int shardNumThreads[SHARD_MAX];
+
+static __thread int schedShard = 0;
+
+/* Reference points used to derive the clock frequency */
+static uint64_t startTicks;
+static struct timespec startTime;
+
+int stats_start(int shard)
+{
+	if (shardHists[shard] == NULL) {
+		hist_t* hists = calloc(1, sizeof(hist_t));
+
+		if (hists == NULL) {
+			return -1;
+		}
+
+		// Published for uthread_stats_percentiles() on other threads.
+		__atomic_store_n(&shardHists[shard], hists, __ATOMIC_RELEASE);
+	}
+
+	schedStats = &shardStats[shard];
+	schedHists = shardHists[shard];
+	schedShard = shard;
+
+	if (shard != 0) {
+		memset(schedStats, 0, sizeof(*schedStats));
+		memset(schedHists, 0, sizeof(*schedHists));
+		__atomic_store_n(&shardNumThreads[shard], 0, __ATOMIC_RELAXED);
+		return 0;
+	}
+
+	// No other shard runs yet: forget about those of the previous run.
+	memset(shardStats, 0, sizeof(shardStats));
+	memset(shardNumThreads, 0, sizeof(shardNumThreads));
+
+	for (int i = 0; i < SHARD_MAX; i++) {
+		if (shardHists[i] != NULL) {
+			memset(shardHists[i], 0, sizeof(hist_t));
+		}
+	}
+
+	startTicks = uthread_clock();
+	clock_gettime(CLOCK_MONOTONIC, &startTime);
+	return 0;
+}
+
+int stats_thread_start(TCB* tcb)
+{
+	struct uthread_thread_stats** chunk =
+		&shardThreads[schedShard][tcb->TID / THREAD_CHUNK];
+
+	if (*chunk == NULL) {
+		struct uthread_thread_stats* entries =
+			calloc(THREAD_CHUNK, sizeof(struct uthread_thread_stats));
+
+		if (entries == NULL) {
+			return -1;
+		}
+
+		__atomic_store_n(chunk, entries, __ATOMIC_RELEASE);
+	}
+
+	tcb->stats = &(*chunk)[tcb->TID % THREAD_CHUNK];
+	__atomic_store_n(&tcb->stats->runTicks, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&tcb->stats->readyTicks, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&tcb->stats->dispatches, 0, __ATOMIC_RELAXED);
+
+	// Published once the entry is initialized.
+	unsigned int* count = &shardNumThreads[schedShard];
+
+	if (tcb->TID >= *count) {
+		__atomic_store_n(count, tcb->TID + 1, __ATOMIC_RELEASE);
+	}
+
+	return 0;
+}
+
+/*
+ * clockHz - Frequency of the scheduler clock
+ *
+ * Measured against the monotonic clock since uthread_start(), which needs no
+ * calibration delay up front.
+ */
+static unsigned long long clockHz(void)
+{
+	struct timespec now;
+	uint64_t ticks = uthread_clock();
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	double elapsed = (now.tv_sec - startTime.tv_sec) +
+			 (now.tv_nsec - startTime.tv_nsec) / 1e9;
+
+	if (elapsed <= 0) {
+		return 0;
+	}
+
+	return (ticks - startTicks) / elapsed;
+}
+
+int uthread_stats_snapshot(struct uthread_stats *stats)
+{
+	if (stats == NULL) {
+		return -1;
+	}
+
+	memset(stats, 0, sizeof(*stats));
+
+	for (int i = 0; i < SHARD_MAX; i++) {
+		struct uthread_stats* shard = &shardStats[i];
+
+		stats->switches += __atomic_load_n(&shard->switches, __ATOMIC_RELAXED);
+		stats->creations += __atomic_load_n(&shard->creations, __ATOMIC_RELAXED);
+		stats->exits += __atomic_load_n(&shard->exits, __ATOMIC_RELAXED);
+		stats->joins += __atomic_load_n(&shard->joins, __ATOMIC_RELAXED);
+		stats->zombies += __atomic_load_n(&shard->zombies, __ATOMIC_RELAXED);
+	}
+	stats->clockHz = clockHz();
+
+	return 0;
+}
+
+/*
+ * histBucket - Bucket of value @ticks
+ */
+static inline int histBucket(uint64_t ticks)
+{
+	if (ticks < HIST_SUB) {
+		return ticks;
+	}
+
+	if (ticks >> HIST_TOP) {
+		ticks = (1ULL << HIST_TOP) - 1;
+	}
+
+	int exponent = 63 - __builtin_clzll(ticks);
+	int shift = exponent - HIST_SUB_BITS;
+
+	return (shift + 1) * HIST_SUB + ((ticks >> shift) & (HIST_SUB - 1));
+}
+
+/*
+ * histUpperBound - Highest value counted in bucket @bucket
+ */
+static uint64_t histUpperBound(int bucket)
+{
+	if (bucket < HIST_SUB) {
+		return bucket;
+	}
+
+	int shift = bucket / HIST_SUB - 1;
+	uint64_t low = (uint64_t)(HIST_SUB + bucket % HIST_SUB) << shift;
+
+	return low + (1ULL << shift) - 1;
+}
+
+void stats_hist_add(int hist, int threadClass, uint64_t ticks)
+{
+	uint64_t* count = &(*schedHists)[threadClass][hist][histBucket(ticks)];
+
+	// Single writer, see STATS_ADD().
+	__atomic_store_n(count, *count + 1, __ATOMIC_RELAXED);
+}
+
+int uthread_stats_percentiles(int cls, int hist, const double *percentiles,
+			      unsigned long long *ns, int count)
+{
+	uint64_t buckets[HIST_BUCKETS] = { 0 };
+	uint64_t total = 0;
+
+	if (cls < 0 || cls >= UTHREAD_CLASSES || hist < UTHREAD_HIST_DELAY ||
+	    hist > UTHREAD_HIST_RUN || percentiles == NULL || ns == NULL) {
+		return -1;
+	}
+
+	for (int i = 0; i < SHARD_MAX; i++) {
+		hist_t* hists = __atomic_load_n(&shardHists[i], __ATOMIC_ACQUIRE);
+
+		// Never started.
+		if (hists == NULL) {
+			continue;
+		}
+
+		uint64_t* shard = (*hists)[cls][hist];
+
+		for (int b = 0; b < HIST_BUCKETS; b++) {
+			buckets[b] += __atomic_load_n(&shard[b], __ATOMIC_RELAXED);
+		}
+	}
+
+	for (int b = 0; b < HIST_BUCKETS; b++) {
+		total += buckets[b];
+	}
+
+	if (total == 0) {
+		return 0;
+	}
+
+	unsigned long long hz = clockHz();
+	double nsPerTick = hz != 0 ? 1e9 / hz : 1;
+
+	for (int i = 0; i < count; i++) {
+		// Rank of the percentile, at least the first value.
+		double rank = percentiles[i] / 100 * total;
+		uint64_t target = rank < 1 ? 1 : (uint64_t)rank;
+		uint64_t seen = 0;
+		int b = 0;
+
+		if (target > total) {
+			target = total;
+		}
+
+		while (seen + buckets[b] < target) {
+			seen += buckets[b++];
+		}
+
+		ns[i] = histUpperBound(b) * nsPerTick;
+	}
+
+	return total;
+}
+
+int uthread_stats_thread(uthread_t tid, struct uthread_thread_stats *stats)
+{
+	if (stats == NULL || threadTable == NULL || threadTable[tid] == NULL) {
+		return -1;
+	}
+
+	TCB* tcb = threadTable[tid];
+
+	*stats = *tcb->stats;
+
+	// The calling thread is running right now, include its current slice.
+	if (tcb == currentThread) {
+		stats->runTicks += uthread_clock() - tcb->stamp;
+	}
+
+	return 0;
+}
+
+int uthread_stats_shard_thread(int shard, uthread_t tid,
+			       struct uthread_thread_stats *stats)
+{
+	if (stats == NULL || shard < 0 || shard >= SHARD_MAX ||
+	    tid >= __atomic_load_n(&shardNumThreads[shard], __ATOMIC_ACQUIRE)) {
+		return -1;
+	}
+
+	struct uthread_thread_stats* entry =
+		&__atomic_load_n(&shardThreads[shard][tid / THREAD_CHUNK],
+				 __ATOMIC_ACQUIRE)[tid % THREAD_CHUNK];
+
+	stats->runTicks = __atomic_load_n(&entry->runTicks, __ATOMIC_RELAXED);
+	stats->readyTicks = __atomic_load_n(&entry->readyTicks,
+					    __ATOMIC_RELAXED);
+	stats->dispatches = __atomic_load_n(&entry->dispatches,
+					    __ATOMIC_RELAXED);
+
+	return 0;
+}
+
+#else
+
+int stats_start(int shard)
+{
+	(void)shard;
+	return 0;
+}
+
+int stats_thread_start(TCB* tcb)
+{
+	tcb->stats = NULL;
+	return 0;
+}
+
+int uthread_stats_snapshot(struct uthread_stats *stats)
+{
+	(void)stats;
+	return -1;
+}
+
+int uthread_stats_thread(uthread_t tid, struct uthread_thread_stats *stats)
+{
+	(void)tid;
+	(void)stats;
+	return -1;
+}
+
+int uthread_stats_shard_thread(int shard, uthread_t tid,
+			       struct uthread_thread_stats *stats)
+{
+	(void)shard;
+	(void)tid;
+	(void)stats;
+	return -1;
+}
+
+int uthread_stats_percentiles(int cls, int hist, const double *percentiles,
+			      unsigned long long *ns, int count)
+{
+	(void)cls;
+	(void)hist;
+	(void)percentiles;
+	(void)ns;
+	(void)count;
+	return -1;
+}
+
+#endif /* UTHREAD_STATS */
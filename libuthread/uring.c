@@ -0,0 +1,488 @@
+#include <errno.h>
+#include <limits.h>
+#include <linux/io_uring.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "private.h"
+#include "uthread.h"
+
+/* Number of submission queue entries of the ring */
+#define URING_ENTRIES 256
+
+/* Number of prepared requests after which they are submitted right away */
+#define URING_BATCH 64
+
+/* Returned by uringCall() when the request must go through the helper pool */
+#define URING_UNAVAILABLE INT_MIN
+
+/**
+ * @brief uring_request - An I/O request in flight on the ring
+ *
+ * The request lives on the stack of the calling thread, which stays blocked
+ * until its completion is reaped.
+ *
+ * tcb:	Thread to unblock once the request completed
+ * res:	Result of the request, negative errno value in case of failure
+ * done:	Set once @res is known
+ */
+struct uring_request {
+	TCB* tcb;
+	int res;
+	int done;
+};
+
+/**
+ * @brief uring - The io_uring instance owned by the scheduler
+ *
+ * fd:			Ring file descriptor, -1 if not set up
+ * disabled:		Set once io_uring turned out to be unavailable, or
+ *			the ring unusable
+ * sqHead, sqTail...:	Submission queue ring, shared with the kernel
+ * sqes:		Submission queue entries
+ * cqHead, cqTail...:	Completion queue ring, shared with the kernel
+ * unsubmitted:		Requests prepared but not yet passed to the kernel
+ * inFlight:		Requests prepared whose completion was not reaped
+ * roundLeft:		Dispatches left before the current scheduling round ends
+ */
+static __thread struct {
+	int fd;
+	int disabled;
+
+	void* sqRing;
+	size_t sqRingSize;
+	_Atomic unsigned* sqHead;
+	_Atomic unsigned* sqTail;
+	unsigned sqMask;
+	unsigned sqEntries;
+	unsigned* sqArray;
+	struct io_uring_sqe* sqes;
+	size_t sqesSize;
+
+	void* cqRing;
+	size_t cqRingSize;
+	_Atomic unsigned* cqHead;
+	_Atomic unsigned* cqTail;
+	unsigned cqMask;
+	unsigned cqEntries;
+	struct io_uring_cqe* cqes;
+
+	unsigned unsubmitted;
+	unsigned inFlight;
+	int roundLeft;
+} ring = { .fd = -1 };
+
+/*
+ * opsSupported - Whether ring @fd supports every operation used here
+ *
+ * Probing itself appeared in Linux 5.6, along with IORING_OP_READ and
+ * IORING_OP_WRITE: a kernel that cannot be probed does not support them.
+ */
+static int opsSupported(int fd)
+{
+	static const int ops[] = { IORING_OP_READ, IORING_OP_WRITE,
+				   IORING_OP_FSYNC };
+	struct io_uring_probe* probe =
+		calloc(1, sizeof(*probe) + 256 * sizeof(struct io_uring_probe_op));
+	int supported = 0;
+
+	if (probe == NULL) {
+		return 0;
+	}
+
+	if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe,
+		    256) == 0) {
+		supported = 1;
+
+		for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+			if (ops[i] > probe->last_op ||
+			    !(probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED)) {
+				supported = 0;
+			}
+		}
+	}
+
+	free(probe);
+	return supported;
+}
+
+/*
+ * setupRing - Set up the ring on first use
+ *
+ * Return: 0 if the ring is usable, -1 if io_uring is unavailable, in which case
+ * calls fall back to the helper pool.
+ */
+static int setupRing(void)
+{
+	// Checked first: a ring that failed stays open until its requests in
+	// flight completed.
+	if (ring.disabled) {
+		return -1;
+	}
+
+	if (ring.fd != -1) {
+		return 0;
+	}
+
+	// Allow forcing the helper pool, e.g. for comparison.
+	const char* env = getenv("UTHREAD_IO_URING");
+	if (env != NULL && strcmp(env, "0") == 0) {
+		ring.disabled = 1;
+		return -1;
+	}
+
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+
+	int fd = syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+
+	// Old kernel, or io_uring blocked by a seccomp policy.
+	if (fd == -1) {
+		ring.disabled = 1;
+		return -1;
+	}
+
+	// Reads and writes need Linux 5.6, older rings would fail them all.
+	if (!opsSupported(fd)) {
+		goto fail;
+	}
+
+	ring.sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	ring.cqRingSize = params.cq_off.cqes +
+			  params.cq_entries * sizeof(struct io_uring_cqe);
+
+	// Both rings may share a single mapping.
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		if (ring.cqRingSize > ring.sqRingSize) {
+			ring.sqRingSize = ring.cqRingSize;
+		}
+		ring.cqRingSize = ring.sqRingSize;
+	}
+
+	ring.sqRing = mmap(NULL, ring.sqRingSize, PROT_READ | PROT_WRITE,
+			   MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+
+	if (ring.sqRing == MAP_FAILED) {
+		goto fail;
+	}
+
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		ring.cqRing = ring.sqRing;
+	} else {
+		ring.cqRing = mmap(NULL, ring.cqRingSize, PROT_READ | PROT_WRITE,
+				   MAP_SHARED | MAP_POPULATE, fd,
+				   IORING_OFF_CQ_RING);
+
+		if (ring.cqRing == MAP_FAILED) {
+			munmap(ring.sqRing, ring.sqRingSize);
+			goto fail;
+		}
+	}
+
+	ring.sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+	ring.sqes = mmap(NULL, ring.sqesSize, PROT_READ | PROT_WRITE,
+			 MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+
+	if (ring.sqes == MAP_FAILED) {
+		if (ring.cqRing != ring.sqRing) {
+			munmap(ring.cqRing, ring.cqRingSize);
+		}
+		munmap(ring.sqRing, ring.sqRingSize);
+		goto fail;
+	}
+
+	char* sq = ring.sqRing;
+	ring.sqHead = (_Atomic unsigned*)(sq + params.sq_off.head);
+	ring.sqTail = (_Atomic unsigned*)(sq + params.sq_off.tail);
+	ring.sqMask = *(unsigned*)(sq + params.sq_off.ring_mask);
+	ring.sqEntries = *(unsigned*)(sq + params.sq_off.ring_entries);
+	ring.sqArray = (unsigned*)(sq + params.sq_off.array);
+
+	char* cq = ring.cqRing;
+	ring.cqHead = (_Atomic unsigned*)(cq + params.cq_off.head);
+	ring.cqTail = (_Atomic unsigned*)(cq + params.cq_off.tail);
+	ring.cqMask = *(unsigned*)(cq + params.cq_off.ring_mask);
+	ring.cqEntries = *(unsigned*)(cq + params.cq_off.ring_entries);
+	ring.cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+
+	ring.unsubmitted = 0;
+	ring.inFlight = 0;
+	ring.fd = fd;
+
+	return 0;
+
+fail:
+	close(fd);
+	ring.disabled = 1;
+	return -1;
+}
+
+/*
+ * failUnsubmitted - Fail the requests the kernel did not take
+ * @err: errno value the requests fail with
+ *
+ * Called once the ring turned out to be unusable: the requests are removed
+ * from the submission queue, and their threads unblocked. The ring is disabled,
+ * so that later requests go through the helper pool, but requests already
+ * submitted are still reaped.
+ */
+static void failUnsubmitted(int err)
+{
+	unsigned head = atomic_load_explicit(ring.sqHead, memory_order_acquire);
+	unsigned tail = atomic_load_explicit(ring.sqTail, memory_order_relaxed);
+
+	for (unsigned i = head; i != tail; i++) {
+		struct io_uring_sqe* sqe = &ring.sqes[ring.sqArray[i & ring.sqMask]];
+		struct uring_request* req = (void*)(uintptr_t)sqe->user_data;
+
+		req->res = -err;
+		req->done = 1;
+		ring.inFlight--;
+
+		// Unless the thread is preparing this request, and has not
+		// blocked yet.
+		if (req->tcb->status != RUNNING) {
+			uthread_unblock(req->tcb);
+		}
+	}
+
+	atomic_store_explicit(ring.sqTail, head, memory_order_release);
+	ring.unsubmitted = 0;
+	ring.disabled = 1;
+}
+
+void uring_submit(void)
+{
+	while (ring.unsubmitted > 0) {
+		int submitted = syscall(__NR_io_uring_enter, ring.fd,
+					ring.unsubmitted, 0, 0, NULL, 0);
+
+		if (submitted == -1) {
+			if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+				continue;
+			}
+
+			failUnsubmitted(errno);
+			return;
+		}
+
+		ring.unsubmitted -= submitted;
+	}
+}
+
+/*
+ * uringCall - Perform an I/O request through the ring
+ * @opcode: io_uring operation
+ * @fd, @addr, @len, @offset: Operands of the operation
+ *
+ * Return: Result of the request, or URING_UNAVAILABLE if the ring cannot take
+ * it, in which case the caller falls back to the helper pool.
+ */
+static int uringCall(int opcode, int fd, const void* addr, unsigned len,
+		     off_t offset)
+{
+	if (currentThread == NULL || setupRing() == -1) {
+		return URING_UNAVAILABLE;
+	}
+
+	// Every in-flight request must find room in the completion queue.
+	if (ring.inFlight == ring.cqEntries) {
+		return URING_UNAVAILABLE;
+	}
+
+	unsigned tail = atomic_load_explicit(ring.sqTail, memory_order_relaxed);
+
+	// Submission queue full of prepared requests, hand them over first.
+	if (tail - atomic_load_explicit(ring.sqHead, memory_order_acquire) ==
+	    ring.sqEntries) {
+		uring_submit();
+
+		if (ring.disabled) {
+			return URING_UNAVAILABLE;
+		}
+	}
+
+	struct uring_request req = { .tcb = currentThread, .res = 0, .done = 0 };
+	unsigned index = tail & ring.sqMask;
+	struct io_uring_sqe* sqe = &ring.sqes[index];
+
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = opcode;
+	sqe->fd = fd;
+	sqe->addr = (uint64_t)(uintptr_t)addr;
+	sqe->len = len;
+	sqe->off = offset;
+	sqe->user_data = (uint64_t)(uintptr_t)&req;
+
+	ring.sqArray[index] = index;
+	atomic_store_explicit(ring.sqTail, tail + 1, memory_order_release);
+
+	// First request of this round: submit once every ready thread had a
+	// chance to prepare its own.
+	if (ring.unsubmitted == 0) {
+		ring.roundLeft = sched_length();
+	}
+
+	ring.unsubmitted++;
+	ring.inFlight++;
+
+	if (ring.unsubmitted >= URING_BATCH) {
+		uring_submit();
+	}
+
+	// Unless it failed to be submitted right above.
+	if (!req.done) {
+		uthread_block();
+	}
+
+	return req.res;
+}
+
+void uring_dispatch(void)
+{
+	if (ring.unsubmitted > 0 && --ring.roundLeft <= 0) {
+		uring_submit();
+	}
+}
+
+int uring_pending(void)
+{
+	return ring.inFlight;
+}
+
+int uring_fd(void)
+{
+	return ring.fd;
+}
+
+void uring_poll(void)
+{
+	if (ring.inFlight == 0) {
+		return;
+	}
+
+	unsigned head = atomic_load_explicit(ring.cqHead, memory_order_relaxed);
+	unsigned tail = atomic_load_explicit(ring.cqTail, memory_order_acquire);
+
+	// Reap every available completion in one go.
+	for (; head != tail; head++) {
+		struct io_uring_cqe* cqe = &ring.cqes[head & ring.cqMask];
+		struct uring_request* req = (void*)(uintptr_t)cqe->user_data;
+
+		req->res = cqe->res;
+		req->done = 1;
+		ring.inFlight--;
+		uthread_unblock(req->tcb);
+	}
+
+	atomic_store_explicit(ring.cqHead, head, memory_order_release);
+}
+
+void uring_stop(void)
+{
+	if (ring.fd == -1) {
+		return;
+	}
+
+	munmap(ring.sqes, ring.sqesSize);
+	if (ring.cqRing != ring.sqRing) {
+		munmap(ring.cqRing, ring.cqRingSize);
+	}
+	munmap(ring.sqRing, ring.sqRingSize);
+	close(ring.fd);
+
+	ring.fd = -1;
+	ring.disabled = 0;
+}
+
+/**
+ * @brief io_args - Arguments of an I/O call run by the helper pool
+ */
+struct io_args {
+	int fd;
+	void* buf;
+	size_t count;
+	off_t offset;
+};
+
+static long helperPread(void* arg)
+{
+	struct io_args* io = arg;
+	return pread(io->fd, io->buf, io->count, io->offset);
+}
+
+static long helperPwrite(void* arg)
+{
+	struct io_args* io = arg;
+	return pwrite(io->fd, io->buf, io->count, io->offset);
+}
+
+static long helperFsync(void* arg)
+{
+	struct io_args* io = arg;
+	return fsync(io->fd);
+}
+
+/*
+ * ioResult - Convert a ring result to the usual -1/errno convention
+ */
+static long ioResult(int res)
+{
+	if (res < 0) {
+		errno = -res;
+		return -1;
+	}
+
+	return res;
+}
+
+ssize_t uthread_pread(int fd, void *buf, size_t count, off_t offset)
+{
+	// A single request cannot transfer more than an unsigned length.
+	if (count > UINT32_MAX) {
+		count = UINT32_MAX;
+	}
+
+	int res = uringCall(IORING_OP_READ, fd, buf, count, offset);
+
+	if (res == URING_UNAVAILABLE) {
+		struct io_args io = { fd, buf, count, offset };
+		return uthread_blocking_call(helperPread, &io);
+	}
+
+	return ioResult(res);
+}
+
+ssize_t uthread_pwrite(int fd, const void *buf, size_t count, off_t offset)
+{
+	if (count > UINT32_MAX) {
+		count = UINT32_MAX;
+	}
+
+	int res = uringCall(IORING_OP_WRITE, fd, buf, count, offset);
+
+	if (res == URING_UNAVAILABLE) {
+		struct io_args io = { fd, (void*)buf, count, offset };
+		return uthread_blocking_call(helperPwrite, &io);
+	}
+
+	return ioResult(res);
+}
+
+int uthread_fsync(int fd)
+{
+	int res = uringCall(IORING_OP_FSYNC, fd, NULL, 0, 0);
+
+	if (res == URING_UNAVAILABLE) {
+		struct io_args io = { fd, NULL, 0, 0 };
+		return uthread_blocking_call(helperFsync, &io);
+	}
+
+	return ioResult(res);
+}
@@ -1,20 +1,77 @@
 #include <assert.h>
+#include <errno.h>
 #include <limits.h>
+#include <poll.h>
 #include <signal.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/time.h>
 
 #include "private.h"
 #include "uthread.h"
 #include "queue.h"
 
-queue_t readyQueue = NULL;
-queue_t zombieQueue = NULL;
-TCB* currentThread = NULL;
-int numTIDs = 0;
+__thread queue_t readyQueue = NULL;
+__thread queue_t zombieQueue = NULL;
+__thread TCB* currentThread = NULL;
+__thread TCB** threadTable = NULL;
+__thread int numTIDs = 0;
+__thread int numParked = 0;
+
+/*
+ * Spare context and stack on which the next task gets started, so that tasks
+ * do not pay for a new stack each. NULL when not yet allocated, or when the
+ * last one was kept by a task that blocked.
+ */
+static __thread uthread_ctx_t* runnerContext = NULL;
+static __thread void* runnerStack = NULL;
+
+/* Set while a finished task looks for another task to run in its place */
+static __thread int runnerChaining = 0;
+
+/* Dead detached threads, linked through nextDetached, until destroyed */
+static __thread TCB* deadDetached = NULL;
+
+/*
+ * TIDs of destroyed threads, handed out again once every TID was used once.
+ * Ring indexed modulo USHRT_MAX + 1, which cannot overflow since there are
+ * never more than USHRT_MAX free TIDs.
+ */
+static __thread uthread_t* freeTIDs = NULL;
+static __thread uthread_t freeHead = 0;
+static __thread uthread_t freeTail = 0;
+
+static int taskRunner(void);
+static void reapDetached(void);
+
+/*
+ * allocTID - Get a TID for a new thread
+ *
+ * TIDs are first handed out in increasing order. Once they all were, the TIDs
+ * of destroyed threads are reused, those freed first being reused first.
+ *
+ * Return: A TID, -1 if USHRT_MAX threads are alive.
+ */
+static int allocTID(void)
+{
+	if (numTIDs < USHRT_MAX) {
+		return ++numTIDs;
+	}
+
+	if (freeHead == freeTail) {
+		return -1;
+	}
+
+	return freeTIDs[freeHead++];
+}
+
+static void releaseTID(uthread_t tid)
+{
+	freeTIDs[freeTail++] = tid;
+}
 
 TCB* newTCB(int TID) {
     TCB* tcb = malloc(sizeof(TCB));
@@ -25,28 +82,47 @@ TCB* newTCB(int TID) {
     }
     
     tcb->TID = TID;
-    uthread_ctx_t* ctx = malloc(sizeof(uthread_ctx_t));
 
-    // Error issuing context.
-    if (ctx == NULL) {
-        return NULL;
-    }
-
-    tcb->context = ctx;
+    // Context and stack are only materialized when the thread first runs.
+    tcb->context = NULL;
+    tcb->stack = NULL;
+    tcb->func = NULL;
+    tcb->task = NULL;
+    tcb->taskArg = NULL;
+
+    tcb->weight = 1024;
+    tcb->priority = UTHREAD_PRIO_HIGHEST;
+    tcb->level = UTHREAD_PRIO_HIGHEST;
+    tcb->levelUsed = 0;
+    tcb->boostEpoch = 0;
+    tcb->deadline = 0;
+    tcb->heapIndex = -1;
+    tcb->vruntime = 0;
+    tcb->sliceStart = 0;
 
     // TCB status BLOCKED by default, to be queued.
     tcb->status = BLOCKED;
 
-    void* stack = uthread_ctx_alloc_stack();
-
-    // Error issuing stack for thread.
-    if (stack == NULL) {
+    tcb->joinedToThread = NULL;
+    tcb->joinGroup = NULL;
+    tcb->detached = 0;
+    tcb->nextDetached = NULL;
+    tcb->parked = 0;
+    tcb->wakeToken = 0;
+    tcb->threadClass = 0;
+    memset(tcb->perf, 0, sizeof(tcb->perf));
+    memset(&tcb->arena, 0, sizeof(tcb->arena));
+    memset(tcb->locals, 0, sizeof(tcb->locals));
+    tcb->spilledLocals = NULL;
+
+    tcb->stamp = uthread_clock();
+
+    if (stats_thread_start(tcb) == -1) {
+        free(tcb);
         return NULL;
     }
 
-    tcb->stack = stack;
-
-    tcb->joinedToThread = NULL;
+    threadTable[TID] = tcb;
 
     return tcb;
 }
@@ -57,15 +133,27 @@ void destroyTCB(TCB* tcb) {
 		return;
 	}
 
+	// The TID no longer refers to a live thread, and can be reused.
+	if (threadTable[tcb->TID] == tcb) {
+		threadTable[tcb->TID] = NULL;
+
+		if (tcb->TID != 0) {
+			releaseTID(tcb->TID);
+		}
+	}
+
 	// Free any active struct attributes.
 	if (tcb->stack) {
-		free(tcb->stack);
+		uthread_ctx_destroy_stack(tcb->stack);
 	}
 
 	if (tcb->context) {
 		free(tcb->context);
 	}
 
+	alloc_release(tcb);
+	locals_release(tcb);
+
 	// Free TCB struct.
 	free(tcb);
 }
@@ -73,6 +161,15 @@ void destroyTCB(TCB* tcb) {
 
 int uthread_start(int preempt)
 {
+	return uthread_start_sched(preempt, UTHREAD_SCHED_FIFO);
+}
+
+int uthread_start_sched(int preempt, int policy)
+{
+	if (sched_start(policy) == -1) {
+		return -1;
+	}
+
 	if (preempt == 1) {
 		preempt_start();
 	}
@@ -81,43 +178,129 @@ int uthread_start(int preempt)
 	zombieQueue = queue_create();
 	currentThread = NULL;
 	numTIDs = 0;
+	freeHead = 0;
+	freeTail = 0;
+	numParked = 0;
+
+	if (readyQueue == NULL || zombieQueue == NULL) {
+		goto failQueues;
+	}
+
+	if (stats_start(uthread_shard_self()) == -1) {
+		goto failQueues;
+	}
+
+	if (remote_start() == -1) {
+		goto failQueues;
+	}
+
+	perf_start();
+
+	// One slot per possible TID, including the main thread's.
+	threadTable = calloc(USHRT_MAX + 1, sizeof(TCB*));
+	freeTIDs = malloc((USHRT_MAX + 1) * sizeof(uthread_t));
+
+	if (threadTable == NULL || freeTIDs == NULL) {
+		goto failTables;
+	}
 	
 	TCB* mainThread = newTCB(0);
 
-	// Context of the thread should be the current running process.
-
 	if (mainThread == NULL) {
-		return -1;
+		goto failTables;
+	}
+
+	// Context of the thread should be the current running process, which
+	// already has a stack of its own.
+	mainThread->context = malloc(sizeof(uthread_ctx_t));
+
+	if (mainThread->context == NULL) {
+		destroyTCB(mainThread);
+		goto failTables;
 	}
 
 	mainThread->status = RUNNING;
 	currentThread = mainThread;
 
 	return 0;
+
+	// Undo the steps above in reverse order.
+failTables:
+	free(threadTable);
+	free(freeTIDs);
+	threadTable = NULL;
+	freeTIDs = NULL;
+	perf_stop();
+	remote_stop();
+failQueues:
+	queue_destroy(readyQueue);
+	queue_destroy(zombieQueue);
+	readyQueue = NULL;
+	zombieQueue = NULL;
+	if (preempt == 1) {
+		preempt_stop();
+	}
+	sched_stop();
+	return -1;
 }
 
 int uthread_stop(void)
 {
-	// If uthread_stop not called by the main thread
-	if (currentThread->TID != 0)  {
+	// If uthread_stop not called by the main thread, or not started
+	if (currentThread == NULL || currentThread->TID != 0)  {
 		return -1;
 	}
 
-	// There are more threads to be run in the queue.
-	if (queue_length(readyQueue) > 0) {
+	// There are more threads to be run in the queue, or threads parked
+	// until a helper pthread finishes their blocking call or the kernel
+	// completes their I/O request, or a remote task still to create.
+	if (sched_length() > 0 || blocking_pending() > 0 ||
+	    uring_pending() > 0 || remote_held()) {
 		return -1;
 	} else {
 		// Ready queue is empty and can be destroyed.
 		queue_destroy(readyQueue);
+		sched_stop();
 
 		// Check zombie queue for any uncollected dead threads.
 		while (queue_length(zombieQueue) > 0) {
 			TCB* zombie = NULL;
 			queue_dequeue(zombieQueue, (void**)&zombie);
+			STATS_ADD(zombies, -1);
 			destroyTCB(zombie);			
 		}
 
 		queue_destroy(zombieQueue);
+		reapDetached();
+
+		// Release the spare task stack, if any.
+		if (runnerStack != NULL) {
+			uthread_ctx_destroy_stack(runnerStack);
+			runnerStack = NULL;
+		}
+		free(runnerContext);
+		runnerContext = NULL;
+		arena_stop();
+		alloc_release(currentThread);
+		alloc_stop();
+		locals_release(currentThread);
+		remote_stop();
+		perf_stop();
+
+		// No blocking call or I/O request is pending: no helper
+		// writes to its pipe, and the kernel is done with the ring.
+		blocking_stop();
+		uring_stop();
+
+		// The main thread keeps running on the process' stack, only its
+		// descriptor goes.
+		destroyTCB(currentThread);
+		currentThread = NULL;
+
+		free(threadTable);
+		free(freeTIDs);
+		threadTable = NULL;
+		freeTIDs = NULL;
 		return 0;
 	}
 	return -1;
@@ -125,33 +308,133 @@ int uthread_stop(void)
 
 int uthread_create(uthread_func_t func)
 {
+	int tid = allocTID();
+
 	// At maximum thread capacity
-	if (numTIDs == USHRT_MAX) {
-		return -1;	
+	if (tid == -1) {
+		return -1;
 	}
 
-	numTIDs++;
-
-	TCB* newThread = newTCB(numTIDs);
+	TCB* newThread = newTCB(tid);
 
 	if (newThread == NULL) {
+		releaseTID(tid);
 		return -1;
 	}
 
-	// Initialize the thread with a function
-	int initStatus = uthread_ctx_init(newThread->context, newThread->stack, func);
-
-	/** 
-	 * Enqueue the new thread or return an error code, 
-	 * based on success of uthread_ctx_init.
+	/*
+	 * Only remember the function: the stack and context are set up by
+	 * materializeThread() once the thread is first picked to run.
 	 */
-	if (initStatus == 0) {
-		newThread->status = READY;
-		queue_enqueue(readyQueue, newThread);
-		return newThread->TID;
-	} else {
+	newThread->func = func;
+	newThread->status = READY;
+	sched_enqueue(newThread);
+	STATS_ADD(creations, 1);
+
+	return newThread->TID;
+}
+
+int uthread_spawn_task(uthread_task_func_t func, void *arg)
+{
+	if (func == NULL) {
 		return -1;
 	}
+
+	int tid = allocTID();
+
+	// At maximum thread capacity
+	if (tid == -1) {
+		return -1;
+	}
+
+	TCB* newTask = newTCB(tid);
+
+	if (newTask == NULL) {
+		releaseTID(tid);
+		return -1;
+	}
+
+	// Started by taskRunner() on the spare stack, see materializeThread().
+	newTask->task = func;
+	newTask->taskArg = arg;
+	newTask->status = READY;
+	sched_enqueue(newTask);
+	STATS_ADD(creations, 1);
+
+	return newTask->TID;
+}
+
+/*
+ * materializeThread - Set up the stack and context of a thread
+ * @tcb: Thread about to run for the first time
+ *
+ * Tasks take the spare runner stack if there is one, and start in
+ * taskRunner().
+ *
+ * Return: 0 if @tcb can be switched to, -1 in case of failure (memory
+ * allocation, context creation).
+ */
+static int materializeThread(TCB* tcb)
+{
+	if (tcb->task != NULL && runnerContext != NULL) {
+		tcb->context = runnerContext;
+		tcb->stack = runnerStack;
+		runnerContext = NULL;
+		runnerStack = NULL;
+	} else {
+		tcb->context = malloc(sizeof(uthread_ctx_t));
+
+		if (tcb->context == NULL) {
+			return -1;
+		}
+
+		tcb->stack = uthread_ctx_alloc_stack();
+
+		if (tcb->stack == NULL) {
+			return -1;
+		}
+	}
+
+	if (tcb->task != NULL) {
+		return uthread_ctx_init(tcb->context, tcb->stack, taskRunner);
+	}
+
+	return uthread_ctx_init(tcb->context, tcb->stack, tcb->func);
+}
+
+/*
+ * finishThread - Mark a thread as dead
+ * @tcb: Thread that is done
+ * @retval: Return value of the thread
+ *
+ * The thread joining @tcb, if any, is made ready again. Otherwise, @tcb becomes
+ * a zombie until it gets collected.
+ */
+static void finishThread(TCB* tcb, int retval)
+{
+	tcb->status = DEAD;
+
+	// Save the return value
+	tcb->retVal = retval;
+	STATS_ADD(exits, 1);
+	sched_exit(tcb);
+
+	if (tcb->joinGroup != NULL) {
+		// Only the last thread of the group wakes the joining thread up.
+		if (--tcb->joinGroup->remaining == 0) {
+			uthread_unblock(tcb->joinedToThread);
+		}
+	} else if (tcb->joinedToThread != NULL) {
+		// Switch from BLOCKED to READY
+		uthread_unblock(tcb->joinedToThread);
+	} else if (tcb->detached) {
+		// Destroyed by reapDetached() once switched away from.
+		tcb->nextDetached = deadDetached;
+		deadDetached = tcb;
+	} else {
+		queue_enqueue(zombieQueue, tcb);
+		STATS_ADD(zombies, 1);
+	}
 }
 
 uthread_t uthread_self(void)
@@ -164,64 +447,329 @@ uthread_t uthread_self(void)
 	return currentThread->TID;
 }
 
-void uthread_yield(void)
+/*
+ * pollEvents - Collect completed blocking calls and I/O requests
+ *
+ * Threads whose calls completed are made ready, without waiting for the calls
+ * still in flight.
+ */
+static void pollEvents(void)
+{
+	if (blocking_pending() > 0) {
+		blocking_poll();
+	}
+
+	if (uring_pending() > 0) {
+		uring_poll();
+	}
+
+	shard_poll();
+	remote_poll();
+}
+
+/*
+ * reapDetached - Destroy the detached threads that exited
+ *
+ * The current thread may be one of them, still running on its own stack until
+ * it switches away: it is destroyed next time.
+ */
+static void reapDetached(void)
+{
+	TCB* keep = NULL;
+
+	while (deadDetached != NULL) {
+		TCB* tcb = deadDetached;
+		deadDetached = tcb->nextDetached;
+
+		if (tcb == currentThread) {
+			keep = tcb;
+			continue;
+		}
+
+		destroyTCB(tcb);
+	}
+
+	if (keep != NULL) {
+		keep->nextDetached = NULL;
+		deadDetached = keep;
+	}
+}
+
+/*
+ * waitForEvents - Wait until a blocking call or an I/O request completes
+ *
+ * Called when no thread is ready to run. Sleeps on the completion descriptors
+ * of the helper pool and of the I/O ring, and on the signals of the shard and
+ * remote inboxes, then collects completions.
+ */
+static void waitForEvents(void)
+{
+	struct pollfd pfds[4];
+	int nfds = 0;
+
+	if (shard_pending()) {
+		// A message arrived meanwhile, no need to wait.
+		if (shard_sleep() == -1) {
+			pollEvents();
+			return;
+		}
+
+		pfds[nfds++] = (struct pollfd){ .fd = shard_fd(), .events = POLLIN };
+	}
+
+	if (remote_pending()) {
+		if (remote_sleep() == -1) {
+			pollEvents();
+			return;
+		}
+
+		pfds[nfds++] = (struct pollfd){ .fd = remote_fd(), .events = POLLIN };
+	}
+
+	if (blocking_pending() > 0) {
+		pfds[nfds++] = (struct pollfd){ .fd = blocking_fd(), .events = POLLIN };
+	}
+
+	if (uring_pending() > 0) {
+		pfds[nfds++] = (struct pollfd){ .fd = uring_fd(), .events = POLLIN };
+	}
+
+	while (poll(pfds, nfds, -1) == -1 && errno == EINTR) {
+		// Interrupted by a signal, wait again.
+	}
+
+	pollEvents();
+}
+
+/*
+ * nextThread - Pick the next thread to run
+ * @wait: Whether to wait for pending calls if no thread is ready
+ * @yielding: Current thread if it is yielding, NULL otherwise
+ *
+ * Completed calls are collected first, so that their threads get a chance to
+ * run in this scheduling round. Prepared I/O requests are submitted at the end
+ * of the round, or as soon as the ready queue runs dry.
+ *
+ * A yielding thread is queued once its CPU time has been accounted for, so
+ * that the policy can pick it again if no other thread should run before it.
+ *
+ * Return: The next thread to run, removed from the ready queue, or NULL if
+ * there is none.
+ */
+static TCB* nextThread(int wait, TCB* yielding)
 {
 	TCB* next = NULL;
-	queue_dequeue(readyQueue, (void**)&next);
 
-	// Dequeue did not sufficiently work
-	if (next == NULL) {
-		return;
+	STATS_RUN_END(currentThread);
+	perf_switch(currentThread);
+	sched_run_end(currentThread);
+	pollEvents();
+
+	if (deadDetached != NULL) {
+		reapDetached();
 	}
 
-	uthread_ctx_t* from = currentThread->context;
-	uthread_ctx_t* to = next->context;
-	
-	currentThread->status = READY;
+	if (yielding != NULL) {
+		sched_enqueue(yielding);
+	}
 
-	next->status = RUNNING;
+	for (;;) {
+		while ((next = sched_dequeue()) == NULL) {
+			uring_submit();
 
-	queue_enqueue(readyQueue, currentThread);
+			// Nothing can make a thread ready anymore.
+			if (!wait || (blocking_pending() == 0 &&
+				      uring_pending() == 0 &&
+				      !shard_pending() && !remote_pending())) {
+				return NULL;
+			}
 
-	currentThread = next;
+			waitForEvents();
+		}
+
+		if (next->context != NULL) {
+			break;
+		}
+
+		// Task to be run in place of the task that just finished.
+		if (next->task != NULL && runnerChaining) {
+			break;
+		}
+
+		// First time this thread runs, it cannot if it gets no stack.
+		if (materializeThread(next) == 0) {
+			break;
+		}
+
+		finishThread(next, -1);
+	}
 
-	uthread_ctx_switch(from, to);
+	uring_dispatch();
+
+	return next;
 }
 
-// T1.join(T2, NULL);
-// T2
-void uthread_exit(int retval)
+/*
+ * dispatchThread - Make thread @next the running thread
+ * @next: Thread to run, already removed from the ready queue
+ */
+static void dispatchThread(TCB* next)
 {
-	// retval is a function which returns a value of int
-	// that integer needs to saved into retval
-	currentThread->status = DEAD;
+	next->status = RUNNING;
+	currentThread = next;
+	STATS_DISPATCH(next);
+	sched_run_start(next);
+}
 
-	// Save the return value
-	currentThread->retVal = retval;
+/*
+ * switchThread - Switch execution to thread @next
+ * @next: Thread to run, already removed from the ready queue
+ *
+ * The caller is responsible for setting the status of the current thread, and
+ * queueing it if needed, beforehand.
+ */
+static void switchThread(TCB* next)
+{
+	TCB* prev = currentThread;
 
-	if (currentThread->joinedToThread != NULL) {
-		// Switch from BLOCKED to READY
-		currentThread->joinedToThread->status = READY;
-		queue_enqueue(readyQueue, currentThread->joinedToThread);
-	} else {
-		queue_enqueue(zombieQueue, currentThread);
+	dispatchThread(next);
+
+	// A blocked thread may have been woken up before anybody else was ready.
+	if (next != prev) {
+		STATS_ADD(switches, 1);
+		uthread_ctx_switch(prev->context, next->context);
 	}
+}
 
-	uthread_yield();
+/*
+ * taskRunner - Run tasks back to back on the same stack
+ *
+ * Entry point of a task's context. Once the task returns, the next thread is
+ * picked right away: if it is a task that has not started yet, it is simply
+ * called from here, on the same stack, without any context switch. Otherwise
+ * the stack becomes the spare runner stack again and the next thread is
+ * switched to.
+ *
+ * A task that blocked or yielded at some point still ends up here, and its
+ * stack, which it kept in the meantime, is reused just the same.
+ */
+static int taskRunner(void)
+{
+	for (;;) {
+		TCB* task = currentThread;
+		int retval = task->task(task->taskArg);
+
+		locals_exit(task);
+		finishThread(task, retval);
+
+		runnerChaining = 1;
+		TCB* next = nextThread(1, NULL);
+		runnerChaining = 0;
+
+		// Nothing left to run, same as returning with no successor context.
+		if (next == NULL) {
+			exit(0);
+		}
+
+		dispatchThread(next);
+
+		if (next->context == NULL) {
+			// Hand the stack over to the next task and run it in place.
+			next->context = task->context;
+			next->stack = task->stack;
+			task->context = NULL;
+			task->stack = NULL;
+			continue;
+		}
+
+		uthread_ctx_t* context = task->context;
+
+		// Keep the stack as the spare one, the finished task no longer
+		// needs it once switched away from.
+		if (runnerContext == NULL) {
+			runnerContext = task->context;
+			runnerStack = task->stack;
+			task->context = NULL;
+			task->stack = NULL;
+		}
+
+		STATS_ADD(switches, 1);
+		uthread_ctx_switch(context, next->context);
+	}
 }
 
-int findThread(queue_t q, void* thr, void* tid) {
-	TCB* thread = (TCB*)thr;
-	uthread_t match = (uthread_t)(long)tid;
-	(void)q;
+int uthread_block(void)
+{
+	currentThread->status = BLOCKED;
+
+	TCB* next = nextThread(1, NULL);
 
-	if (thread->TID == match) {
-		return 1;
+	// Nothing left to run, the thread would never be unblocked.
+	if (next == NULL) {
+		currentThread->status = RUNNING;
+		return -1;
 	}
 
+	switchThread(next);
 	return 0;
 }
 
+void uthread_unblock(TCB* tcb)
+{
+	tcb->status = READY;
+	STATS_WAIT_START(tcb);
+	sched_enqueue(tcb);
+}
+
+static int markReady(queue_t threads, void *data, void *arg)
+{
+	TCB* tcb = data;
+
+	(void)threads;
+	(void)arg;
+
+	tcb->status = READY;
+	STATS_WAIT_START(tcb);
+	return 0;
+}
+
+void uthread_unblock_all(queue_t threads)
+{
+	queue_iterate(threads, markReady, NULL, NULL);
+	sched_enqueue_all(threads);
+}
+
+void uthread_yield(void)
+{
+	currentThread->status = READY;
+
+	TCB* next = nextThread(0, currentThread);
+
+	// No other thread should run before this one, keep running.
+	if (next == currentThread) {
+		currentThread->status = RUNNING;
+		sched_run_start(currentThread);
+		return;
+	}
+
+	switchThread(next);
+}
+
+// T1.join(T2, NULL);
+// T2
+void uthread_exit(int retval)
+{
+	locals_exit(currentThread);
+	finishThread(currentThread, retval);
+
+	// A dead thread must not go back into the ready queue.
+	TCB* next = nextThread(1, NULL);
+
+	if (next != NULL) {
+		switchThread(next);
+	}
+}
+
 int uthread_join(uthread_t tid, int *retval)
 {
 	// Thread cannot join main thread or itself.
@@ -229,72 +777,191 @@ int uthread_join(uthread_t tid, int *retval)
 		return -1;
 	}
 
-	TCB* searchThread = NULL;
-
-	queue_iterate(zombieQueue, findThread, (void*)(long)tid, (void**)&searchThread);
+	// Threads blocked in a blocking call or a join are in no queue, so
+	// look the TID up directly.
+	TCB* searchThread = threadTable[tid];
 
-	if (searchThread != NULL) {
+	// Thread @tid cannot be found.
+	if (searchThread == NULL) {
+		return -1;
+	}
 
-		// Target thread @tid already joined.
-		if (searchThread->joinedToThread != NULL) {
-			return -1;				
-		}
+	// Target thread @tid already joined, or detached.
+	if (searchThread->joinedToThread != NULL || searchThread->detached) {
+		return -1;
+	}
 
+	if (searchThread->status == DEAD) {
 		// Store return value of zombie thread if needed.
 		if (retval != NULL) {
 			*retval = searchThread->retVal;
 		}
 
 		queue_delete(zombieQueue, searchThread);
+		STATS_ADD(zombies, -1);
+		STATS_ADD(joins, 1);
 		destroyTCB(searchThread);
 		return 0;
 	}
 
-	queue_iterate(readyQueue, findThread, (void*)(long)tid, (void**)&searchThread);
-	//return queue_length(readyQueue);
+	searchThread->joinedToThread = currentThread;
 
-	if (searchThread != NULL) {
+	/* Block until @tid exits, uthread_exit() unblocks the joining thread */
+	if (uthread_block() == -1) {
+		searchThread->joinedToThread = NULL;
+		return -1;
+	}
 
-		// Target thread @tid already joined.
-		if (searchThread->joinedToThread != NULL) {
-			return -1;				
-		}
+	// Store the return value of the joined thread if needed.
+	if (retval != NULL) {
+		*retval = searchThread->retVal;
+	}
 
-		currentThread->status = BLOCKED;
-		// Allocate sufficient space to store address to current TCB.
-		searchThread->joinedToThread = malloc(sizeof(TCB));
-		searchThread->joinedToThread = currentThread;
+	STATS_ADD(joins, 1);
+	destroyTCB(searchThread);
+	return 0;
+}
 
-		/* yield() without putting current thread back into queue as it is blocked */
+int uthread_join_all(uthread_t *tids, int count, int *retvals)
+{
+	if (tids == NULL || count < 0) {
+		return -1;
+	}
 
-		TCB* next = NULL;
-        	queue_dequeue(readyQueue, (void**)&next);
+	if (count == 0) {
+		return 0;
+	}
 
-        	// Dequeue did not sufficiently work
-        	if (next == NULL) {
-                	return -1;
-        	}
+	TCB** targets = malloc(count * sizeof(TCB*));
 
-        	uthread_ctx_t* from = currentThread->context;
-        	uthread_ctx_t* to = next->context;
+	if (targets == NULL) {
+		return -1;
+	}
 
-        	currentThread->status = BLOCKED;
+	// Claim every thread first, so that a duplicate or an already joined
+	// TID is caught before anything is collected.
+	for (int i = 0; i < count; i++) {
+		TCB* target = NULL;
 
-        	next->status = RUNNING;
+		if (tids[i] != 0 && tids[i] != currentThread->TID) {
+			target = threadTable[tids[i]];
+		}
 
-        	currentThread = next;
+		if (target == NULL || target->joinedToThread != NULL ||
+		    target->detached) {
+			while (--i >= 0) {
+				targets[i]->joinedToThread = NULL;
+			}
+			free(targets);
+			return -1;
+		}
 
-        	uthread_ctx_switch(from, to);
+		target->joinedToThread = currentThread;
+		targets[i] = target;
+	}
 
-		// Store the return value of the joined thread if needed.
-		if (retval != NULL) {
-			*retval = searchThread->retVal;
+	struct join_group group = { .remaining = 0 };
+
+	for (int i = 0; i < count; i++) {
+		if (targets[i]->status == DEAD) {
+			// Already a zombie, collected below with the others.
+			queue_delete(zombieQueue, targets[i]);
+			STATS_ADD(zombies, -1);
+		} else {
+			targets[i]->joinGroup = &group;
+			group.remaining++;
 		}
+	}
 
-		destroyTCB(searchThread);
+	/* Block once, the last thread of the group to exit unblocks us */
+	if (group.remaining > 0 && uthread_block() == -1) {
+		for (int i = 0; i < count; i++) {
+			if (targets[i]->status != DEAD) {
+				targets[i]->joinedToThread = NULL;
+				targets[i]->joinGroup = NULL;
+			} else {
+				queue_enqueue(zombieQueue, targets[i]);
+				STATS_ADD(zombies, 1);
+				targets[i]->joinedToThread = NULL;
+			}
+		}
+		free(targets);
+		return -1;
+	}
+
+	// Every thread is dead now, collect them all in a single pass.
+	for (int i = 0; i < count; i++) {
+		if (retvals != NULL) {
+			retvals[i] = targets[i]->retVal;
+		}
+
+		destroyTCB(targets[i]);
+	}
+
+	STATS_ADD(joins, count);
+	free(targets);
+	return 0;
+}
+
+int uthread_detach(uthread_t tid)
+{
+	if (tid == 0 || threadTable[tid] == NULL) {
+		return -1;
+	}
+
+	TCB* tcb = threadTable[tid];
+
+	// Already joined or detached.
+	if (tcb->joinedToThread != NULL || tcb->detached) {
+		return -1;
+	}
+
+	if (tcb->status == DEAD) {
+		queue_delete(zombieQueue, tcb);
+		STATS_ADD(zombies, -1);
+		destroyTCB(tcb);
 		return 0;
 	}
 
-	// Thread @tid cannot be found.
-	return -1;
-}
\ No newline at end of file
+	tcb->detached = 1;
+	return 0;
+}
+
+int uthread_park(void)
+{
+	// Woken up before getting here, consume the wakeup.
+	if (currentThread->wakeToken) {
+		currentThread->wakeToken = 0;
+		return 0;
+	}
+
+	currentThread->parked = 1;
+	numParked++;
+
+	int ret = uthread_block();
+
+	numParked--;
+	if (ret == -1) {
+		currentThread->parked = 0;
+	}
+
+	return ret;
+}
+
+int uthread_unpark(uthread_t tid)
+{
+	TCB* tcb = threadTable[tid];
+
+	if (tcb == NULL || tcb->status == DEAD) {
+		return -1;
+	}
+
+	if (tcb->parked) {
+		tcb->parked = 0;
+		uthread_unblock(tcb);
+	} else {
+		tcb->wakeToken = 1;
+	}
+
+	return 0;
+}
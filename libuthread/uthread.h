@@ -1,6 +1,9 @@
 #ifndef _UTHREAD_H
 #define _UTHREAD_H
 
+#include <stdio.h>
+#include <sys/types.h>
+
 #include "queue.h"
 
 /*
@@ -8,9 +11,10 @@
  *
  * Each user thread is assigned a different TID. TID are assigned in increasing
  * order and numbered starting from 1 (apart from the 'main' thread who
- * automatically gets TID #0). Overflowing the current TID value is considered a
- * case of failure (in other words, it is impossible to create more than
- * USHRT_MAX threads).
+ * automatically gets TID #0). Once USHRT_MAX TIDs were assigned, the TIDs of
+ * threads that were destroyed, i.e., joined, or exited if detached, are
+ * reused, oldest first. Having more than USHRT_MAX threads alive at once is
+ * considered a case of failure.
  */
 typedef unsigned short uthread_t;
 
@@ -35,12 +39,118 @@ typedef int (*uthread_func_t)(void);
  */
 int uthread_start(int preempt);
 
+/* Scheduling policies */
+#define UTHREAD_SCHED_FIFO 0 /* Ready threads run in turn (default) */
+#define UTHREAD_SCHED_FAIR 1 /* Lowest weighted CPU time runs first */
+#define UTHREAD_SCHED_MLFQ 2 /* Multi-level feedback queue */
+#define UTHREAD_SCHED_EDF 3 /* Earliest deadline first */
+
+/* Priorities used by UTHREAD_SCHED_MLFQ */
+#define UTHREAD_PRIO_HIGHEST 0
+#define UTHREAD_PRIO_LOWEST 7
+
+/*
+ * uthread_start_sched - Start the multithreading library with a given policy
+ * @preempt: Preemption enable
+ * @policy: Scheduling policy
+ *
+ * Same as uthread_start(), but selects the policy deciding which ready thread
+ * runs next:
+ *
+ * - UTHREAD_SCHED_FIFO: threads run in the order they became ready. This is
+ *   the policy used by uthread_start().
+ * - UTHREAD_SCHED_FAIR: the CPU time used by each thread is accounted at every
+ *   switch, scaled down by the weight of the thread, and the thread with the
+ *   lowest such virtual runtime runs next. Picking a thread is O(log n).
+ * - UTHREAD_SCHED_MLFQ: ready threads are kept in one queue per priority
+ *   level, and the highest non-empty level runs first. A thread that used up
+ *   the time quantum of its level, over one or several turns, moves one level
+ *   down; the quantum doubles at each level. Periodically, every thread is
+ *   moved back to its priority level, so that low levels are not starved.
+ *   Without preemption, the time used is only checked when the thread yields
+ *   or blocks.
+ * - UTHREAD_SCHED_EDF: ready threads with a deadline run first, earliest
+ *   deadline first, kept in a binary heap. Threads without a deadline run
+ *   after them, in FIFO order.
+ *
+ * A yielding thread keeps running if the policy does not let any ready thread
+ * run before it.
+ * Return: 0 in case of success, -1 in case of failure (e.g., unknown policy,
+ * memory allocation).
+ */
+int uthread_start_sched(int preempt, int policy);
+
+/*
+ * uthread_set_weight - Set the CPU share of a thread
+ * @tid: TID of the thread
+ * @weight: Weight of the thread, 1024 by default
+ *
+ * Under UTHREAD_SCHED_FAIR, threads get CPU time in proportion to their
+ * weight. The weight is ignored by other policies.
+ *
+ * Return: -1 if @weight is not positive or if thread @tid cannot be found. 0
+ * otherwise.
+ */
+int uthread_set_weight(uthread_t tid, int weight);
+
+/*
+ * uthread_set_priority - Set the priority of a thread
+ * @tid: TID of the thread
+ * @prio: Priority, from UTHREAD_PRIO_HIGHEST (default) to UTHREAD_PRIO_LOWEST
+ *
+ * Under UTHREAD_SCHED_MLFQ, the thread moves to level @prio right away, and
+ * comes back to it at every priority boost. It is ignored by other policies.
+ *
+ * Return: -1 if @prio is out of range or if thread @tid cannot be found. 0
+ * otherwise.
+ */
+int uthread_set_priority(uthread_t tid, int prio);
+
+/*
+ * uthread_set_deadline - Set the deadline of a thread
+ * @tid: TID of the thread
+ * @deadline: Absolute time on CLOCK_MONOTONIC, in nanoseconds, 0 for none
+ *
+ * The previous deadline of the thread, if any, is considered met if it has
+ * not passed yet, and missed otherwise. The same goes for the deadline of a
+ * thread that exits. A thread typically sets a new deadline each time it
+ * starts working on a request, and clears it when idle.
+ *
+ * Deadlines order ready threads under UTHREAD_SCHED_EDF, but misses are
+ * counted under every policy.
+ *
+ * Return: -1 if thread @tid cannot be found, 0 otherwise.
+ */
+int uthread_set_deadline(uthread_t tid, unsigned long long deadline);
+
+/*
+ * uthread_deadline_misses - Number of deadlines missed since uthread_start()
+ */
+unsigned long long uthread_deadline_misses(void);
+
+/*
+ * uthread_stack_arena - Carve thread stacks out of huge pages
+ * @enable: 1 to take new stacks from the arena, 0 to allocate them with malloc()
+ *
+ * With the arena enabled, stacks are packed back to back in 2 MiB pages: an
+ * explicit huge page if the system has any reserved, a transparent huge page
+ * otherwise. Many threads then share a handful of TLB entries, which cuts TLB
+ * misses when switching among tens of thousands of threads. Each scheduler has
+ * its own arena, released by uthread_stop(); stacks freed go back to it.
+ *
+ * The arena is disabled by default, and can be enabled or disabled at any
+ * time, affecting the stacks allocated afterwards.
+ */
+void uthread_stack_arena(int enable);
+
 /*
  * uthread_stop - Stop the multithreading library
  *
  * This function should only be called by the main execution thread of the
  * process. It stops the multithreading scheduling library if there are no more
- * user threads.
+ * user threads. Threads still waiting for a uthread_blocking_call() or for an
+ * I/O request count as user threads, and so does a task accepted by
+ * uthread_submit_remote() that could not be created yet.
  *
  * Return: 0 in case of success, -1 in case of failure.
  */
@@ -53,11 +163,168 @@ int uthread_stop(void);
  * This function creates a new thread running the function @func and returns the
  * TID of this new thread.
  *
- * Return: -1 in case of failure (memory allocation, context creation, TID
- * overflow, etc.), or the TID of the new thread.
+ * Only a small descriptor is allocated here, about 400 bytes per pending thread
+ * on x86-64. The stack and execution context of the thread are set up when it
+ * is first scheduled. If that fails, the thread
+ * exits right away with a return value of -1.
+ *
+ * Return: -1 in case of failure (memory allocation, USHRT_MAX threads alive,
+ * etc.), or the TID of the new thread.
  */
 int uthread_create(uthread_func_t func);
 
+/*
+ * uthread_task_func_t - Task function type
+ * @arg: Argument given to uthread_spawn_task()
+ *
+ * Return: Integer value
+ */
+typedef int (*uthread_task_func_t)(void *arg);
+
+/*
+ * uthread_spawn_task - Create a new run-to-completion task
+ * @func: Function to be executed by the task
+ * @arg: Argument passed to @func
+ *
+ * This function creates a task, a lightweight thread meant for short units of
+ * work which do not yield or block. When a task reaches the head of the ready
+ * queue, it runs on a stack shared by all tasks. Consecutive tasks run back to
+ * back on that stack, each costing little more than a function call.
+ *
+ * A task may still yield, block or call uthread_exit(): it then keeps the
+ * shared stack for itself and goes on as a regular thread. Tasks have a TID and
+ * can be joined like any other thread, the return value of @func being their
+ * return value. The TID of a detached task is reused once it finished, so
+ * there is no limit to the number of tasks spawned over time.
+ *
+ * Return: -1 if @func is NULL or in case of failure (memory allocation,
+ * USHRT_MAX threads alive, etc.), or the TID of the new task.
+ */
+int uthread_spawn_task(uthread_task_func_t func, void *arg);
+
+/*
+ * uthread_start_sharded - Start the library in thread-per-core mode
+ * @ncores: Number of shards, at most 64
+ *
+ * Runs @ncores independent schedulers, called shards, each on its own kernel
+ * thread pinned to a CPU. The calling kernel thread becomes shard 0, and its
+ * thread becomes the main thread of that shard, as with uthread_start(). The
+ * other shards sit idle until given work with uthread_shard_submit().
+ *
+ * Each shard has its own ready queue, TIDs and policy state, and threads never
+ * move from one shard to another: a TID is only meaningful on its shard.
+ * Shards communicate through one single-producer single-consumer mailbox per
+ * pair of shards, drained once per scheduling round, so no lock is shared on
+ * the scheduling path. An idle shard sleeps until it receives a message.
+ *
+ * Since a message from another shard may make any thread ready at any time, a
+ * blocking function never fails because no other thread of the shard could
+ * wake the caller up, as it does when not sharded: the shard sleeps until a
+ * message arrives instead. A deadlock within a shard hangs rather than being
+ * reported.
+ *
+ * Return: 0 in case of success, -1 in case of failure (e.g., @ncores out of
+ * range, already started, memory allocation).
+ */
+int uthread_start_sharded(int ncores);
+
+/*
+ * uthread_stop_sharded - Stop thread-per-core mode
+ *
+ * Must be called by the main thread of shard 0, once all the work is done.
+ * Every other shard lets its ready threads, and those waiting for a blocking
+ * call or an I/O request, finish and stops. Shard 0 then runs the tasks the
+ * others submitted to it meanwhile, and stops like with uthread_stop(). Work
+ * submitted to another shard once it was told to stop may be dropped, and is
+ * refused once it stopped.
+ *
+ * Return: 0 in case of success, -1 otherwise (e.g., not called by the main
+ * thread of shard 0, threads still ready on shard 0).
+ */
+int uthread_stop_sharded(void);
+
+/*
+ * uthread_shard_self - Get the shard of the calling thread
+ *
+ * Return: The index of the shard, 0 when not in thread-per-core mode.
+ */
+int uthread_shard_self(void);
+
+/*
+ * uthread_shard_submit - Run a task on a given shard
+ * @shard: Index of the shard
+ * @func: Function to be executed by the task
+ * @arg: Argument to be passed to the task
+ *
+ * The task is created detached on shard @shard, once that shard picks the
+ * message up. If shard @shard cannot create the task yet (USHRT_MAX threads
+ * alive, memory allocation), the message waits in the mailbox, along with the
+ * messages sent after it, until it can.
+ *
+ * The mailbox to each shard holds 256 messages. When it is full, the call fails
+ * rather than waiting: the caller may yield, park or do other work before
+ * trying again.
+ *
+ * Return: -1 if not in thread-per-core mode, if @shard is out of range or
+ * stopped, if @func is NULL, if the mailbox to @shard is full, or if @shard is
+ * the calling shard and the task cannot be created. 0 otherwise.
+ */
+int uthread_shard_submit(int shard, uthread_task_func_t func, void *arg);
+
+/*
+ * uthread_shard_wake - Wake a parked thread up on a given shard
+ * @shard: Index of the shard
+ * @tid: TID of the thread on shard @shard
+ *
+ * Same as uthread_unpark(), for a thread of any shard.
+ *
+ * Return: -1 if not in thread-per-core mode, if @shard is out of range or
+ * stopped, or if the mailbox to @shard is full, see uthread_shard_submit(). 0
+ * otherwise.
+ */
+int uthread_shard_wake(int shard, uthread_t tid);
+
+/*
+ * uthread_wake_remote - Wake a parked thread up from another kernel thread
+ * @tid: TID of the thread to wake up
+ *
+ * Same as uthread_unpark(), but may be called from any pthread or signal
+ * handler: the request is posted to a lock-free inbox and carried out by the
+ * scheduler in its next round, which is woken up if it sleeps. Targets the
+ * first scheduler started, i.e., shard 0 in thread-per-core mode.
+ *
+ * Async-signal-safe. Racing with uthread_stop(), the request either fails or
+ * is dropped.
+ *
+ * Return: -1 if no scheduler is running or if the inbox is full. 0 otherwise,
+ * even if @tid turns out not to be a live thread.
+ */
+int uthread_wake_remote(uthread_t tid);
+
+/*
+ * uthread_submit_remote - Run a task from another kernel thread
+ * @func: Function to be executed by the task
+ * @arg: Argument to be passed to the task
+ *
+ * Same as uthread_spawn_task() followed by uthread_detach(), but may be called
+ * from any pthread or signal handler, see uthread_wake_remote().
+ *
+ * A scheduler with no thread ready only waits for remote messages while one of
+ * its threads is parked: the main thread should park to wait for submitted
+ * work.
+ *
+ * If the scheduler cannot create the task yet (USHRT_MAX threads alive, memory
+ * allocation), it tries again every scheduling round, and the requests posted
+ * after it wait meanwhile.
+ *
+ * Async-signal-safe. Racing with uthread_stop(), the request either fails or
+ * is dropped.
+ *
+ * Return: -1 if no scheduler is running, if the inbox is full or if @func is
+ * NULL. 0 otherwise.
+ */
+int uthread_submit_remote(uthread_task_func_t func, void *arg);
+
 /*
  * uthread_self - Get thread identifier
  *
@@ -106,4 +373,605 @@ void uthread_exit(int retval);
  */
 int uthread_join(uthread_t tid, int *retval);
 
+/*
+ * uthread_alloc - Allocate memory for the calling thread
+ * @size: Size in bytes
+ *
+ * Memory is carved from an arena owned by the calling thread, which is
+ * released at once when the thread is destroyed, i.e., when it is joined, or
+ * when it exits if detached. It cannot be freed before, nor used afterwards.
+ * This suits the many small allocations of short-lived threads, which then
+ * cost a pointer bump each and no call to free(). Arenas are made of chunks
+ * recycled among the threads of the scheduler.
+ *
+ * Memory of the main thread is released by uthread_stop().
+ *
+ * Return: Memory aligned like malloc()'s, NULL if called outside of a thread,
+ * if @size is 0 or in case of failure (memory allocation).
+ */
+void *uthread_alloc(size_t size);
+
+/* Maximum number of thread-local keys */
+#define UTHREAD_KEYS_MAX 128
+
+/*
+ * uthread_key_create - Create a thread-local storage key
+ * @destructor: (Optional) Function called on the value of the key when a
+ *	thread exits, unless the value is NULL
+ *
+ * Every thread, on every shard, then holds a value for the key, NULL until
+ * set. Values of the first keys are stored in the TCB itself, those of the
+ * others in an array allocated by the first uthread_setspecific() of a thread
+ * beyond them: either way, access is an index and a load.
+ *
+ * Destructors run on the exiting thread, from uthread_exit() or when its
+ * function returns. A destructor may set values again, in which case
+ * destructors run again, up to 4 rounds. Keys cannot be deleted.
+ *
+ * Return: The new key, -1 if UTHREAD_KEYS_MAX keys were already created.
+ */
+int uthread_key_create(void (*destructor)(void *));
+
+/*
+ * uthread_getspecific - Get the value of a key for the calling thread
+ * @key: Key returned by uthread_key_create()
+ *
+ * Return: The value, NULL if none was set, if @key is invalid or if called
+ * outside of a thread.
+ */
+void *uthread_getspecific(int key);
+
+/*
+ * uthread_setspecific - Set the value of a key for the calling thread
+ * @key: Key returned by uthread_key_create()
+ * @value: New value
+ *
+ * Return: -1 if @key is invalid, if called outside of a thread or in case of
+ * failure (memory allocation). 0 otherwise.
+ */
+int uthread_setspecific(int key, const void *value);
+
+/*
+ * uthread_detach - Detach a thread
+ * @tid: TID of the thread to detach
+ *
+ * The resources of a detached thread are released as soon as it exits, and it
+ * can no longer be joined. A thread that already exited is released right
+ * away.
+ *
+ * Return: -1 if thread @tid cannot be found, is the main thread, or is already
+ * joined or detached. 0 otherwise.
+ */
+int uthread_detach(uthread_t tid);
+
+/*
+ * uthread_park - Block the calling thread until woken up
+ *
+ * Returns at once if the thread was woken up with uthread_unpark() since it
+ * last parked, consuming that wakeup. Several wakeups before a park count as
+ * one.
+ *
+ * Return: -1 if no other thread could ever wake the calling thread up, 0
+ * otherwise. On the scheduler that uthread_wake_remote() targets, another
+ * kernel thread always could: the call waits instead of failing.
+ */
+int uthread_park(void);
+
+/*
+ * uthread_unpark - Wake a parked thread up
+ * @tid: TID of the thread to wake up
+ *
+ * If thread @tid is not parked, its next call to uthread_park() returns at
+ * once.
+ *
+ * Return: -1 if thread @tid cannot be found or already exited, 0 otherwise.
+ */
+int uthread_unpark(uthread_t tid);
+
+/*
+ * uthread_join_all - Join several threads at once
+ * @tids: Array of TIDs of the threads to join
+ * @count: Number of TIDs in @tids
+ * @retvals: (Optional) Array of @count integers receiving the return values
+ *
+ * This function makes the calling thread wait for all the threads in @tids to
+ * complete, and assigns the return value of thread @tids[i] to @retvals[i] (if
+ * @retvals is not NULL). Unlike calling uthread_join() on each thread in turn,
+ * the calling thread is blocked and woken up only once, when the last of the
+ * threads exits.
+ *
+ * Return: -1 if @tids is NULL, if @count is negative, or if any of the TIDs
+ * could not be joined with uthread_join() (including a TID appearing twice),
+ * in which case no thread is joined. 0 otherwise.
+ */
+int uthread_join_all(uthread_t *tids, int count, int *retvals);
+
+/*
+ * uthread_wg_t - Wait group type
+ *
+ * A wait group lets threads wait for a collection of tasks to finish. The
+ * counter of the group is raised with uthread_wg_add() before starting tasks,
+ * and lowered with uthread_wg_done() as each task finishes. Threads calling
+ * uthread_wg_wait() are blocked until the counter drops to 0.
+ */
+typedef struct uthread_wg* uthread_wg_t;
+
+/*
+ * uthread_wg_create - Allocate a wait group
+ *
+ * Return: Pointer to new wait group with a counter of 0. NULL in case of
+ * failure when allocating the new wait group.
+ */
+uthread_wg_t uthread_wg_create(void);
+
+/*
+ * uthread_wg_destroy - Deallocate a wait group
+ * @wg: Wait group to deallocate
+ *
+ * Return: -1 if @wg is NULL or if threads are still waiting on @wg. 0 if @wg
+ * was successfully destroyed.
+ */
+int uthread_wg_destroy(uthread_wg_t wg);
+
+/*
+ * uthread_wg_add - Add to the counter of a wait group
+ * @wg: Wait group
+ * @delta: Value to add to the counter, possibly negative
+ *
+ * If the counter drops to 0, all the threads waiting on @wg are unblocked.
+ *
+ * Return: -1 if @wg is NULL or if the counter would become negative. 0
+ * otherwise.
+ */
+int uthread_wg_add(uthread_wg_t wg, int delta);
+
+/*
+ * uthread_wg_done - Decrement the counter of a wait group
+ * @wg: Wait group
+ *
+ * Same as uthread_wg_add(@wg, -1).
+ *
+ * Return: -1 if @wg is NULL or if the counter is already 0. 0 otherwise.
+ */
+int uthread_wg_done(uthread_wg_t wg);
+
+/*
+ * uthread_wg_wait - Wait for the counter of a wait group to drop to 0
+ * @wg: Wait group
+ *
+ * Return: -1 if @wg is NULL, in case of memory allocation error, or if no other
+ * thread could ever lower the counter. 0 once the counter is 0.
+ */
+int uthread_wg_wait(uthread_wg_t wg);
+
+/*
+ * uthread_barrier_t - Barrier type
+ *
+ * A barrier makes a fixed number of threads wait for each other at the end of
+ * each phase of a computation. Threads calling uthread_barrier_wait() are
+ * blocked, off the ready queue, until the last one arrives. The last one
+ * releases them all at once and the barrier is ready for the next phase.
+ */
+typedef struct uthread_barrier* uthread_barrier_t;
+
+/*
+ * uthread_barrier_create - Allocate a barrier
+ * @count: Number of threads meeting at each phase
+ *
+ * Return: Pointer to new barrier. NULL if @count is lower than 1, or in case
+ * of failure when allocating the new barrier.
+ */
+uthread_barrier_t uthread_barrier_create(int count);
+
+/*
+ * uthread_barrier_destroy - Deallocate a barrier
+ * @barrier: Barrier to deallocate
+ *
+ * Return: -1 if @barrier is NULL or if threads are still waiting on @barrier.
+ * 0 if @barrier was successfully destroyed.
+ */
+int uthread_barrier_destroy(uthread_barrier_t barrier);
+
+/*
+ * uthread_barrier_wait - Wait for all threads to reach a barrier
+ * @barrier: Barrier
+ *
+ * Return: -1 if @barrier is NULL, in case of memory allocation error, or if no
+ * other thread could ever reach the barrier, in which case the calling thread
+ * did not count as arrived. 1 for the last thread to arrive, which did not block, and 0 for the
+ * others once released.
+ */
+int uthread_barrier_wait(uthread_barrier_t barrier);
+
+/*
+ * uthread_latch_t - Countdown latch type
+ *
+ * A latch lets threads wait until a number of events happened. It starts with
+ * a count, lowered with uthread_latch_count_down() as each event happens.
+ * Threads calling uthread_latch_wait() are blocked until the count drops to
+ * 0, then all released at once. Unlike a wait group, a latch opens only once.
+ */
+typedef struct uthread_latch* uthread_latch_t;
+
+/*
+ * uthread_latch_create - Allocate a countdown latch
+ * @count: Number of count downs opening the latch
+ *
+ * Return: Pointer to new latch, already open if @count is 0. NULL if @count
+ * is negative, or in case of failure when allocating the new latch.
+ */
+uthread_latch_t uthread_latch_create(int count);
+
+/*
+ * uthread_latch_destroy - Deallocate a countdown latch
+ * @latch: Latch to deallocate
+ *
+ * Return: -1 if @latch is NULL or if threads are still waiting on @latch. 0
+ * if @latch was successfully destroyed.
+ */
+int uthread_latch_destroy(uthread_latch_t latch);
+
+/*
+ * uthread_latch_count_down - Lower the count of a countdown latch
+ * @latch: Latch
+ *
+ * If the count drops to 0, all the threads waiting on @latch are unblocked.
+ *
+ * Return: -1 if @latch is NULL or if the count is already 0. 0 otherwise.
+ */
+int uthread_latch_count_down(uthread_latch_t latch);
+
+/*
+ * uthread_latch_wait - Wait for the count of a countdown latch to drop to 0
+ * @latch: Latch
+ *
+ * Return: -1 if @latch is NULL, in case of memory allocation error, or if no
+ * other thread could ever lower the count. 0 once the count is 0.
+ */
+int uthread_latch_wait(uthread_latch_t latch);
+
+/*
+ * uthread_blocking_func_t - Blocking call function type
+ * @arg: Argument given to uthread_blocking_call()
+ *
+ * Return: Long integer value
+ */
+typedef long (*uthread_blocking_func_t)(void *arg);
+
+/*
+ * uthread_blocking_call - Run a blocking call without stalling other threads
+ * @func: Function performing the blocking call (e.g. fsync(), getaddrinfo())
+ * @arg: Argument passed to @func
+ *
+ * This function ships @func to a small pool of helper kernel threads, blocks
+ * the calling thread and lets the other threads run in the meantime. The
+ * calling thread becomes ready again once @func has returned.
+ *
+ * @func runs on another kernel thread: it must not call any uthread function.
+ * The value of errno set by @func is carried back to the calling thread. If the
+ * helper pool cannot be started, @func is simply called in place.
+ *
+ * Return: -1 with errno set to EINVAL if @func is NULL. Return value of @func
+ * otherwise.
+ */
+long uthread_blocking_call(uthread_blocking_func_t func, void *arg);
+
+/*
+ * uthread_pread - Read from a file without stalling other threads
+ * @fd: File descriptor to read from
+ * @buf: Buffer receiving the data
+ * @count: Number of bytes to read
+ * @offset: File offset to read at
+ *
+ * Same as pread(), except that only the calling thread is blocked while the
+ * read is in progress. Requests issued by all the threads that block within the
+ * same scheduling round are submitted to the kernel together through io_uring.
+ * Where io_uring is unavailable or lacks reads and writes (before Linux 5.6),
+ * or if the UTHREAD_IO_URING environment variable is set to 0, the read goes
+ * through uthread_blocking_call(). If the kernel stops accepting requests, the
+ * requests not yet submitted fail with its errno, and later ones go through
+ * uthread_blocking_call() until the library is restarted.
+ *
+ * Return: Number of bytes read, or -1 with errno set in case of failure.
+ */
+ssize_t uthread_pread(int fd, void *buf, size_t count, off_t offset);
+
+/*
+ * uthread_pwrite - Write to a file without stalling other threads
+ * @fd: File descriptor to write to
+ * @buf: Data to write
+ * @count: Number of bytes to write
+ * @offset: File offset to write at
+ *
+ * Same as pwrite(), with the same blocking behavior as uthread_pread().
+ *
+ * Return: Number of bytes written, or -1 with errno set in case of failure.
+ */
+ssize_t uthread_pwrite(int fd, const void *buf, size_t count, off_t offset);
+
+/*
+ * uthread_fsync - Flush a file to disk without stalling other threads
+ * @fd: File descriptor to flush
+ *
+ * Same as fsync(), with the same blocking behavior as uthread_pread().
+ *
+ * Return: 0 in case of success, -1 with errno set in case of failure.
+ */
+int uthread_fsync(int fd);
+
+/*
+ * uthread_pool_t - Worker pool type
+ *
+ * A worker pool is a fixed set of long-lived threads executing work items
+ * submitted as a function and its argument. Items are run in submission order,
+ * each by whichever worker is free, with no thread created or stack allocated
+ * per item.
+ */
+typedef struct uthread_pool* uthread_pool_t;
+
+/*
+ * uthread_future_t - Future type
+ *
+ * A future receives the return value of a work item submitted to a pool.
+ */
+typedef struct uthread_future* uthread_future_t;
+
+/*
+ * uthread_pool_create - Create a worker pool
+ * @workers: Number of worker threads
+ * @capacity: Maximum number of work items waiting for a worker
+ *
+ * Return: Pointer to new pool. NULL if @workers or @capacity is not positive,
+ * or in case of failure (memory allocation, thread creation).
+ */
+uthread_pool_t uthread_pool_create(int workers, int capacity);
+
+/*
+ * uthread_pool_submit - Submit a work item to a worker pool
+ * @pool: Pool executing the item
+ * @func: Function to execute
+ * @arg: Argument passed to @func
+ * @future: (Optional) Address of a future receiving the item's return value
+ *
+ * If @capacity items are already waiting for a worker, the calling thread is
+ * blocked until a worker takes one.
+ *
+ * If @future is not NULL, it is set to a new future that must be passed to
+ * uthread_future_get() exactly once.
+ *
+ * Return: -1 if @pool or @func is NULL, if @pool is being destroyed, in case
+ * of memory allocation error, or if no worker could ever take an item. 0 if the
+ * item was submitted.
+ */
+int uthread_pool_submit(uthread_pool_t pool, uthread_task_func_t func,
+			void *arg, uthread_future_t *future);
+
+/*
+ * uthread_future_get - Wait for the result of a work item
+ * @future: Future set by uthread_pool_submit()
+ * @result: (Optional) Address of an integer receiving the return value
+ *
+ * The calling thread is blocked until the item has been executed. The future is
+ * deallocated afterwards, unless the item can never be executed, in which case
+ * it is left as is.
+ *
+ * Return: -1 if @future is NULL, or if no thread could ever execute the item.
+ * 0 otherwise.
+ */
+int uthread_future_get(uthread_future_t future, int *result);
+
+/*
+ * uthread_pool_destroy - Destroy a worker pool
+ * @pool: Pool to destroy
+ *
+ * Items already submitted are executed, then the workers exit and are joined.
+ * Threads blocked submitting to @pool get an error. Must not be called from an
+ * item run by @pool.
+ *
+ * Return: -1 if @pool is NULL or if called by one of its workers, in which case
+ * the pool is left untouched. 0 once the pool was destroyed.
+ */
+int uthread_pool_destroy(uthread_pool_t pool);
+
+/*
+ * uthread_stats - Global scheduler statistics
+ *
+ * switches: Number of context switches between threads
+ * creations: Number of threads created
+ * exits: Number of threads that exited
+ * joins: Number of threads collected by a join
+ * zombies: Number of dead threads currently waiting to be collected
+ * clockHz: Frequency of the clock used for per-thread times (ticks per second)
+ */
+struct uthread_stats {
+	unsigned long long switches;
+	unsigned long long creations;
+	unsigned long long exits;
+	unsigned long long joins;
+	unsigned long long zombies;
+	unsigned long long clockHz;
+};
+
+/*
+ * uthread_thread_stats - Per-thread scheduler statistics
+ *
+ * runTicks: Clock ticks spent running
+ * readyTicks: Clock ticks spent ready, waiting in the ready queue
+ * dispatches: Number of times the thread was switched to
+ */
+struct uthread_thread_stats {
+	unsigned long long runTicks;
+	unsigned long long readyTicks;
+	unsigned long long dispatches;
+};
+
+/*
+ * uthread_stats_snapshot - Get global scheduler statistics
+ * @stats: Address of structure receiving the statistics
+ *
+ * This function can be called at any time from any kernel thread (e.g. a
+ * monitoring pthread) without stopping the scheduler. Each counter is read
+ * atomically, but counters may be updated while the snapshot is taken. In
+ * sharded mode, counters are summed over all shards.
+ *
+ * Return: -1 if @stats is NULL or if the library was built without statistics
+ * (UTHREAD_STATS=0). 0 otherwise.
+ */
+int uthread_stats_snapshot(struct uthread_stats *stats);
+
+/*
+ * uthread_stats_thread - Get per-thread scheduler statistics
+ * @tid: TID of the thread
+ * @stats: Address of structure receiving the statistics
+ *
+ * Unlike uthread_stats_snapshot(), this function must be called from a user
+ * thread of the same scheduler, see uthread_stats_shard_thread() otherwise.
+ * Times are expressed in ticks of the scheduler clock, whose frequency
+ * is given by uthread_stats.clockHz.
+ *
+ * Return: -1 if @stats is NULL, if thread @tid cannot be found, or if the
+ * library was built without statistics. 0 otherwise.
+ */
+int uthread_stats_thread(uthread_t tid, struct uthread_thread_stats *stats);
+
+/*
+ * uthread_stats_shard_thread - Get per-thread statistics from any kernel thread
+ * @shard: Shard of the thread, 0 when not in thread-per-core mode
+ * @tid: TID of the thread on shard @shard
+ * @stats: Address of structure receiving the statistics
+ *
+ * Same as uthread_stats_thread(), but can be called at any time from any
+ * kernel thread, like uthread_stats_snapshot(). The slice the thread may be
+ * running is not counted yet. The figures of a thread that exited are kept
+ * until its scheduler is started again, or its TID is given to a new thread.
+ *
+ * Return: -1 if @stats is NULL, if @shard is out of range, if no thread of TID
+ * @tid was created on shard @shard since it started, or if the library was
+ * built without statistics. 0 otherwise.
+ */
+int uthread_stats_shard_thread(int shard, uthread_t tid,
+			       struct uthread_thread_stats *stats);
+
+/* Number of thread classes, see uthread_set_class() */
+#define UTHREAD_CLASSES 8
+
+/* Histograms kept for each thread class */
+#define UTHREAD_HIST_DELAY 0	/* Time spent ready, before running */
+#define UTHREAD_HIST_RUN 1	/* Time spent running, before yielding,
+				   blocking or exiting */
+
+/*
+ * uthread_set_class - Set the class of a thread
+ * @tid: TID of the thread
+ * @cls: Class, from 0 to UTHREAD_CLASSES - 1
+ *
+ * Classes group threads of the same kind (e.g. request handlers, background
+ * jobs) in the latency histograms, see uthread_stats_percentiles(). Threads
+ * start in class 0.
+ *
+ * Return: -1 if thread @tid cannot be found or if @cls is out of range, 0
+ * otherwise.
+ */
+int uthread_set_class(uthread_t tid, int cls);
+
+/*
+ * uthread_stats_percentiles - Get percentiles of a latency histogram
+ * @cls: Thread class
+ * @hist: UTHREAD_HIST_DELAY or UTHREAD_HIST_RUN
+ * @percentiles: Array of @count percentiles, from 0 to 100
+ * @ns: Array of @count integers receiving the matching values, in nanoseconds
+ * @count: Number of percentiles
+ *
+ * Every interval a thread of class @cls spends ready or running is recorded in
+ * a log-linear histogram of fixed size, with a relative error below 1/16.
+ * Values are the upper bound of the bucket holding each percentile. Can be
+ * called from any kernel thread, like uthread_stats_snapshot(). In sharded
+ * mode, histograms are summed over all shards.
+ *
+ * Return: -1 if @cls or @hist is out of range, if @percentiles or @ns is NULL,
+ * or if the library was built without statistics. Otherwise, the number of
+ * intervals recorded, in which case @ns is left untouched if there are none.
+ */
+int uthread_stats_percentiles(int cls, int hist, const double *percentiles,
+			      unsigned long long *ns, int count);
+
+/*
+ * uthread_perf_stats - Hardware events counted while a thread ran
+ *
+ * instructions: Instructions retired
+ * cycles: CPU cycles, or scheduler clock ticks if @hardware is 0
+ * cacheMisses: Last level cache misses
+ * branchMisses: Mispredicted branches
+ * hardware: 1 if read from hardware counters, 0 if only @cycles is counted,
+ *	from the scheduler clock, the other fields being 0
+ */
+struct uthread_perf_stats {
+	unsigned long long instructions;
+	unsigned long long cycles;
+	unsigned long long cacheMisses;
+	unsigned long long branchMisses;
+	int hardware;
+};
+
+/*
+ * uthread_perf_counters - Count hardware events per thread
+ * @enable: 1 to count events in schedulers started from now on, 0 not to
+ *
+ * Each scheduler opens a group of hardware counters (instructions, cycles,
+ * cache misses, branch misses) on its kernel thread when started, reads it
+ * each time a thread enters the scheduler, and charges the difference to that
+ * thread. Only user space is counted. Where hardware counters are not
+ * available (no PMU, perf_event_paranoid), only cycles are counted, with the
+ * scheduler clock.
+ *
+ * Counting costs a system call per context switch, and is disabled by
+ * default.
+ */
+void uthread_perf_counters(int enable);
+
+/*
+ * uthread_perf_thread - Get the hardware events counted for a thread
+ * @tid: TID of the thread
+ * @stats: Address of structure receiving the counts
+ *
+ * Must be called from a user thread of the scheduler running thread @tid.
+ *
+ * Return: -1 if @stats is NULL, if the calling scheduler does not count events
+ * or if thread @tid cannot be found. 0 otherwise.
+ */
+int uthread_perf_thread(uthread_t tid, struct uthread_perf_stats *stats);
+
+/*
+ * uthread_profile_start - Start the sampling profiler
+ * @hz: Number of samples per second of CPU time consumed by the process
+ *
+ * On every SIGPROF tick, the profiler records the running thread, and the
+ * shard it runs on, along with a backtrace of the interrupted code. Samples go
+ * to a preallocated buffer, those taken once it is full are only counted.
+ * Ticks hitting a context switch are attributed to the thread switched away
+ * from, under a "[context switch]" frame.
+ *
+ * Installs a SIGPROF handler and arms ITIMER_PROF, so neither must be used by
+ * the application meanwhile.
+ *
+ * Return: -1 if @hz is out of range, if the profiler already runs, or in case
+ * of failure (memory allocation, signal setup). 0 otherwise.
+ */
+int uthread_profile_start(int hz);
+
+/*
+ * uthread_profile_stop - Stop the sampling profiler and dump its samples
+ * @out: Stream receiving the samples
+ *
+ * Writes one line per distinct stack in folded format, as expected by
+ * flamegraph.pl: frames from outermost to innermost separated by semicolons,
+ * then the number of samples. The outermost frame names the thread
+ * ("uthread_<TID>"), under a "shard_<index>" frame in thread-per-core mode.
+ * Function names require linking the application with -rdynamic, frames are
+ * given as module and offset otherwise.
+ *
+ * Return: -1 if the profiler does not run, 0 otherwise.
+ */
+int uthread_profile_stop(FILE *out);
+
 #endif /* _THREAD_H */
@@ -0,0 +1,92 @@
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "private.h"
+#include "queue.h"
+#include "uthread.h"
+
+/**
+ * @brief uthread_wg - Struct representing a wait group
+ *
+ * int counter:		Number of tasks not done yet
+ * queue_t waiters:	Threads blocked until the counter drops to 0
+ */
+struct uthread_wg {
+	int counter;
+	queue_t waiters;
+};
+
+uthread_wg_t uthread_wg_create(void)
+{
+	uthread_wg_t wg = malloc(sizeof(struct uthread_wg));
+
+	if (wg == NULL) {
+		return NULL;
+	}
+
+	wg->waiters = queue_create();
+
+	if (wg->waiters == NULL) {
+		free(wg);
+		return NULL;
+	}
+
+	wg->counter = 0;
+
+	return wg;
+}
+
+int uthread_wg_destroy(uthread_wg_t wg)
+{
+	if (wg == NULL || queue_length(wg->waiters) > 0) {
+		return -1;
+	}
+
+	queue_destroy(wg->waiters);
+	free(wg);
+	return 0;
+}
+
+int uthread_wg_add(uthread_wg_t wg, int delta)
+{
+	if (wg == NULL || wg->counter + delta < 0) {
+		return -1;
+	}
+
+	wg->counter += delta;
+
+	// Last task done, release every waiter.
+	if (wg->counter == 0) {
+		uthread_unblock_all(wg->waiters);
+	}
+
+	return 0;
+}
+
+int uthread_wg_done(uthread_wg_t wg)
+{
+	return uthread_wg_add(wg, -1);
+}
+
+int uthread_wg_wait(uthread_wg_t wg)
+{
+	if (wg == NULL) {
+		return -1;
+	}
+
+	if (wg->counter == 0) {
+		return 0;
+	}
+
+	// Nobody could wake the thread up if it is not queued.
+	if (queue_enqueue(wg->waiters, currentThread) == -1) {
+		return -1;
+	}
+
+	if (uthread_block() == -1) {
+		queue_delete(wg->waiters, currentThread);
+		return -1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,242 @@
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "wsdeque.h"
+
+/* Initial number of slots in the circular array (must be a power of 2) */
+#define WSDEQUE_INITIAL_SIZE 64
+
+/* Size of a cache line, used to keep the owner and thief indices apart */
+#define CACHE_LINE 64
+
+/**
+ * @brief wsdeque_array - Circular array backing a deque
+ *
+ * int64_t size:			Number of slots, always a power of 2
+ * struct wsdeque_array* prev:	Smaller array this one replaced, kept alive
+ *					until the deque is destroyed since thieves
+ *					may still be reading from it
+ * _Atomic(void*) buffer[]:		Slots holding the data items
+ */
+struct wsdeque_array {
+	int64_t size;
+	struct wsdeque_array* prev;
+	_Atomic(void*) buffer[];
+};
+
+/**
+ * @brief wsdeque - Struct representing work-stealing deque
+ *
+ * top:		Index of the oldest item, advanced by thieves (and by the
+ *		owner when racing for the last item)
+ * bottom:	Index one past the newest item, only written by the owner
+ * array:	Current circular array
+ */
+struct wsdeque {
+	_Alignas(CACHE_LINE) _Atomic int64_t top;
+	_Alignas(CACHE_LINE) _Atomic int64_t bottom;
+	_Alignas(CACHE_LINE) _Atomic(struct wsdeque_array*) array;
+};
+
+static struct wsdeque_array* newArray(int64_t size)
+{
+	struct wsdeque_array* array = malloc(sizeof(struct wsdeque_array) +
+					     size * sizeof(_Atomic(void*)));
+
+	if (array == NULL) {
+		return NULL;
+	}
+
+	array->size = size;
+	array->prev = NULL;
+
+	return array;
+}
+
+/*
+ * growArray - Double the circular array of @deque (owner only)
+ *
+ * Items between @top and @bottom are copied over. The old array is chained
+ * behind the new one rather than freed, as a thief may have loaded it before
+ * the new one got published.
+ */
+static struct wsdeque_array* growArray(wsdeque_t deque,
+				       struct wsdeque_array* old,
+				       int64_t top, int64_t bottom)
+{
+	struct wsdeque_array* array = newArray(old->size * 2);
+
+	if (array == NULL) {
+		return NULL;
+	}
+
+	for (int64_t i = top; i < bottom; i++) {
+		void* item = atomic_load_explicit(&old->buffer[i & (old->size - 1)],
+						  memory_order_relaxed);
+		atomic_store_explicit(&array->buffer[i & (array->size - 1)],
+				      item, memory_order_relaxed);
+	}
+
+	array->prev = old;
+	atomic_store_explicit(&deque->array, array, memory_order_release);
+
+	return array;
+}
+
+wsdeque_t wsdeque_create(void)
+{
+	wsdeque_t deque = aligned_alloc(CACHE_LINE, sizeof(struct wsdeque));
+
+	if (deque == NULL) {
+		return NULL;
+	}
+
+	struct wsdeque_array* array = newArray(WSDEQUE_INITIAL_SIZE);
+
+	if (array == NULL) {
+		free(deque);
+		return NULL;
+	}
+
+	atomic_init(&deque->top, 0);
+	atomic_init(&deque->bottom, 0);
+	atomic_init(&deque->array, array);
+
+	return deque;
+}
+
+int wsdeque_destroy(wsdeque_t deque)
+{
+	if (deque == NULL) {
+		return -1;
+	}
+
+	if (wsdeque_length(deque) != 0) {
+		return -1;
+	}
+
+	// Free the current array along with every array it replaced.
+	struct wsdeque_array* array = atomic_load(&deque->array);
+	while (array != NULL) {
+		struct wsdeque_array* prev = array->prev;
+		free(array);
+		array = prev;
+	}
+
+	free(deque);
+	return 0;
+}
+
+int wsdeque_push(wsdeque_t deque, void *data)
+{
+	if (deque == NULL || data == NULL) {
+		return -1;
+	}
+
+	int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+	int64_t top = atomic_load_explicit(&deque->top, memory_order_acquire);
+	struct wsdeque_array* array = atomic_load_explicit(&deque->array,
+							   memory_order_relaxed);
+
+	// Array is full, grow it before storing the new item.
+	if (bottom - top > array->size - 1) {
+		array = growArray(deque, array, top, bottom);
+		if (array == NULL) {
+			return -1;
+		}
+	}
+
+	atomic_store_explicit(&array->buffer[bottom & (array->size - 1)], data,
+			      memory_order_relaxed);
+
+	// Publish the item before thieves can observe the new bottom.
+	atomic_thread_fence(memory_order_release);
+	atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+
+	return 0;
+}
+
+int wsdeque_pop(wsdeque_t deque, void **data)
+{
+	if (deque == NULL || data == NULL) {
+		return -1;
+	}
+
+	int64_t bottom = atomic_load_explicit(&deque->bottom,
+					      memory_order_relaxed) - 1;
+	struct wsdeque_array* array = atomic_load_explicit(&deque->array,
+							   memory_order_relaxed);
+
+	// Reserve the bottom item, then check whether a thief got there first.
+	atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+	atomic_thread_fence(memory_order_seq_cst);
+	int64_t top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+	if (top > bottom) {
+		// Deque was empty, restore bottom.
+		atomic_store_explicit(&deque->bottom, bottom + 1,
+				      memory_order_relaxed);
+		return -1;
+	}
+
+	void* item = atomic_load_explicit(&array->buffer[bottom & (array->size - 1)],
+					  memory_order_relaxed);
+
+	if (top == bottom) {
+		// Last item: race thieves for it by advancing top ourselves.
+		int won = atomic_compare_exchange_strong_explicit(&deque->top,
+			&top, top + 1, memory_order_seq_cst, memory_order_relaxed);
+		atomic_store_explicit(&deque->bottom, bottom + 1,
+				      memory_order_relaxed);
+
+		if (!won) {
+			return -1;
+		}
+	}
+
+	*data = item;
+	return 0;
+}
+
+int wsdeque_steal(wsdeque_t deque, void **data)
+{
+	if (deque == NULL || data == NULL) {
+		return -1;
+	}
+
+	int64_t top = atomic_load_explicit(&deque->top, memory_order_acquire);
+	atomic_thread_fence(memory_order_seq_cst);
+	int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+
+	if (top >= bottom) {
+		return -1;
+	}
+
+	struct wsdeque_array* array = atomic_load_explicit(&deque->array,
+							   memory_order_acquire);
+	void* item = atomic_load_explicit(&array->buffer[top & (array->size - 1)],
+					  memory_order_relaxed);
+
+	// Claim the item, unless the owner or another thief already did.
+	if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+			memory_order_seq_cst, memory_order_relaxed)) {
+		return 1;
+	}
+
+	*data = item;
+	return 0;
+}
+
+int wsdeque_length(wsdeque_t deque)
+{
+	if (deque == NULL) {
+		return -1;
+	}
+
+	int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+	int64_t top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+	return bottom > top ? (int)(bottom - top) : 0;
+}
@@ -0,0 +1,86 @@
+#ifndef _WSDEQUE_H
+#define _WSDEQUE_H
+
+/*
+ * wsdeque_t - Work-stealing deque type
+ *
+ * A work-stealing deque is a double-ended queue with a single owner and any
+ * number of thieves. The owner pushes and pops data items at the bottom end
+ * (LIFO), while thieves concurrently steal the oldest items from the top end
+ * (FIFO). This is the dynamic circular deque of Chase and Lev, written with
+ * C11 atomics so that it can be shared between kernel threads.
+ *
+ * wsdeque_push() and wsdeque_pop() must only ever be called by the owner of
+ * the deque. wsdeque_steal() can be called by any thread. All operations are
+ * O(1), apart from the occasional growth of the underlying circular array
+ * during a push.
+ */
+typedef struct wsdeque* wsdeque_t;
+
+/*
+ * wsdeque_create - Allocate an empty work-stealing deque
+ *
+ * Return: Pointer to new empty deque. NULL in case of failure when allocating
+ * the new deque.
+ */
+wsdeque_t wsdeque_create(void);
+
+/*
+ * wsdeque_destroy - Deallocate a work-stealing deque
+ * @deque: Deque to deallocate
+ *
+ * Deallocate the memory associated to the deque object pointed by @deque. No
+ * other thread may be accessing @deque at this point.
+ *
+ * Return: -1 if @deque is NULL or if @deque is not empty. 0 if @deque was
+ * successfully destroyed.
+ */
+int wsdeque_destroy(wsdeque_t deque);
+
+/*
+ * wsdeque_push - Push data item at the bottom of the deque (owner only)
+ * @deque: Deque in which to push item
+ * @data: Address of data item to push
+ *
+ * Return: -1 if @deque or @data are NULL, or in case of memory allocation error
+ * when growing the deque. 0 if @data was successfully pushed in @deque.
+ */
+int wsdeque_push(wsdeque_t deque, void *data);
+
+/*
+ * wsdeque_pop - Pop data item from the bottom of the deque (owner only)
+ * @deque: Deque from which to pop item
+ * @data: Address of data pointer where item is received
+ *
+ * Remove the newest item of deque @deque and assign it to @data.
+ *
+ * Return: -1 if @deque or @data are NULL, or if the deque is empty (including
+ * when the last item was taken by a concurrent thief). 0 if @data was set with
+ * the newest item available in @deque.
+ */
+int wsdeque_pop(wsdeque_t deque, void **data);
+
+/*
+ * wsdeque_steal - Steal data item from the top of the deque (any thread)
+ * @deque: Deque from which to steal item
+ * @data: Address of data pointer where item is received
+ *
+ * Remove the oldest item of deque @deque and assign it to @data.
+ *
+ * Return: -1 if @deque or @data are NULL, or if the deque is empty. 1 if the
+ * item was lost to a concurrent pop or steal, in which case the caller may
+ * retry. 0 if @data was set with the oldest item available in @deque.
+ */
+int wsdeque_steal(wsdeque_t deque, void **data);
+
+/*
+ * wsdeque_length - Deque length
+ * @deque: Deque to get the length of
+ *
+ * The length is only a snapshot when thieves are active.
+ *
+ * Return: -1 if @deque is NULL. Length of @deque otherwise.
+ */
+int wsdeque_length(wsdeque_t deque);
+
+#endif /* _WSDEQUE_H */